@@ -14,6 +14,15 @@
  * \brief Main libdmtx source file
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Strict ISO builds (-std=c99) hide CLOCK_MONOTONIC unless POSIX is requested */
+#if defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -24,13 +33,16 @@
 #include <errno.h>
 #include <assert.h>
 #include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "dmtx.h"
 #include "dmtxstatic.h"
 
-#ifdef HAVE_CONFIG_H
-#include "config.h"
-#endif
-
 #ifndef CALLBACK_POINT_PLOT
 #define CALLBACK_POINT_PLOT(a,b,c,d)
 #endif
@@ -63,6 +75,7 @@
 #include "dmtxencodestream.c"
 #include "dmtxencodescheme.c"
 #include "dmtxencodeoptimize.c"
+#include "dmtxencodelookahead.c"
 #include "dmtxencodeascii.c"
 #include "dmtxencodec40textx12.c"
 #include "dmtxencodeedifact.c"
@@ -70,9 +83,12 @@
 
 #include "dmtxdecode.c"
 #include "dmtxdecodescheme.c"
+#include "dmtxdecodebatch.c"
 
 #include "dmtxmessage.c"
 #include "dmtxregion.c"
+#include "dmtxregiontile.c"
+#include "dmtxregionall.c"
 #include "dmtxsymbol.c"
 #include "dmtxplacemod.c"
 #include "dmtxreedsol.c"
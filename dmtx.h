@@ -54,6 +54,10 @@ extern "C" {
 #define DmtxSymbolSquareCount         24
 #define DmtxSymbolRectCount            6
 
+#define DmtxBitMatrixMaxBytes       2592  /* 144 rows x 18 bytes, see dmtxEncodeDataMatrixBits() */
+
+#define DmtxBatchDecodePropCount       7  /* DmtxPropEdgeMin through DmtxPropHoughMode */
+
 #define DmtxModuleOff               0x00
 #define DmtxModuleOnRed             0x01
 #define DmtxModuleOnGreen           0x02
@@ -171,6 +175,7 @@ typedef enum {
    DmtxPropSquareDevn,
    DmtxPropSymbolSize,
    DmtxPropEdgeThresh,
+   DmtxPropHoughMode,
    /* Image properties */
    DmtxPropWidth             = 300,
    DmtxPropHeight,
@@ -186,9 +191,29 @@ typedef enum {
    DmtxPropXmax,
    DmtxPropYmin,
    DmtxPropYmax,
-   DmtxPropScale
+   DmtxPropScale,
+   /* Threaded decoding properties */
+   DmtxPropThreadCount       = 500,
+   DmtxPropTimeout,
+   DmtxPropTileSize,
+   DmtxPropTileOverlap
 } DmtxProperty;
 
+typedef enum {
+   DmtxBatchFailed           = -1, /* Image missing, decoder not created, or region not decoded */
+   DmtxBatchNotFound,              /* Whole image scanned without decoding a symbol */
+   DmtxBatchDecoded,               /* Result holds a decoded symbol */
+   DmtxBatchTimedOut,              /* Time limit reached before a symbol was decoded */
+   DmtxBatchFound                  /* Region located but decoding was not requested */
+} DmtxBatchStatus;
+
+typedef enum {
+   DmtxScanFound,                  /* Region returned */
+   DmtxScanExhausted,              /* Every location of the search area has been scanned */
+   DmtxScanTimedOut,               /* Deadline passed, a later call resumes the scan */
+   DmtxScanBudgetSpent             /* Location budget used up, a later call resumes the scan */
+} DmtxScanStatus;
+
 typedef enum {
    /* Custom format */
    DmtxPackCustom            = 100,
@@ -222,6 +247,11 @@ typedef enum {
   DmtxFlipY                  = 0x01 << 1
 } DmtxFlip;
 
+typedef enum {
+   DmtxHoughFull             = 0,  /* Vote at every angle */
+   DmtxHoughCoarseToFine           /* Vote coarsely, then refine around best angles */
+} DmtxHoughMode;
+
 typedef double DmtxMatrix3[3][3];
 
 /**
@@ -452,6 +482,7 @@ typedef struct DmtxDecode_struct {
    double          squareDevn;
    int             sizeIdxExpected;
    int             edgeThresh;
+   int             houghMode;
 
    /* Image modifiers */
    int             xMin;
@@ -465,8 +496,103 @@ typedef struct DmtxDecode_struct {
    unsigned char  *cache;
    DmtxImage      *image;
    DmtxScanGrid    grid;
+
+   /* Prepared image (rowOffset is NULL when pixel format is not supported) */
+   int            *rowOffset;     /* Byte offset of each scaled row within image->pxl */
+   int             rowCount;      /* Number of scaled rows addressable through rowOffset */
+   int             colCount;      /* Number of scaled columns addressable through rowOffset */
+   int             colStride;     /* Byte distance between neighboring scaled columns */
+
+   /* Flow cache filled one tile at a time (flowTileSlot is NULL when not prepared) */
+   unsigned short *flowCache;     /* Packed magnitude and direction, one tile per slot */
+   int            *flowTileSlot;  /* Slot holding each plane's tile, or DmtxUndefined */
+   int            *flowSlotTile;  /* Tile held by each slot */
+   int             flowTileCols;
+   int             flowTileRows;
+   int             flowSlotCount; /* Slots allocated, grown on demand up to DmtxFlowSlotsMax */
+   int             flowSlotUsed;  /* Slots filled since the cache was last cleared */
+   int             flowSlotNext;  /* Slot recycled next once every slot is in use */
+
+   /* Cache storage and the bounding box of locations written since last cleared */
+   int             cacheSize;
+   int             cacheWidth;
+   int             cacheHeight;
+   DmtxPixelLoc    cacheDirtyMin;
+   DmtxPixelLoc    cacheDirtyMax;
+
+   /* Entries allocated for prepared image buffers, reused across images */
+   int             rowOffsetSize;
+   int             flowTileSlotSize;
+
+   /* Per-row extents used when marking decoded regions in the cache */
+   int            *scanlineMin;
+   int            *scanlineMax;
+   int             scanlineSize;
+
+   /* Trail locations indexed by step, reused for each region candidate */
+   DmtxPixelLoc   *trail;
+   int             trailSize;     /* Number of locations allocated in trail */
+
+   /* Module index of each codeword bit, built on first use for placeMapSizeIdx */
+   unsigned short *placeMap;
+   int             placeMapSizeIdx;
+
+   /* Tiled scanning, used when threadCount is not 1 (sizes arrive unscaled) */
+   int             threadCount;
+   int             tileSize;
+   int             tileOverlap;
+   DmtxRegion     *tileRegion;    /* Merged regions of the current image, in scan order */
+   int             tileRegionCount;
+   int             tileRegionSize; /* Entries allocated in tileRegion */
+   int             tileRegionNext; /* Next region to return, DmtxUndefined until scanned */
+   unsigned char  *tileState;     /* DmtxTileUnscanned, DmtxTileStopped or DmtxTileScanned */
+   DmtxScanGrid   *tileGrid;      /* Where the scan of each stopped tile resumes */
+   int             tileStateSize; /* Entries allocated in tileState and tileGrid */
+   int             tilePending;   /* Tiles and handoffs not yet scanned to the end */
+   DmtxPixelLoc   *tileHandoff;   /* Locations tiles passed back, rescanned on the whole image */
+   int             tileHandoffCount;
+   int             tileHandoffSize; /* Entries allocated in tileHandoff */
+   int             tileHandoffNext; /* Next handoff to rescan */
+   struct DmtxScanTileWorker_struct *tileWorker; /* Tile decoders kept between scans */
+   int             tileWorkerCount;
+   int             windowEdges;   /* DmtxEdge* sides of a tile window that cut the image, else 0 */
+   int             windowEdgesHit; /* Window sides reached while testing the current location */
+   struct DmtxScanTileResult_struct *windowResult; /* Receives locations passed back by a tile */
 } DmtxDecode;
 
+/**
+ * @struct DmtxDecodeResult
+ * @brief DmtxDecodeResult
+ */
+typedef struct DmtxDecodeResult_struct {
+   DmtxBatchStatus status;
+   DmtxRegion      region;        /* Location of the symbol, including region.sizeIdx */
+   DmtxVector2     corner[4];     /* Image locations of fitted (0,0), (1,0), (1,1) and (0,1) */
+   int             outputLength;  /* Decoded byte count, not counting terminating NUL */
+   unsigned char  *output;        /* Decoded data, freed by dmtxDecodeBatchClearResults() */
+} DmtxDecodeResult;
+
+/**
+ * @struct DmtxDecodeBatch
+ * @brief DmtxDecodeBatch
+ */
+typedef struct DmtxDecodeBatch_struct {
+   /* Options */
+   int             threadCount;   /* Worker threads, or DmtxUndefined for one per processor */
+   int             scale;
+   long            timeoutMsec;   /* Time limit per image, or DmtxUndefined */
+   int             fnc1;          /* Character to represent FNC1, or DmtxUndefined */
+
+   /* Decoding properties replayed onto every worker decoder */
+   DmtxBoolean     decodePropSet[DmtxBatchDecodePropCount];
+   int             decodePropValue[DmtxBatchDecodePropCount];
+
+   /* Internals */
+   int             workerCount;
+   struct DmtxDecodeWorker_struct *worker;
+   struct DmtxDecodeBatchPool_struct *pool; /* Worker threads kept between calls */
+} DmtxDecodeBatch;
+
 /**
  * @struct DmtxEncode
  * @brief DmtxEncode
@@ -486,6 +612,8 @@ typedef struct DmtxEncode_struct {
    DmtxRegion      region;
    DmtxMatrix3     xfrm;  /* XXX still necessary? */
    DmtxMatrix3     rxfrm; /* XXX still necessary? */
+   unsigned short *placeMap;      /* Module index of each codeword bit, built on first use */
+   int             placeMapSizeIdx; /* Symbol size held in placeMap */
 } DmtxEncode;
 
 /**
@@ -530,6 +658,7 @@ typedef struct DmtxQuadruplet_struct {
 
 /* dmtxtime.c */
 extern DmtxTime dmtxTimeNow(void);
+extern long long dmtxTimeNowNsec(void);
 extern DmtxTime dmtxTimeAdd(DmtxTime t, long msec);
 extern int dmtxTimeExceeded(DmtxTime timeout);
 
@@ -539,24 +668,45 @@ extern DmtxPassFail dmtxEncodeDestroy(DmtxEncode **enc);
 extern DmtxPassFail dmtxEncodeSetProp(DmtxEncode *enc, int prop, int value);
 extern int dmtxEncodeGetProp(DmtxEncode *enc, int prop);
 extern DmtxPassFail dmtxEncodeDataMatrix(DmtxEncode *enc, int n, unsigned char *s);
+extern DmtxPassFail dmtxEncodeDataMatrixBits(DmtxEncode *enc, int n, unsigned char *s,
+      unsigned char *bits, size_t bitsSize);
 extern DmtxPassFail dmtxEncodeDataMosaic(DmtxEncode *enc, int n, unsigned char *s);
 
 /* dmtxdecode.c */
 extern DmtxDecode *dmtxDecodeCreate(DmtxImage *img, int scale);
 extern DmtxPassFail dmtxDecodeDestroy(DmtxDecode **dec);
+extern DmtxPassFail dmtxDecodeSetImage(DmtxDecode *dec, DmtxImage *img);
+extern DmtxPassFail dmtxDecodeReset(DmtxDecode *dec);
 extern DmtxPassFail dmtxDecodeSetProp(DmtxDecode *dec, int prop, int value);
 extern int dmtxDecodeGetProp(DmtxDecode *dec, int prop);
 extern /*@exposed@*/ unsigned char *dmtxDecodeGetCache(DmtxDecode *dec, int x, int y);
 extern DmtxPassFail dmtxDecodeGetPixelValue(DmtxDecode *dec, int x, int y, int channel, /*@out@*/ int *value);
 extern DmtxMessage *dmtxDecodeMatrixRegion(DmtxDecode *dec, DmtxRegion *reg, int fix);
+extern DmtxPassFail dmtxDecodeMatrixRegionInto(DmtxDecode *dec, DmtxRegion *reg, int fix,
+      DmtxMessage *msg, unsigned char *storage, size_t storageSize);
 extern DmtxMessage *dmtxDecodePopulatedArray(int sizeIdx, DmtxMessage *msg, int fix);
 extern DmtxMessage *dmtxDecodeMosaicRegion(DmtxDecode *dec, DmtxRegion *reg, int fix);
 extern unsigned char *dmtxDecodeCreateDiagnostic(DmtxDecode *dec, /*@out@*/ int *totalBytes, /*@out@*/ int *headerBytes, int style);
 
+/* dmtxdecodebatch.c */
+extern DmtxDecodeBatch *dmtxDecodeBatchCreate(void);
+extern DmtxPassFail dmtxDecodeBatchDestroy(DmtxDecodeBatch **batch);
+extern DmtxPassFail dmtxDecodeBatchSetProp(DmtxDecodeBatch *batch, int prop, int value);
+extern int dmtxDecodeBatchGetProp(DmtxDecodeBatch *batch, int prop);
+extern DmtxPassFail dmtxDecodeBatchRun(DmtxDecodeBatch *batch, DmtxImage **images, int count,
+      DmtxDecodeResult *results);
+extern DmtxPassFail dmtxDecodeBatchClearResults(DmtxDecodeResult *results, int count);
+
 /* dmtxregion.c */
 extern DmtxRegion *dmtxRegionCreate(DmtxRegion *reg);
 extern DmtxPassFail dmtxRegionDestroy(DmtxRegion **reg);
 extern DmtxRegion *dmtxRegionFindNext(DmtxDecode *dec, DmtxTime *timeout);
+extern DmtxRegion *dmtxRegionFindNextNsec(DmtxDecode *dec, long long deadline);
+extern DmtxRegion *dmtxRegionFindNextStatus(DmtxDecode *dec, long long deadline, long budget,
+      DmtxScanStatus *status);
+extern DmtxDecodeResult *dmtxRegionFindAll(DmtxDecode *dec, DmtxTime *timeout, DmtxBoolean decode,
+      int *count);
+extern DmtxPassFail dmtxRegionFindAllDestroy(DmtxDecodeResult **results, int count);
 extern DmtxRegion *dmtxRegionScanPixel(DmtxDecode *dec, int x, int y);
 extern DmtxPassFail dmtxRegionUpdateCorners(DmtxDecode *dec, DmtxRegion *reg, DmtxVector2 p00,
       DmtxVector2 p10, DmtxVector2 p11, DmtxVector2 p01);
@@ -565,6 +715,9 @@ extern DmtxPassFail dmtxRegionUpdateXfrms(DmtxDecode *dec, DmtxRegion *reg);
 /* dmtxmessage.c */
 extern DmtxMessage *dmtxMessageCreate(int sizeIdx, int symbolFormat);
 extern DmtxPassFail dmtxMessageDestroy(DmtxMessage **msg);
+extern size_t dmtxMessageGetStorageSize(int sizeIdx, int symbolFormat);
+extern DmtxPassFail dmtxMessageInit(DmtxMessage *msg, int sizeIdx, int symbolFormat,
+      unsigned char *storage, size_t storageSize);
 
 /* dmtximage.c */
 extern DmtxImage *dmtxImageCreate(unsigned char *pxl, int width, int height, int pack);
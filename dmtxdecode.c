@@ -45,6 +45,7 @@ dmtxDecodeCreate(DmtxImage *img, int scale)
    dec->squareDevn = cos(50 * (M_PI/180));
    dec->sizeIdxExpected = DmtxSymbolShapeAuto;
    dec->edgeThresh = 10;
+   dec->houghMode = DmtxHoughFull;
 
    dec->xMin = 0;
    dec->xMax = width - 1;
@@ -52,15 +53,41 @@ dmtxDecodeCreate(DmtxImage *img, int scale)
    dec->yMax = height - 1;
    dec->scale = scale;
 
+   dec->threadCount = 1;
+   dec->tileSize = DmtxTileSizeDefault;
+   dec->tileOverlap = DmtxUndefined;
+   dec->tileRegionNext = DmtxUndefined;
+
    dec->cache = (unsigned char *)calloc(width * height, sizeof(unsigned char));
    if(dec->cache == NULL) {
       free(dec);
       return NULL;
    }
+   dec->cacheSize = width * height;
+   dec->cacheWidth = width;
+   dec->cacheHeight = height;
+   dec->cacheDirtyMin.X = dec->cacheDirtyMin.Y = INT_MAX;
+   dec->cacheDirtyMax.X = dec->cacheDirtyMax.Y = INT_MIN;
+
+   dec->trail = (DmtxPixelLoc *)malloc(DmtxTrailSizeInit * sizeof(DmtxPixelLoc));
+   if(dec->trail == NULL) {
+      free(dec->cache);
+      free(dec);
+      return NULL;
+   }
+   dec->trailSize = DmtxTrailSizeInit;
+   dec->placeMapSizeIdx = DmtxUndefined;
 
    dec->image = img;
    dec->grid = InitScanGrid(dec);
 
+   if(PrepareImage(dec) == DmtxFail) {
+      free(dec->trail);
+      free(dec->cache);
+      free(dec);
+      return NULL;
+   }
+
    return dec;
 }
 
@@ -78,6 +105,34 @@ dmtxDecodeDestroy(DmtxDecode **dec)
    if((*dec)->cache != NULL)
       free((*dec)->cache);
 
+   ReleasePreparedImage(*dec);
+
+   if((*dec)->scanlineMin != NULL)
+      free((*dec)->scanlineMin);
+
+   if((*dec)->scanlineMax != NULL)
+      free((*dec)->scanlineMax);
+
+   if((*dec)->trail != NULL)
+      free((*dec)->trail);
+
+   if((*dec)->placeMap != NULL)
+      free((*dec)->placeMap);
+
+   if((*dec)->tileRegion != NULL)
+      free((*dec)->tileRegion);
+
+   if((*dec)->tileState != NULL)
+      free((*dec)->tileState);
+
+   if((*dec)->tileGrid != NULL)
+      free((*dec)->tileGrid);
+
+   if((*dec)->tileHandoff != NULL)
+      free((*dec)->tileHandoff);
+
+   ReleaseTileWorkers(*dec);
+
    free(*dec);
 
    *dec = NULL;
@@ -85,6 +140,70 @@ dmtxDecodeDestroy(DmtxDecode **dec)
    return DmtxPass;
 }
 
+/**
+ * \brief  Attach a new image to an existing decode struct
+ * \param  dec
+ * \param  img Image no larger (after scaling) than the one passed at creation
+ * \return DmtxPass | DmtxFail
+ *
+ * Lets a decoder be reused for a stream of frames without reallocating its
+ * cache. Scanning restarts from the beginning and the search boundaries are
+ * reset to cover the whole new image. Other properties are kept.
+ */
+extern DmtxPassFail
+dmtxDecodeSetImage(DmtxDecode *dec, DmtxImage *img)
+{
+   int width, height;
+
+   if(dec == NULL || img == NULL)
+      return DmtxFail;
+
+   width = dmtxImageGetProp(img, DmtxPropWidth) / dec->scale;
+   height = dmtxImageGetProp(img, DmtxPropHeight) / dec->scale;
+   if(width * height > dec->cacheSize)
+      return DmtxFail;
+
+   /* Dirty area is expressed in the geometry of the previous image */
+   CacheClearDirty(dec);
+   dec->cacheWidth = width;
+   dec->cacheHeight = height;
+
+   dec->image = img;
+   dec->xMin = 0;
+   dec->xMax = width - 1;
+   dec->yMin = 0;
+   dec->yMax = height - 1;
+   dec->grid = InitScanGrid(dec);
+   dec->tileRegionNext = DmtxUndefined;
+
+   return PrepareImage(dec);
+}
+
+/**
+ * \brief  Restart scanning of the current image
+ * \param  dec
+ * \return DmtxPass | DmtxFail
+ *
+ * Pixel contents may have changed since the last scan (e.g., a camera
+ * writing each frame into the same buffer), so cached point flow is also
+ * discarded.
+ */
+extern DmtxPassFail
+dmtxDecodeReset(DmtxDecode *dec)
+{
+   if(dec == NULL)
+      return DmtxFail;
+
+   CacheClearDirty(dec);
+
+   ClearFlowCache(dec);
+
+   dec->grid = InitScanGrid(dec);
+   dec->tileRegionNext = DmtxUndefined;
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Set decoding behavior property
  * \param  dec
@@ -117,6 +236,9 @@ dmtxDecodeSetProp(DmtxDecode *dec, int prop, int value)
       case DmtxPropEdgeThresh:
          dec->edgeThresh = value;
          break;
+      case DmtxPropHoughMode:
+         dec->houghMode = value;
+         break;
       /* Min and Max values arrive unscaled */
       case DmtxPropXmin:
          dec->xMin = value / dec->scale;
@@ -130,6 +252,22 @@ dmtxDecodeSetProp(DmtxDecode *dec, int prop, int value)
       case DmtxPropYmax:
          dec->yMax = value / dec->scale;
          break;
+      /* Tiled scanning, see dmtxregiontile.c */
+      case DmtxPropThreadCount:
+         if(value < 1 && value != DmtxUndefined)
+            return DmtxFail;
+         dec->threadCount = value;
+         break;
+      case DmtxPropTileSize:
+         if(value < 1)
+            return DmtxFail;
+         dec->tileSize = value;
+         break;
+      case DmtxPropTileOverlap:
+         if(value < 0 && value != DmtxUndefined)
+            return DmtxFail;
+         dec->tileOverlap = value;
+         break;
       default:
          break;
    }
@@ -143,8 +281,12 @@ dmtxDecodeSetProp(DmtxDecode *dec, int prop, int value)
    if(dec->edgeThresh < 1 || dec->edgeThresh > 100)
       return DmtxFail;
 
+   if(dec->houghMode != DmtxHoughFull && dec->houghMode != DmtxHoughCoarseToFine)
+      return DmtxFail;
+
    /* Reinitialize scangrid in case any inputs changed */
    dec->grid = InitScanGrid(dec);
+   dec->tileRegionNext = DmtxUndefined;
 
    return DmtxPass;
 }
@@ -173,6 +315,8 @@ dmtxDecodeGetProp(DmtxDecode *dec, int prop)
          return dec->sizeIdxExpected;
       case DmtxPropEdgeThresh:
          return dec->edgeThresh;
+      case DmtxPropHoughMode:
+         return dec->houghMode;
       case DmtxPropXmin:
          return dec->xMin;
       case DmtxPropXmax:
@@ -183,6 +327,12 @@ dmtxDecodeGetProp(DmtxDecode *dec, int prop)
          return dec->yMax;
       case DmtxPropScale:
          return dec->scale;
+      case DmtxPropThreadCount:
+         return dec->threadCount;
+      case DmtxPropTileSize:
+         return dec->tileSize;
+      case DmtxPropTileOverlap:
+         return dec->tileOverlap;
       case DmtxPropWidth:
          return dmtxImageGetProp(dec->image, DmtxPropWidth) / dec->scale;
       case DmtxPropHeight:
@@ -204,20 +354,15 @@ dmtxDecodeGetProp(DmtxDecode *dec, int prop)
 extern unsigned char *
 dmtxDecodeGetCache(DmtxDecode *dec, int x, int y)
 {
-   int width, height;
-
    assert(dec != NULL);
 
 /* if(dec.cacheComplete == DmtxFalse)
       CacheImage(); */
 
-   width = dmtxDecodeGetProp(dec, DmtxPropWidth);
-   height = dmtxDecodeGetProp(dec, DmtxPropHeight);
-
-   if(x < 0 || x >= width || y < 0 || y >= height)
+   if(x < 0 || x >= dec->cacheWidth || y < 0 || y >= dec->cacheHeight)
       return NULL;
 
-   return &(dec->cache[y * width + x]);
+   return &(dec->cache[y * dec->cacheWidth + x]);
 }
 
 /**
@@ -230,6 +375,13 @@ dmtxDecodeGetPixelValue(DmtxDecode *dec, int x, int y, int channel, int *value)
    int xUnscaled, yUnscaled;
    DmtxPassFail err;
 
+   if(dec->rowOffset != NULL) {
+      err = PreparedGetPixelValue(dec, x, y, channel, value);
+      if(err == DmtxFail && dec->windowEdges != 0)
+         NoteWindowEdge(dec, x, y);
+      return err;
+   }
+
    xUnscaled = x * dec->scale;
    yUnscaled = y * dec->scale;
 
@@ -257,10 +409,180 @@ dmtxDecodeGetPixelValue(DmtxDecode *dec, int x, int y, int channel, int *value)
    return correctedPoint; */
 
    err = dmtxImageGetPixelValue(dec->image, xUnscaled, yUnscaled, channel, value);
+   if(err == DmtxFail && dec->windowEdges != 0)
+      NoteWindowEdge(dec, x, y);
 
    return err;
 }
 
+/**
+ * \brief  Extend bounding box of cache locations that need clearing
+ * \param  dec
+ * \param  locMin
+ * \param  locMax
+ * \return void
+ */
+static void
+CacheMarkDirty(DmtxDecode *dec, DmtxPixelLoc locMin, DmtxPixelLoc locMax)
+{
+   dec->cacheDirtyMin.X = min(dec->cacheDirtyMin.X, locMin.X);
+   dec->cacheDirtyMin.Y = min(dec->cacheDirtyMin.Y, locMin.Y);
+   dec->cacheDirtyMax.X = max(dec->cacheDirtyMax.X, locMax.X);
+   dec->cacheDirtyMax.Y = max(dec->cacheDirtyMax.Y, locMax.Y);
+}
+
+/**
+ * \brief  Zero only the part of the cache written since last cleared
+ * \param  dec
+ * \return void
+ */
+static void
+CacheClearDirty(DmtxDecode *dec)
+{
+   int y;
+   int xBeg, xEnd, yBeg, yEnd;
+
+   xBeg = max(dec->cacheDirtyMin.X, 0);
+   xEnd = min(dec->cacheDirtyMax.X, dec->cacheWidth - 1);
+   yBeg = max(dec->cacheDirtyMin.Y, 0);
+   yEnd = min(dec->cacheDirtyMax.Y, dec->cacheHeight - 1);
+
+   if(xBeg <= xEnd) {
+      for(y = yBeg; y <= yEnd; y++)
+         memset(dec->cache + y * dec->cacheWidth + xBeg, 0x00, xEnd - xBeg + 1);
+   }
+
+   dec->cacheDirtyMin.X = dec->cacheDirtyMin.Y = INT_MAX;
+   dec->cacheDirtyMax.X = dec->cacheDirtyMax.Y = INT_MIN;
+}
+
+/**
+ * \brief  Build row offset table allowing direct access to scaled pixels
+ * \param  dec
+ * \return DmtxPass | DmtxFail (memory allocation failed)
+ * \note   Only images storing every channel in its own byte are prepared.
+ *         Other formats leave rowOffset NULL and are read through
+ *         dmtxImageGetPixelValue() as before. Prepared images also get
+ *         an index for the lazily filled flow cache.
+ */
+static DmtxPassFail
+PrepareImage(DmtxDecode *dec)
+{
+   int i, y, yUnscaled;
+   int tileCount;
+   DmtxImage *img;
+
+   img = dec->image;
+
+   for(i = 0; i < img->channelCount; i++) {
+      if(img->bitsPerChannel[i] != 8 || img->channelStart[i] % 8 != 0)
+         break;
+   }
+
+   if(i < img->channelCount || img->bitsPerPixel % 8 != 0 ||
+         (img->imageFlip & DmtxFlipX)) {
+      ReleasePreparedImage(dec);
+      return DmtxPass;
+   }
+
+   /* Count every scaled location whose unscaled position lies in the image */
+   dec->colCount = (img->width + dec->scale - 1) / dec->scale;
+   dec->rowCount = (img->height + dec->scale - 1) / dec->scale;
+   dec->colStride = img->bytesPerPixel * dec->scale;
+
+   /* Buffers left by a previous image are reused when large enough */
+   if(dec->rowCount > dec->rowOffsetSize) {
+      ReleasePreparedImage(dec);
+      dec->rowOffset = (int *)malloc(dec->rowCount * sizeof(int));
+      if(dec->rowOffset == NULL)
+         return DmtxFail;
+      dec->rowOffsetSize = dec->rowCount;
+   }
+
+   for(y = 0; y < dec->rowCount; y++) {
+      yUnscaled = y * dec->scale;
+      dec->rowOffset[y] = dmtxImageGetByteOffset(img, 0, yUnscaled);
+   }
+
+   /* Flow cache is optional; GetPointFlow() calculates directly without it.
+      Only the tile index is sized by the image here, tiles are allocated as
+      they are first visited (see GetFlowTile()) */
+   dec->flowTileCols = (dec->colCount + DmtxFlowTileSize - 1) / DmtxFlowTileSize;
+   dec->flowTileRows = (dec->rowCount + DmtxFlowTileSize - 1) / DmtxFlowTileSize;
+   tileCount = dec->flowTileCols * dec->flowTileRows * img->channelCount;
+
+   if(tileCount > dec->flowTileSlotSize) {
+      free(dec->flowTileSlot);
+      dec->flowTileSlot = (int *)malloc(tileCount * sizeof(int));
+      dec->flowTileSlotSize = (dec->flowTileSlot == NULL) ? 0 : tileCount;
+   }
+
+   ClearFlowCache(dec);
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Forget every cached flow tile, keeping their storage for reuse
+ * \param  dec
+ * \return void
+ */
+static void
+ClearFlowCache(DmtxDecode *dec)
+{
+   if(dec->flowTileSlot != NULL)
+      memset(dec->flowTileSlot, 0xff, dec->flowTileCols * dec->flowTileRows *
+            dec->image->channelCount * sizeof(int));
+
+   dec->flowSlotUsed = 0;
+   dec->flowSlotNext = 0;
+}
+
+/**
+ * \brief  Free buffers built by PrepareImage(), reverting to unprepared reads
+ * \param  dec
+ * \return void
+ */
+static void
+ReleasePreparedImage(DmtxDecode *dec)
+{
+   free(dec->rowOffset);
+   free(dec->flowCache);
+   free(dec->flowTileSlot);
+   free(dec->flowSlotTile);
+
+   dec->rowOffset = NULL;
+   dec->flowCache = NULL;
+   dec->flowTileSlot = NULL;
+   dec->flowSlotTile = NULL;
+   dec->rowOffsetSize = dec->flowTileSlotSize = dec->flowSlotCount = 0;
+   dec->flowSlotUsed = dec->flowSlotNext = 0;
+}
+
+/**
+ * \brief  Read pixel value through the prepared row offset table
+ * \param  dec
+ * \param  x Scaled x coordinate
+ * \param  y Scaled y coordinate
+ * \param  channel
+ * \param  value
+ * \return DmtxPass | DmtxFail (location outside image)
+ */
+static DmtxPassFail
+PreparedGetPixelValue(DmtxDecode *dec, int x, int y, int channel, int *value)
+{
+   assert(channel < dec->image->channelCount);
+
+   /* Unsigned comparison catches negative coordinates too */
+   if((unsigned int)x >= (unsigned int)dec->colCount ||
+         (unsigned int)y >= (unsigned int)dec->rowCount)
+      return DmtxFail;
+
+   *value = dec->image->pxl[dec->rowOffset[y] + x * dec->colStride + channel];
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Fill the region covered by the quadrilateral given by (p0,p1,p2,p3) in the cache.
  */
@@ -269,6 +591,7 @@ CacheFillQuad(DmtxDecode *dec, DmtxPixelLoc p0, DmtxPixelLoc p1, DmtxPixelLoc p2
 {
    DmtxBresLine lines[4];
    DmtxPixelLoc pEmpty = { 0, 0 };
+   DmtxPixelLoc pMin, pMax;
    unsigned char *cache;
    int *scanlineMin, *scanlineMax;
    int minY, maxY, sizeY, posY, posX;
@@ -287,27 +610,51 @@ CacheFillQuad(DmtxDecode *dec, DmtxPixelLoc p0, DmtxPixelLoc p1, DmtxPixelLoc p2
    minY = min(minY, p2.Y); maxY = max(maxY, p2.Y);
    minY = min(minY, p3.Y); maxY = max(maxY, p3.Y);
 
-   sizeY = maxY - minY + 1;
-
-   scanlineMin = (int *)malloc(sizeY * sizeof(int));
-   scanlineMax = (int *)calloc(sizeY, sizeof(int));
-
-   assert(scanlineMin); /* XXX handle this better */
-   assert(scanlineMax); /* XXX handle this better */
+   pMin.X = min(min(p0.X, p1.X), min(p2.X, p3.X));
+   pMax.X = max(max(p0.X, p1.X), max(p2.X, p3.X));
+   pMin.Y = minY;
+   pMax.Y = maxY;
+   CacheMarkDirty(dec, pMin, pMax);
+
+   /* Only rows inside the image are filled, so only those are tracked */
+   minY = max(minY, 0);
+   maxY = min(maxY, dec->yMax);
+   sizeY = maxY - minY;
+   if(sizeY <= 0)
+      return;
+
+   /* Scanline buffers belong to the decoder and are reused between calls */
+   if(sizeY > dec->scanlineSize) {
+      scanlineMin = (int *)realloc(dec->scanlineMin, sizeY * sizeof(int));
+      if(scanlineMin != NULL)
+         dec->scanlineMin = scanlineMin;
+      scanlineMax = (int *)realloc(dec->scanlineMax, sizeY * sizeof(int));
+      if(scanlineMax != NULL)
+         dec->scanlineMax = scanlineMax;
+      if(scanlineMin == NULL || scanlineMax == NULL)
+         return;
+      dec->scanlineSize = sizeY;
+   }
+   scanlineMin = dec->scanlineMin;
+   scanlineMax = dec->scanlineMax;
 
-   for(i = 0; i < sizeY; i++)
+   for(i = 0; i < sizeY; i++) {
       scanlineMin[i] = dec->xMax;
+      scanlineMax[i] = 0;
+   }
 
    for(i = 0; i < 4; i++) {
       while(lines[i].loc.X != lines[i].loc1.X || lines[i].loc.Y != lines[i].loc1.Y) {
          idx = lines[i].loc.Y - minY;
-         scanlineMin[idx] = min(scanlineMin[idx], lines[i].loc.X);
-         scanlineMax[idx] = max(scanlineMax[idx], lines[i].loc.X);
+         if(idx >= 0 && idx < sizeY) {
+            scanlineMin[idx] = min(scanlineMin[idx], lines[i].loc.X);
+            scanlineMax[idx] = max(scanlineMax[idx], lines[i].loc.X);
+         }
          BresLineStep(lines + i, 1, 0);
       }
    }
 
-   for(posY = minY; posY < maxY && posY < dec->yMax; posY++) {
+   for(posY = minY; posY < maxY; posY++) {
       idx = posY - minY;
       for(posX = scanlineMin[idx]; posX < scanlineMax[idx] && posX < dec->xMax; posX++) {
          cache = dmtxDecodeGetCache(dec, posX, posY);
@@ -315,9 +662,6 @@ CacheFillQuad(DmtxDecode *dec, DmtxPixelLoc p0, DmtxPixelLoc p1, DmtxPixelLoc p2
             *cache |= 0x80;
       }
    }
-
-   free(scanlineMin);
-   free(scanlineMax);
 }
 
 /**
@@ -332,20 +676,96 @@ dmtxDecodeMatrixRegion(DmtxDecode *dec, DmtxRegion *reg, int fix)
 {
    //fprintf(stdout, "libdmtx::dmtxDecodeMatrixRegion()\n");
    DmtxMessage *msg;
-   DmtxVector2 topLeft, topRight, bottomLeft, bottomRight;
-   DmtxPixelLoc pxTopLeft, pxTopRight, pxBottomLeft, pxBottomRight;
 
    msg = dmtxMessageCreate(reg->sizeIdx, DmtxFormatMatrix);
    if(msg == NULL)
       return NULL;
 
-   if(PopulateArrayFromMatrix(dec, reg, msg) != DmtxPass) {
+   if(DecodeMatrixRegion(dec, reg, fix, msg) == DmtxFail) {
       dmtxMessageDestroy(&msg);
       return NULL;
    }
 
+   return msg;
+}
+
+/**
+ * \brief  Convert fitted Data Matrix region into a message held in caller storage
+ * \param  dec
+ * \param  reg
+ * \param  fix
+ * \param  msg Message to be initialized, see dmtxMessageInit()
+ * \param  storage
+ * \param  storageSize At least dmtxMessageGetStorageSize(reg->sizeIdx, DmtxFormatMatrix),
+ *         or dmtxMessageGetStorageSize(DmtxUndefined, DmtxFormatMatrix) for any region
+ * \return DmtxPass | DmtxFail
+ */
+extern DmtxPassFail
+dmtxDecodeMatrixRegionInto(DmtxDecode *dec, DmtxRegion *reg, int fix,
+      DmtxMessage *msg, unsigned char *storage, size_t storageSize)
+{
+   if(dmtxMessageInit(msg, reg->sizeIdx, DmtxFormatMatrix, storage, storageSize) == DmtxFail)
+      return DmtxFail;
+
+   return DecodeMatrixRegion(dec, reg, fix, msg);
+}
+
+/**
+ * \brief  Decode fitted Data Matrix region into an initialized message
+ * \param  dec
+ * \param  reg
+ * \param  fix
+ * \param  msg
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+DecodeMatrixRegion(DmtxDecode *dec, DmtxRegion *reg, int fix, DmtxMessage *msg)
+{
+   if(PopulateArrayFromMatrix(dec, reg, msg) != DmtxPass)
+      return DmtxFail;
+
+   CacheFillRegion(dec, reg);
+
+   return DecodeRegionArray(dec, reg, fix, msg, &(dec->placeMap), &(dec->placeMapSizeIdx));
+}
+
+/**
+ * \brief  Decode a message whose array was filled by PopulateArrayFromMatrix()
+ * \param  dec Only read, so workers may share it
+ * \param  reg
+ * \param  fix
+ * \param  msg
+ * \param  placeMap Placement map storage owned by the caller
+ * \param  placeMapSizeIdx Symbol size placeMap was built for
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+DecodeRegionArray(DmtxDecode *dec, DmtxRegion *reg, int fix, DmtxMessage *msg,
+      unsigned short **placeMap, int *placeMapSizeIdx)
+{
+   const unsigned short *map;
+
    msg->fnc1 = dec->fnc1;
 
+   map = GetPlacementMap(placeMap, placeMapSizeIdx, reg->sizeIdx);
+   if(map == NULL)
+      return DmtxFail;
+
+   return DecodePopulatedArray(reg->sizeIdx, msg, fix, map);
+}
+
+/**
+ * \brief  Mark the area covered by a region, plus a small border, as visited
+ * \param  dec
+ * \param  reg
+ * \return void
+ */
+static void
+CacheFillRegion(DmtxDecode *dec, DmtxRegion *reg)
+{
+   DmtxVector2 topLeft, topRight, bottomLeft, bottomRight;
+   DmtxPixelLoc pxTopLeft, pxTopRight, pxBottomLeft, pxBottomRight;
+
    topLeft.X = bottomLeft.X = topLeft.Y = topRight.Y = -0.1;
    topRight.X = bottomRight.X = bottomLeft.Y = bottomRight.Y = 1.1;
 
@@ -364,8 +784,6 @@ dmtxDecodeMatrixRegion(DmtxDecode *dec, DmtxRegion *reg, int fix)
    pxBottomRight.Y = (int)(0.5 + bottomRight.Y);
 
    CacheFillQuad(dec, pxTopLeft, pxTopRight, pxBottomRight, pxBottomLeft);
-
-   return dmtxDecodePopulatedArray(reg->sizeIdx, msg, fix);
 }
 
 /**
@@ -400,15 +818,12 @@ dmtxDecodePopulatedArray(int sizeIdx, DmtxMessage *msg, int fix)
     *
     */
     
-   ModulePlacementEcc200(msg->array, msg->code, sizeIdx, DmtxModuleOnRed | DmtxModuleOnGreen | DmtxModuleOnBlue);
+   const unsigned short *map;
 
-   if(RsDecode(msg->code, sizeIdx, fix) == DmtxFail){
-      dmtxMessageDestroy(&msg);
-      msg = NULL;
-      return NULL;
-   }
+   /* No decoder to keep a placement map in, so use the shared one for sizeIdx */
+   map = GetSharedPlacementMap(sizeIdx);
 
-   if(DecodeDataStream(msg, sizeIdx, NULL) == DmtxFail) {
+   if(map == NULL || DecodePopulatedArray(sizeIdx, msg, fix, map) == DmtxFail) {
       dmtxMessageDestroy(&msg);
       msg = NULL;
       return NULL;
@@ -417,6 +832,35 @@ dmtxDecodePopulatedArray(int sizeIdx, DmtxMessage *msg, int fix)
    return msg;
 }
 
+/**
+ * \brief  Decode populated module array, leaving message allocation to the caller
+ * \param  sizeIdx
+ * \param  msg
+ * \param  fix
+ * \param  map Placement map for sizeIdx
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+DecodePopulatedArray(int sizeIdx, DmtxMessage *msg, int fix, const unsigned short *map)
+{
+   /* Mosaic messages hold three symbols' worth of codewords */
+   unsigned char unsure[3 * DmtxCodewordsMax];
+
+   if(msg->codeSize > sizeof(unsure))
+      return DmtxFail;
+
+   memset(unsure, 0x00, msg->codeSize);
+   ModulePlacementEcc200(msg->array, msg->code, unsure, map, sizeIdx, DmtxModuleOnRed | DmtxModuleOnGreen | DmtxModuleOnBlue);
+
+   if(RsDecode(msg->code, unsure, sizeIdx, fix) == DmtxFail)
+      return DmtxFail;
+
+   if(DecodeDataStream(msg, sizeIdx, NULL) == DmtxFail)
+      return DmtxFail;
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Convert fitted Data Mosaic region into a decoded message
  * \param  dec
@@ -570,8 +1014,8 @@ dmtxDecodeCreateDiagnostic(DmtxDecode *dec, int *totalBytes, int *headerBytes, i
 
 /**
  * \brief  Increment counters used to determine module values
- * \param  img
  * \param  reg
+ * \param  colors Module colors of mapping region including its border ring
  * \param  tally
  * \param  xOrigin
  * \param  yOrigin
@@ -581,9 +1025,10 @@ dmtxDecodeCreateDiagnostic(DmtxDecode *dec, int *totalBytes, int *headerBytes, i
  * \return void
  */
 static void
-TallyModuleJumps(DmtxDecode *dec, DmtxRegion *reg, int tally[][24], int xOrigin, int yOrigin, int mapWidth, int mapHeight, DmtxDirection dir)
+TallyModuleJumps(DmtxRegion *reg, int *colors, int tally[][24], int xOrigin, int yOrigin, int mapWidth, int mapHeight, DmtxDirection dir)
 {
    int extent, weight;
+   int colorStride;
    int travelStep;
    int symbolRow, symbolCol;
    int mapRow, mapCol;
@@ -629,6 +1074,9 @@ TallyModuleJumps(DmtxDecode *dec, DmtxRegion *reg, int tally[][24], int xOrigin,
 
    assert(jumpThreshold >= 0);
 
+   /* Color buffer starts at border module below and left of origin */
+   colorStride = mapWidth + 2;
+
    for(*line = lineStart; *line < lineStop; (*line)++) {
 
       /* Capture tModule for each leading border module as normal but
@@ -637,7 +1085,7 @@ TallyModuleJumps(DmtxDecode *dec, DmtxRegion *reg, int tally[][24], int xOrigin,
 
 
       *travel = travelStart;
-      color = ReadModuleColor(dec, reg, symbolRow, symbolCol, reg->sizeIdx, reg->flowBegin.plane);
+      color = colors[(symbolRow - yOrigin + 1) * colorStride + (symbolCol - xOrigin + 1)];
       tModule = (darkOnLight) ? reg->offColor - color : color - reg->offColor;
 
       statusModule = (travelStep == 1 || (*line & 0x01) == 0) ? DmtxModuleOnRGB : DmtxModuleOff;
@@ -652,7 +1100,7 @@ TallyModuleJumps(DmtxDecode *dec, DmtxRegion *reg, int tally[][24], int xOrigin,
          /* For normal data-bearing modules capture color and decide
             module status based on comparison to previous "known" module */
 
-         color = ReadModuleColor(dec, reg, symbolRow, symbolCol, reg->sizeIdx, reg->flowBegin.plane);
+         color = colors[(symbolRow - yOrigin + 1) * colorStride + (symbolCol - xOrigin + 1)];
          tModule = (darkOnLight) ? reg->offColor - color : color - reg->offColor;
 
          if(statusPrev == DmtxModuleOnRGB) {
@@ -704,6 +1152,7 @@ PopulateArrayFromMatrix(DmtxDecode *dec, DmtxRegion *reg, DmtxMessage *msg)
    int mapCol, mapRow;
    int colTmp, rowTmp, idx;
    int tally[24][24]; /* Large enough to map largest single region */
+   int colors[26 * 26]; /* Same region plus its border modules */
 
 /* memset(msg->array, 0x00, msg->arraySize); */
 
@@ -751,11 +1200,15 @@ PopulateArrayFromMatrix(DmtxDecode *dec, DmtxRegion *reg, DmtxMessage *msg)
          xOrigin = xRegionCount * (mapWidth + 2) + 1;
          //fprintf(stdout, "libdmtx::PopulateArrayFromMatrix::xOrigin: %d\n", xOrigin);
 
+         /* Sample every module once, then tally all four directions */
+         ReadModuleColorBlock(dec, reg, yOrigin - 1, xOrigin - 1, mapHeight + 2,
+               mapWidth + 2, reg->sizeIdx, reg->flowBegin.plane, colors);
+
          memset(tally, 0x00, 24 * 24 * sizeof(int));
-         TallyModuleJumps(dec, reg, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirUp);
-         TallyModuleJumps(dec, reg, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirLeft);
-         TallyModuleJumps(dec, reg, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirDown);
-         TallyModuleJumps(dec, reg, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirRight);
+         TallyModuleJumps(reg, colors, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirUp);
+         TallyModuleJumps(reg, colors, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirLeft);
+         TallyModuleJumps(reg, colors, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirDown);
+         TallyModuleJumps(reg, colors, tally, xOrigin, yOrigin, mapWidth, mapHeight, DmtxDirRight);
 
          /* Decide module status based on final tallies */
          for(mapRow = 0; mapRow < mapHeight; mapRow++) {
@@ -777,6 +1230,10 @@ PopulateArrayFromMatrix(DmtxDecode *dec, DmtxRegion *reg, DmtxMessage *msg)
                }
 
                msg->array[idx] |= DmtxModuleAssigned;
+
+               /* Flag modules whose tally came close to the decision point */
+               if(fabs(tally[mapRow][mapCol]/(double)weightFactor - 0.5) < DmtxModuleUnsureMargin)
+                  msg->array[idx] |= DmtxModuleUnsure;
             }
             //fprintf(stdout, "\n");
          }
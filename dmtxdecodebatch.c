@@ -0,0 +1,602 @@
+/**
+ * libdmtx - Data Matrix Encoding/Decoding Library
+ * Copyright 2008, 2009 Mike Laughton. All rights reserved.
+ * Copyright 2012-2016 Vadim A. Misbakh-Soloviov. All rights reserved.
+ *
+ * See LICENSE file in the main project directory for full
+ * terms of use and distribution.
+ *
+ * Contact:
+ * Vadim A. Misbakh-Soloviov <dmtx@mva.name>
+ * Mike Laughton <mike@dragonflylogic.com>
+ *
+ * \file dmtxdecodebatch.c
+ * \brief Decode many images across worker threads
+ */
+
+/**
+ * A batch decodes an array of images and reports the first symbol found in
+ * each one. Workers take the next undecoded image from a shared counter, so
+ * a slow image never holds up the rest, and every worker keeps its decoder
+ * and message storage between images (and between calls) so steady-state
+ * decoding does not reallocate them. Results are written to the slot
+ * matching each image, which keeps output order independent of scheduling.
+ *
+ * The calling thread acts as the first worker. The other workers run on
+ * threads that are started the first time they are needed and then wait
+ * for the next call, until the thread count changes or the batch is
+ * destroyed. Without pthreads the same code runs on the calling thread.
+ */
+
+/**
+ * \brief  Initialize batch decode struct with default values
+ * \return Initialized DmtxDecodeBatch struct
+ */
+extern DmtxDecodeBatch *
+dmtxDecodeBatchCreate(void)
+{
+   DmtxDecodeBatch *batch;
+
+   batch = (DmtxDecodeBatch *)calloc(1, sizeof(DmtxDecodeBatch));
+   if(batch == NULL)
+      return NULL;
+
+   batch->threadCount = DmtxUndefined;
+   batch->scale = 1;
+   batch->timeoutMsec = DmtxUndefined;
+   batch->fnc1 = DmtxUndefined;
+
+   return batch;
+}
+
+/**
+ * \brief  Deinitialize batch decode struct and its workers
+ * \param  batch
+ * \return DmtxPass | DmtxFail
+ */
+extern DmtxPassFail
+dmtxDecodeBatchDestroy(DmtxDecodeBatch **batch)
+{
+   if(batch == NULL || *batch == NULL)
+      return DmtxFail;
+
+   ReleaseBatchWorkers(*batch);
+
+   free(*batch);
+
+   *batch = NULL;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Set batch decoding property
+ * \param  batch
+ * \param  prop DmtxPropThreadCount, DmtxPropTimeout, DmtxPropScale, or any
+ *         decoding property accepted by dmtxDecodeSetProp() except the
+ *         image modifiers
+ * \param  value
+ * \return DmtxPass | DmtxFail
+ */
+extern DmtxPassFail
+dmtxDecodeBatchSetProp(DmtxDecodeBatch *batch, int prop, int value)
+{
+   int i;
+
+   if(batch == NULL)
+      return DmtxFail;
+
+   switch(prop) {
+      case DmtxPropThreadCount:
+         if(value < 1 && value != DmtxUndefined)
+            return DmtxFail;
+         /* Workers are sized for the thread count, so start over */
+         if(value != batch->threadCount)
+            ReleaseBatchWorkers(batch);
+         batch->threadCount = value;
+         return DmtxPass;
+      case DmtxPropTimeout:
+         if(value < 0 && value != DmtxUndefined)
+            return DmtxFail;
+         batch->timeoutMsec = value;
+         return DmtxPass;
+      case DmtxPropScale:
+         if(value < 1)
+            return DmtxFail;
+         batch->scale = value;
+         return DmtxPass;
+      case DmtxPropScanGap:
+         if(value < 1)
+            return DmtxFail;
+         break;
+      case DmtxPropSquareDevn:
+         if(value <= 0 || value >= 90)
+            return DmtxFail;
+         break;
+      case DmtxPropEdgeThresh:
+         if(value < 1 || value > 100)
+            return DmtxFail;
+         break;
+      case DmtxPropHoughMode:
+         if(value != DmtxHoughFull && value != DmtxHoughCoarseToFine)
+            return DmtxFail;
+         break;
+      case DmtxPropFnc1:
+         /* Lies outside the DmtxPropEdgeMin range so it keeps its own field */
+         batch->fnc1 = value;
+         break;
+      case DmtxPropEdgeMin:
+      case DmtxPropEdgeMax:
+      case DmtxPropSymbolSize:
+         break;
+      default:
+         return DmtxFail;
+   }
+
+   if(prop != DmtxPropFnc1) {
+      i = prop - DmtxPropEdgeMin;
+      assert(i >= 0 && i < DmtxBatchDecodePropCount);
+      batch->decodePropSet[i] = DmtxTrue;
+      batch->decodePropValue[i] = value;
+   }
+
+   /* Decoders already held by workers pick up the change for the next call */
+   for(i = 0; i < batch->workerCount; i++) {
+      if(batch->worker[i].dec != NULL)
+         dmtxDecodeSetProp(batch->worker[i].dec, prop, value);
+   }
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Get batch decoding property
+ * \param  batch
+ * \param  prop
+ * \return value
+ */
+extern int
+dmtxDecodeBatchGetProp(DmtxDecodeBatch *batch, int prop)
+{
+   int i;
+
+   if(batch == NULL)
+      return DmtxUndefined;
+
+   switch(prop) {
+      case DmtxPropThreadCount:
+         return batch->threadCount;
+      case DmtxPropTimeout:
+         return batch->timeoutMsec;
+      case DmtxPropScale:
+         return batch->scale;
+      case DmtxPropFnc1:
+         return batch->fnc1;
+      default:
+         break;
+   }
+
+   i = prop - DmtxPropEdgeMin;
+   if(i >= 0 && i < DmtxBatchDecodePropCount && batch->decodePropSet[i])
+      return batch->decodePropValue[i];
+
+   return DmtxUndefined;
+}
+
+/**
+ * \brief  Decode the first symbol found in each of a list of images
+ * \param  batch
+ * \param  images Images to decode; NULL entries are reported as DmtxBatchFailed
+ * \param  count Number of images
+ * \param  results Receives one result per image, in the same order. Release
+ *         decoded output with dmtxDecodeBatchClearResults()
+ * \return DmtxPass | DmtxFail
+ *
+ * DmtxPropTimeout limits the time spent on each image individually.
+ */
+extern DmtxPassFail
+dmtxDecodeBatchRun(DmtxDecodeBatch *batch, DmtxImage **images, int count,
+      DmtxDecodeResult *results)
+{
+   int i, threadCount;
+   DmtxDecodeBatchJob job;
+
+   if(batch == NULL || images == NULL || results == NULL || count < 0)
+      return DmtxFail;
+
+   for(i = 0; i < count; i++) {
+      memset(&results[i], 0x00, sizeof(DmtxDecodeResult));
+      results[i].status = DmtxBatchFailed;
+   }
+
+   /* Workers are kept across calls, one for every thread the batch may use */
+   if(batch->worker == NULL) {
+      threadCount = GetThreadCount(batch->threadCount, INT_MAX);
+      batch->worker = (DmtxDecodeWorker *)calloc(threadCount, sizeof(DmtxDecodeWorker));
+      if(batch->worker == NULL)
+         return DmtxFail;
+      batch->workerCount = threadCount;
+   }
+
+   threadCount = GetThreadCount(batch->threadCount, count);
+
+   job.batch = batch;
+   job.images = images;
+   job.results = results;
+   job.count = count;
+   job.next = 0;
+   job.pool = NULL;
+
+   for(i = 0; i < batch->workerCount; i++)
+      batch->worker[i].job = &job;
+
+#ifdef HAVE_PTHREAD_H
+   /* Threads that did start share the whole job with the calling thread */
+   if(threadCount > 1 && StartBatchThreads(batch, threadCount) > 0) {
+      job.pool = batch->pool;
+
+      pthread_mutex_lock(&job.pool->mutex);
+      job.pool->generation++;
+      job.pool->busyCount = job.pool->threadCount;
+      pthread_cond_broadcast(&job.pool->posted);
+      pthread_mutex_unlock(&job.pool->mutex);
+
+      DecodeBatchWorker(&batch->worker[0]);
+
+      pthread_mutex_lock(&job.pool->mutex);
+      while(job.pool->busyCount > 0)
+         pthread_cond_wait(&job.pool->finished, &job.pool->mutex);
+      pthread_mutex_unlock(&job.pool->mutex);
+
+      return DmtxPass;
+   }
+#endif
+
+   DecodeBatchWorker(&batch->worker[0]);
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Free decoded output held by batch results
+ * \param  results
+ * \param  count
+ * \return DmtxPass | DmtxFail
+ */
+extern DmtxPassFail
+dmtxDecodeBatchClearResults(DmtxDecodeResult *results, int count)
+{
+   int i;
+
+   if(results == NULL)
+      return DmtxFail;
+
+   for(i = 0; i < count; i++) {
+      if(results[i].output != NULL)
+         free(results[i].output);
+      results[i].output = NULL;
+      results[i].outputLength = 0;
+   }
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Number of workers to use for a call
+ * \param  threadCount Requested thread count, or DmtxUndefined for one per processor
+ * \param  jobCount Number of independent jobs (images or tiles) in the call
+ * \return Worker count, at least 1
+ */
+static int
+GetThreadCount(int threadCount, int jobCount)
+{
+#ifdef HAVE_PTHREAD_H
+#if defined(_SC_NPROCESSORS_ONLN)
+   if(threadCount == DmtxUndefined)
+      threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   /* More workers than jobs would only sit idle */
+   if(threadCount > jobCount)
+      threadCount = jobCount;
+#else
+   threadCount = 1;
+#endif
+
+   return (threadCount < 1) ? 1 : threadCount;
+}
+
+/**
+ * \brief  Free worker decoders and message storage
+ * \param  batch
+ * \return void
+ */
+static void
+ReleaseBatchWorkers(DmtxDecodeBatch *batch)
+{
+   int i;
+
+#ifdef HAVE_PTHREAD_H
+   StopBatchThreads(batch);
+#endif
+
+   for(i = 0; i < batch->workerCount; i++) {
+      dmtxDecodeDestroy(&(batch->worker[i].dec));
+      if(batch->worker[i].messageStorage != NULL)
+         free(batch->worker[i].messageStorage);
+   }
+
+   if(batch->worker != NULL)
+      free(batch->worker);
+
+   batch->worker = NULL;
+   batch->workerCount = 0;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * \brief  Make sure threads are running for workers 1 through threadCount - 1
+ * \param  batch
+ * \param  threadCount Threads wanted, including the calling thread
+ * \return Number of threads running, which may fall short when they cannot be started
+ */
+static int
+StartBatchThreads(DmtxDecodeBatch *batch, int threadCount)
+{
+   DmtxDecodeBatchPool *pool;
+   DmtxDecodeWorker *worker;
+
+   if(batch->pool == NULL) {
+      pool = (DmtxDecodeBatchPool *)calloc(1, sizeof(DmtxDecodeBatchPool));
+      if(pool == NULL)
+         return 0;
+
+      if(pthread_mutex_init(&pool->mutex, NULL) != 0) {
+         free(pool);
+         return 0;
+      }
+      if(pthread_cond_init(&pool->posted, NULL) != 0) {
+         pthread_mutex_destroy(&pool->mutex);
+         free(pool);
+         return 0;
+      }
+      if(pthread_cond_init(&pool->finished, NULL) != 0) {
+         pthread_cond_destroy(&pool->posted);
+         pthread_mutex_destroy(&pool->mutex);
+         free(pool);
+         return 0;
+      }
+
+      batch->pool = pool;
+   }
+
+   pool = batch->pool;
+
+   /* Threads only wait between calls, so nothing else touches the pool here */
+   while(pool->threadCount < threadCount - 1 && pool->threadCount < batch->workerCount - 1) {
+      worker = &batch->worker[pool->threadCount + 1];
+      worker->pool = pool;
+      worker->generation = pool->generation;
+      if(pthread_create(&worker->thread, NULL, DecodeBatchThread, worker) != 0)
+         break;
+      pool->threadCount++;
+   }
+
+   return pool->threadCount;
+}
+
+/**
+ * \brief  Ask batch threads to exit and wait for them
+ * \param  batch
+ * \return void
+ */
+static void
+StopBatchThreads(DmtxDecodeBatch *batch)
+{
+   int i;
+   DmtxDecodeBatchPool *pool;
+
+   pool = batch->pool;
+   if(pool == NULL)
+      return;
+
+   pthread_mutex_lock(&pool->mutex);
+   pool->stop = DmtxTrue;
+   pthread_cond_broadcast(&pool->posted);
+   pthread_mutex_unlock(&pool->mutex);
+
+   for(i = 1; i <= pool->threadCount; i++)
+      pthread_join(batch->worker[i].thread, NULL);
+
+   pthread_cond_destroy(&pool->finished);
+   pthread_cond_destroy(&pool->posted);
+   pthread_mutex_destroy(&pool->mutex);
+   free(pool);
+
+   batch->pool = NULL;
+}
+
+/**
+ * \brief  pthread entry point for a batch worker, running each posted job
+ * \param  arg DmtxDecodeWorker
+ * \return NULL
+ */
+static void *
+DecodeBatchThread(void *arg)
+{
+   DmtxDecodeWorker *worker;
+   DmtxDecodeBatchPool *pool;
+
+   worker = (DmtxDecodeWorker *)arg;
+   pool = worker->pool;
+
+   pthread_mutex_lock(&pool->mutex);
+   for(;;) {
+      while(pool->stop == DmtxFalse && pool->generation == worker->generation)
+         pthread_cond_wait(&pool->posted, &pool->mutex);
+
+      if(pool->stop == DmtxTrue)
+         break;
+
+      worker->generation = pool->generation;
+      pthread_mutex_unlock(&pool->mutex);
+
+      DecodeBatchWorker(worker);
+
+      pthread_mutex_lock(&pool->mutex);
+      if(--pool->busyCount == 0)
+         pthread_cond_signal(&pool->finished);
+   }
+   pthread_mutex_unlock(&pool->mutex);
+
+   return NULL;
+}
+#endif
+
+/**
+ * \brief  Decode images from the shared job until none are left
+ * \param  worker
+ * \return void
+ */
+static void
+DecodeBatchWorker(DmtxDecodeWorker *worker)
+{
+   int imageIdx;
+   DmtxDecodeBatchJob *job;
+
+   job = worker->job;
+
+   for(;;) {
+#ifdef HAVE_PTHREAD_H
+      if(job->pool != NULL)
+         pthread_mutex_lock(&job->pool->mutex);
+#endif
+      imageIdx = job->next++;
+#ifdef HAVE_PTHREAD_H
+      if(job->pool != NULL)
+         pthread_mutex_unlock(&job->pool->mutex);
+#endif
+
+      if(imageIdx >= job->count)
+         break;
+
+      DecodeBatchImage(worker, job->images[imageIdx], &(job->results[imageIdx]));
+   }
+}
+
+/**
+ * \brief  Decode the first symbol of one image into its result
+ * \param  worker
+ * \param  img
+ * \param  result
+ * \return void
+ */
+static void
+DecodeBatchImage(DmtxDecodeWorker *worker, DmtxImage *img, DmtxDecodeResult *result)
+{
+   long long deadline;
+   DmtxScanStatus status;
+   DmtxRegion *reg;
+   DmtxDecodeBatch *batch;
+
+   batch = worker->job->batch;
+
+   result->status = DmtxBatchFailed;
+
+   if(img == NULL || PrepareBatchWorker(worker, img) == DmtxFail)
+      return;
+
+   deadline = DmtxUndefined;
+   if(batch->timeoutMsec != DmtxUndefined)
+      deadline = dmtxTimeNowNsec() + (long long)batch->timeoutMsec * 1000000;
+
+   for(;;) {
+      reg = dmtxRegionFindNextStatus(worker->dec, deadline, DmtxUndefined, &status);
+      if(reg == NULL)
+         break;
+
+      if(dmtxDecodeMatrixRegionInto(worker->dec, reg, DmtxUndefined, &(worker->message),
+            worker->messageStorage, worker->messageStorageSize) == DmtxPass) {
+
+         result->region = *reg;
+         GetRegionCorners(reg, result->corner);
+         SetResultOutput(result, &(worker->message));
+
+         dmtxRegionDestroy(&reg);
+         return;
+      }
+
+      dmtxRegionDestroy(&reg);
+
+      /* Decoding may have used up the rest of the time */
+      if(DeadlineExceeded(deadline) == DmtxTrue) {
+         status = DmtxScanTimedOut;
+         break;
+      }
+   }
+
+   result->status = (status == DmtxScanTimedOut) ? DmtxBatchTimedOut : DmtxBatchNotFound;
+}
+
+/**
+ * \brief  Copy decoded message into a result as a NUL-terminated string
+ * \param  result
+ * \param  msg
+ * \return void
+ *
+ * Status becomes DmtxBatchDecoded, or DmtxBatchFailed when out of memory.
+ */
+static void
+SetResultOutput(DmtxDecodeResult *result, DmtxMessage *msg)
+{
+   result->output = (unsigned char *)malloc(msg->outputIdx + 1);
+   if(result->output == NULL) {
+      result->status = DmtxBatchFailed;
+      return;
+   }
+
+   memcpy(result->output, msg->output, msg->outputIdx);
+   result->output[msg->outputIdx] = '\0';
+   result->outputLength = msg->outputIdx;
+   result->status = DmtxBatchDecoded;
+}
+
+/**
+ * \brief  Point worker decoder at a new image, creating it only when needed
+ * \param  worker
+ * \param  img
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+PrepareBatchWorker(DmtxDecodeWorker *worker, DmtxImage *img)
+{
+   int i;
+   DmtxDecodeBatch *batch;
+
+   batch = worker->job->batch;
+
+   if(worker->messageStorage == NULL) {
+      worker->messageStorageSize = dmtxMessageGetStorageSize(DmtxUndefined, DmtxFormatMatrix);
+      worker->messageStorage = (unsigned char *)malloc(worker->messageStorageSize);
+      if(worker->messageStorage == NULL)
+         return DmtxFail;
+   }
+
+   /* Reuse existing decoder while images fit its cache */
+   if(worker->dec != NULL && worker->dec->scale == batch->scale &&
+         dmtxDecodeSetImage(worker->dec, img) == DmtxPass)
+      return DmtxPass;
+
+   dmtxDecodeDestroy(&(worker->dec));
+
+   worker->dec = dmtxDecodeCreate(img, batch->scale);
+   if(worker->dec == NULL)
+      return DmtxFail;
+
+   for(i = 0; i < DmtxBatchDecodePropCount; i++) {
+      if(batch->decodePropSet[i])
+         dmtxDecodeSetProp(worker->dec, DmtxPropEdgeMin + i, batch->decodePropValue[i]);
+   }
+   dmtxDecodeSetProp(worker->dec, DmtxPropFnc1, batch->fnc1);
+
+   return DmtxPass;
+}
@@ -39,6 +39,7 @@ dmtxEncodeCreate(void)
    enc->rowPadBytes = 0;
 
    enc->fnc1 = DmtxUndefined;
+   enc->placeMapSizeIdx = DmtxUndefined;
 
    /* Initialize background color to white */
 /* enc.region.gradient.ray.p.R = 255.0;
@@ -74,6 +75,9 @@ dmtxEncodeDestroy(DmtxEncode **enc)
    dmtxImageDestroy(&((*enc)->image));
    dmtxMessageDestroy(&((*enc)->message));
 
+   if((*enc)->placeMap != NULL)
+      free((*enc)->placeMap);
+
    free(*enc);
 
    *enc = NULL;
@@ -168,6 +172,7 @@ dmtxEncodeDataMatrix(DmtxEncode *enc, int inputSize, unsigned char *inputString)
 {
    int sizeIdx;
    int width, height, bitsPerPixel;
+   size_t rowSizeBytes;
    unsigned char *pxl;
    DmtxByte outputStorage[4096];
    DmtxByteList output = dmtxByteListBuild(outputStorage, sizeof(outputStorage));
@@ -175,45 +180,26 @@ dmtxEncodeDataMatrix(DmtxEncode *enc, int inputSize, unsigned char *inputString)
 
    input.length = inputSize;
 
-   /* Future: stream = StreamInit() ... */
-   /* Future: EncodeDataCodewords(&stream) ... */
-
-   /* Encode input string into data codewords */
-   sizeIdx = EncodeDataCodewords(&input, &output, enc->sizeIdxRequest, enc->scheme, enc->fnc1);
-   if(sizeIdx == DmtxUndefined || output.length <= 0)
+   sizeIdx = EncodeMatrixSize(enc, &input, &output);
+   if(sizeIdx == DmtxUndefined)
       return DmtxFail;
 
-   /* EncodeDataCodewords() should have updated any auto sizeIdx to a real one */
-   assert(sizeIdx != DmtxSymbolSquareAuto && sizeIdx != DmtxSymbolRectAuto);
-
-   /* XXX we can remove a lot of this redundant data */
-   enc->region.sizeIdx = sizeIdx;
-   enc->region.symbolRows = dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx);
-   enc->region.symbolCols = dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx);
-   enc->region.mappingRows = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixRows, sizeIdx);
-   enc->region.mappingCols = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixCols, sizeIdx);
-
    /* Allocate memory for message and array */
    enc->message = dmtxMessageCreate(sizeIdx, DmtxFormatMatrix);
    enc->message->padCount = 0; /* XXX this needs to be added back */
-   memcpy(enc->message->code, output.b, output.length);
-
-   /* Generate error correction codewords */
-   RsEncode(enc->message, enc->region.sizeIdx);
 
-   /* Module placement in region */
-   ModulePlacementEcc200(enc->message->array, enc->message->code,
-         enc->region.sizeIdx, DmtxModuleOnRGB);
+   if(EncodeMatrixModules(enc, enc->message, &output) == DmtxFail)
+      return DmtxFail;
 
    width = 2 * enc->marginSize + (enc->region.symbolCols * enc->moduleSize);
    height = 2 * enc->marginSize + (enc->region.symbolRows * enc->moduleSize);
    bitsPerPixel = GetBitsPerPixel(enc->pixelPacking);
    if(bitsPerPixel == DmtxUndefined)
       return DmtxFail;
-   assert(bitsPerPixel % 8 == 0);
 
-   /* Allocate memory for the image to be generated */
-   pxl = (unsigned char *)malloc(width * height * (bitsPerPixel/8) + enc->rowPadBytes);
+   /* Allocate memory for the image to be generated, padding every row */
+   rowSizeBytes = (width * bitsPerPixel + 7) / 8 + enc->rowPadBytes;
+   pxl = (unsigned char *)malloc(rowSizeBytes * height);
    if(pxl == NULL) {
       perror("pixel malloc error");
       return DmtxFail;
@@ -222,6 +208,7 @@ dmtxEncodeDataMatrix(DmtxEncode *enc, int inputSize, unsigned char *inputString)
    enc->image = dmtxImageCreate(pxl, width, height, enc->pixelPacking);
    if(enc->image == NULL) {
       perror("image malloc error");
+      free(pxl);
       return DmtxFail;
    }
 
@@ -234,6 +221,78 @@ dmtxEncodeDataMatrix(DmtxEncode *enc, int inputSize, unsigned char *inputString)
    return DmtxPass;
 }
 
+/**
+ * \brief  Convert message into a packed bit matrix of modules without rendering an image
+ * \param  enc
+ * \param  inputSize
+ * \param  inputString
+ * \param  bits Receives one bit per module (set = dark), most significant bit first.
+ *         Rows run from the top of the symbol down and each starts on a new byte,
+ *         so the row stride is (enc->region.symbolCols + 7) / 8 bytes
+ * \param  bitsSize Size of bits in bytes, DmtxBitMatrixMaxBytes is enough for any symbol
+ * \return DmtxPass | DmtxFail
+ *
+ * Symbol dimensions are left in enc->region. No image or message is created,
+ * so enc->image and enc->message are not touched.
+ */
+extern DmtxPassFail
+dmtxEncodeDataMatrixBits(DmtxEncode *enc, int inputSize, unsigned char *inputString,
+      unsigned char *bits, size_t bitsSize)
+{
+   int sizeIdx;
+   int row, col, symbolRow;
+   int moduleStatus;
+   size_t rowSizeBytes;
+   unsigned char *rowPtr;
+   unsigned char arrayStorage[DmtxPlacementMapMax];
+   unsigned char codeStorage[DmtxCodewordsMax];
+   DmtxMessage message;
+   DmtxByte outputStorage[4096];
+   DmtxByteList output = dmtxByteListBuild(outputStorage, sizeof(outputStorage));
+   DmtxByteList input = dmtxByteListBuild(inputString, inputSize);
+
+   if(bits == NULL)
+      return DmtxFail;
+
+   input.length = inputSize;
+
+   sizeIdx = EncodeMatrixSize(enc, &input, &output);
+   if(sizeIdx == DmtxUndefined)
+      return DmtxFail;
+
+   rowSizeBytes = (enc->region.symbolCols + 7) / 8;
+   if(bitsSize < rowSizeBytes * enc->region.symbolRows)
+      return DmtxFail;
+
+   /* Message lives on the stack; encoding never needs the decoded output buffer */
+   memset(&message, 0x00, sizeof(DmtxMessage));
+   message.arraySize = enc->region.mappingRows * enc->region.mappingCols;
+   message.codeSize = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx) +
+         dmtxGetSymbolAttribute(DmtxSymAttribSymbolErrorWords, sizeIdx);
+   message.array = arrayStorage;
+   message.code = codeStorage;
+   memset(message.array, 0x00, message.arraySize);
+   memset(message.code, 0x00, message.codeSize);
+
+   if(EncodeMatrixModules(enc, &message, &output) == DmtxFail)
+      return DmtxFail;
+
+   memset(bits, 0x00, rowSizeBytes * enc->region.symbolRows);
+
+   for(row = 0; row < enc->region.symbolRows; row++) {
+      rowPtr = bits + row * rowSizeBytes;
+      symbolRow = enc->region.symbolRows - row - 1;
+
+      for(col = 0; col < enc->region.symbolCols; col++) {
+         moduleStatus = dmtxSymbolModuleStatus(&message, sizeIdx, symbolRow, col);
+         if(moduleStatus & DmtxModuleOnRed)
+            rowPtr[col >> 3] |= (0x80 >> (col & 0x07));
+      }
+   }
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Convert message into Data Mosaic image
  *
@@ -260,6 +319,7 @@ dmtxEncodeDataMosaic(DmtxEncode *enc, int inputSize, unsigned char *inputString)
    int inputSizeR, inputSizeG, inputSizeB;
    int sizeIdxAttempt, sizeIdxFirst, sizeIdxLast;
    int row, col, mappingRows, mappingCols;
+   const unsigned short *map;
    DmtxEncode *encR, *encG, *encB;
 
    /* Use 1/3 (ceiling) of inputSize establish input size target */
@@ -345,7 +405,16 @@ dmtxEncodeDataMosaic(DmtxEncode *enc, int inputSize, unsigned char *inputString)
    memset(enc->message->array, 0x00, sizeof(unsigned char) *
          enc->region.mappingRows * enc->region.mappingCols);
 
-   ModulePlacementEcc200(enc->message->array, encR->message->code, sizeIdxAttempt, DmtxModuleOnRed);
+   /* All three passes place through the placement map kept on enc */
+   map = GetPlacementMap(&(enc->placeMap), &(enc->placeMapSizeIdx), sizeIdxAttempt);
+   if(map == NULL) {
+      dmtxEncodeDestroy(&encR);
+      dmtxEncodeDestroy(&encG);
+      dmtxEncodeDestroy(&encB);
+      return DmtxFail;
+   }
+
+   ModulePlacementEcc200(enc->message->array, encR->message->code, NULL, map, sizeIdxAttempt, DmtxModuleOnRed);
 
    /* Reset DmtxModuleAssigned and DMX_MODULE_VISITED bits */
    for(row = 0; row < mappingRows; row++) {
@@ -354,7 +423,7 @@ dmtxEncodeDataMosaic(DmtxEncode *enc, int inputSize, unsigned char *inputString)
       }
    }
 
-   ModulePlacementEcc200(enc->message->array, encG->message->code, sizeIdxAttempt, DmtxModuleOnGreen);
+   ModulePlacementEcc200(enc->message->array, encG->message->code, NULL, map, sizeIdxAttempt, DmtxModuleOnGreen);
 
    /* Reset DmtxModuleAssigned and DMX_MODULE_VISITED bits */
    for(row = 0; row < mappingRows; row++) {
@@ -363,7 +432,7 @@ dmtxEncodeDataMosaic(DmtxEncode *enc, int inputSize, unsigned char *inputString)
       }
    }
 
-   ModulePlacementEcc200(enc->message->array, encB->message->code, sizeIdxAttempt, DmtxModuleOnBlue);
+   ModulePlacementEcc200(enc->message->array, encB->message->code, NULL, map, sizeIdxAttempt, DmtxModuleOnBlue);
 
    /* Destroy encR, encG, and encB */
    dmtxEncodeDestroy(&encR);
@@ -375,6 +444,67 @@ dmtxEncodeDataMosaic(DmtxEncode *enc, int inputSize, unsigned char *inputString)
    return DmtxPass;
 }
 
+/**
+ * \brief  Encode input into data codewords and record the chosen symbol size
+ * \param  enc
+ * \param  input
+ * \param  output Receives data codewords
+ * \return Symbol size index, or DmtxUndefined on failure
+ */
+static int
+EncodeMatrixSize(DmtxEncode *enc, DmtxByteList *input, DmtxByteList *output)
+{
+   int sizeIdx;
+
+   /* Future: stream = StreamInit() ... */
+   /* Future: EncodeDataCodewords(&stream) ... */
+
+   /* Encode input string into data codewords */
+   sizeIdx = EncodeDataCodewords(input, output, enc->sizeIdxRequest, enc->scheme, enc->fnc1);
+   if(sizeIdx == DmtxUndefined || output->length <= 0)
+      return DmtxUndefined;
+
+   /* EncodeDataCodewords() should have updated any auto sizeIdx to a real one */
+   assert(sizeIdx != DmtxSymbolSquareAuto && sizeIdx != DmtxSymbolRectAuto);
+
+   /* XXX we can remove a lot of this redundant data */
+   enc->region.sizeIdx = sizeIdx;
+   enc->region.symbolRows = dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx);
+   enc->region.symbolCols = dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx);
+   enc->region.mappingRows = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixRows, sizeIdx);
+   enc->region.mappingCols = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixCols, sizeIdx);
+
+   return sizeIdx;
+}
+
+/**
+ * \brief  Add error correction to data codewords and place them as modules
+ * \param  enc
+ * \param  message Sized for enc->region.sizeIdx with a cleared module array
+ * \param  output Data codewords from EncodeMatrixSize()
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+EncodeMatrixModules(DmtxEncode *enc, DmtxMessage *message, DmtxByteList *output)
+{
+   const unsigned short *map;
+
+   memcpy(message->code, output->b, output->length);
+
+   /* Generate error correction codewords */
+   RsEncode(message, enc->region.sizeIdx);
+
+   /* Module placement in region */
+   map = GetPlacementMap(&(enc->placeMap), &(enc->placeMapSizeIdx), enc->region.sizeIdx);
+   if(map == NULL)
+      return DmtxFail;
+
+   ModulePlacementEcc200(message->array, message->code, NULL, map,
+         enc->region.sizeIdx, DmtxModuleOnRGB);
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Convert input into message using specific encodation scheme
  * \param  buf
@@ -399,7 +529,7 @@ EncodeDataCodewords(DmtxByteList *input, DmtxByteList *output, int sizeIdxReques
          sizeIdx = EncodeOptimizeBest(input, output, sizeIdxRequest, fnc1);
          break;
       case DmtxSchemeAutoFast:
-         sizeIdx = DmtxUndefined; /* EncodeAutoFast(input, output, sizeIdxRequest, passFail); */
+         sizeIdx = EncodeAutoFast(input, output, sizeIdxRequest, fnc1);
          break;
       default:
          sizeIdx = EncodeSingleScheme(input, output, sizeIdxRequest, scheme, fnc1);
@@ -413,19 +543,21 @@ EncodeDataCodewords(DmtxByteList *input, DmtxByteList *output, int sizeIdxReques
  * \brief  Write encoded message to image
  * \param  enc
  * \return void
+ *
+ * Each symbol row is rendered once into its first pixel row as spans of
+ * equally colored modules, then copied to the other moduleSize - 1 rows.
  */
 static void
 PrintPattern(DmtxEncode *enc)
 {
-   int i, j;
-   int symbolRow, symbolCol;
-   int pixelRow, pixelCol;
-   int moduleStatus;
+   int i;
+   int symbolRow, symbolCol, runStart;
+   int pixelRow;
+   int moduleStatus, runStatus;
    size_t rowSize, height;
-   int rgb[3];
+   unsigned char *line;
    double sxy, txy;
    DmtxMatrix3 m1, m2;
-   DmtxVector2 vIn, vOut;
 
    txy = enc->marginSize;
    sxy = 1.0/enc->moduleSize;
@@ -443,43 +575,116 @@ PrintPattern(DmtxEncode *enc)
 
    memset(enc->image->pxl, 0xff, rowSize * height);
 
+   if(enc->moduleSize < 1)
+      return;
+
    for(symbolRow = 0; symbolRow < enc->region.symbolRows; symbolRow++) {
-      for(symbolCol = 0; symbolCol < enc->region.symbolCols; symbolCol++) {
-
-         vIn.X = symbolCol;
-         vIn.Y = symbolRow;
-
-         dmtxMatrix3VMultiply(&vOut, &vIn, enc->rxfrm);
-
-         pixelCol = (int)(vOut.X);
-         pixelRow = (int)(vOut.Y);
-
-         moduleStatus = dmtxSymbolModuleStatus(enc->message,
-               enc->region.sizeIdx, symbolRow, symbolCol);
-
-		 if (enc->image->bytesPerPixel == 1)
-		 {
-			 for(i = pixelRow; i < pixelRow + enc->moduleSize; i++) {
-				for(j = pixelCol; j < pixelCol + enc->moduleSize; j++) {
-				   rgb[0] = ((moduleStatus & DmtxModuleOnRed) != 0x00) ? 0 : 255;
-				   dmtxImageSetPixelValue(enc->image, j, i, 0, rgb[0]);
-				}
-			 }
-		 }
-		 else
-		 {
-			 for(i = pixelRow; i < pixelRow + enc->moduleSize; i++) {
-				 for(j = pixelCol; j < pixelCol + enc->moduleSize; j++) {
-					 rgb[0] = ((moduleStatus & DmtxModuleOnRed) != 0x00) ? 0 : 255;
-					 rgb[1] = ((moduleStatus & DmtxModuleOnGreen) != 0x00) ? 0 : 255;
-					 rgb[2] = ((moduleStatus & DmtxModuleOnBlue) != 0x00) ? 0 : 255;
-					 /*             dmtxImageSetRgb(enc->image, j, i, rgb); */
-					 dmtxImageSetPixelValue(enc->image, j, i, 0, rgb[0]);
-					 dmtxImageSetPixelValue(enc->image, j, i, 1, rgb[1]);
-					 dmtxImageSetPixelValue(enc->image, j, i, 2, rgb[2]);
-				 }
-			 }
-		 }
+
+      pixelRow = enc->marginSize + symbolRow * enc->moduleSize;
+      line = enc->image->pxl + dmtxImageGetByteOffset(enc->image, 0, pixelRow);
+
+      runStart = 0;
+      runStatus = dmtxSymbolModuleStatus(enc->message, enc->region.sizeIdx,
+            symbolRow, 0) & DmtxModuleOnRGB;
+
+      for(symbolCol = 1; symbolCol <= enc->region.symbolCols; symbolCol++) {
+
+         if(symbolCol < enc->region.symbolCols)
+            moduleStatus = dmtxSymbolModuleStatus(enc->message, enc->region.sizeIdx,
+                  symbolRow, symbolCol) & DmtxModuleOnRGB;
+         else
+            moduleStatus = DmtxUndefined;
+
+         if(moduleStatus != runStatus) {
+            PrintPatternSpan(enc->image, line, pixelRow,
+                  enc->marginSize + runStart * enc->moduleSize,
+                  (symbolCol - runStart) * enc->moduleSize, runStatus);
+            runStart = symbolCol;
+            runStatus = moduleStatus;
+         }
       }
+
+      for(i = 1; i < enc->moduleSize; i++)
+         memcpy(enc->image->pxl + dmtxImageGetByteOffset(enc->image, 0, pixelRow + i),
+               line, rowSize);
+   }
+}
+
+/**
+ * \brief  Write a horizontal span of identically colored pixels
+ * \param  img
+ * \param  line Start of the image row holding the span
+ * \param  pixelRow Row in image coordinates
+ * \param  pixelCol First column of the span
+ * \param  pixelCount Number of pixels in the span
+ * \param  moduleStatus Module color (DmtxModuleOnRed | DmtxModuleOnGreen | DmtxModuleOnBlue)
+ * \return void
+ *
+ * The image must already be painted white; only dark channels are written.
+ */
+static void
+PrintPatternSpan(DmtxImage *img, unsigned char *line, int pixelRow, int pixelCol,
+      int pixelCount, int moduleStatus)
+{
+   int i, channel, bytesPerPixel, pixelEnd;
+   unsigned char pixel[4];
+
+   if((moduleStatus & DmtxModuleOnRGB) == 0x00)
+      return;
+
+   pixelEnd = pixelCol + pixelCount;
+
+   switch(img->pixelPacking) {
+      case DmtxPack1bppK:
+         if(!(moduleStatus & DmtxModuleOnRed))
+            break;
+         /* Clear partial leading byte, whole bytes, then partial trailing byte */
+         for(i = pixelCol; i < pixelEnd && (i & 0x07) != 0; i++)
+            line[i >> 3] &= ~(0x80 >> (i & 0x07));
+         if(pixelEnd - i >= 8) {
+            memset(line + (i >> 3), 0x00, (pixelEnd - i) >> 3);
+            i += (pixelEnd - i) & ~0x07;
+         }
+         for(; i < pixelEnd; i++)
+            line[i >> 3] &= ~(0x80 >> (i & 0x07));
+         break;
+
+      case DmtxPack8bppK:
+         if(moduleStatus & DmtxModuleOnRed)
+            memset(line + pixelCol, 0x00, pixelCount);
+         break;
+
+      case DmtxPack24bppRGB:
+      case DmtxPack24bppBGR:
+      case DmtxPack24bppYCbCr:
+      case DmtxPack32bppRGBX:
+      case DmtxPack32bppXRGB:
+      case DmtxPack32bppBGRX:
+      case DmtxPack32bppXBGR:
+      case DmtxPack32bppCMYK:
+         /* Channels 0-2 occupy the first three bytes of each pixel as in
+            dmtxImageSetPixelValue(); any fourth byte stays white */
+         bytesPerPixel = img->bytesPerPixel;
+         if(moduleStatus == DmtxModuleOnRGB && bytesPerPixel == 3) {
+            memset(line + pixelCol * 3, 0x00, pixelCount * 3);
+            break;
+         }
+         pixel[0] = (moduleStatus & DmtxModuleOnRed) ? 0 : 255;
+         pixel[1] = (moduleStatus & DmtxModuleOnGreen) ? 0 : 255;
+         pixel[2] = (moduleStatus & DmtxModuleOnBlue) ? 0 : 255;
+         pixel[3] = 255;
+         for(i = pixelCol; i < pixelEnd; i++)
+            memcpy(line + i * bytesPerPixel, pixel, bytesPerPixel);
+         break;
+
+      default:
+         /* No direct writer for this packing; fall back to per pixel access */
+         for(i = pixelCol; i < pixelEnd; i++) {
+            for(channel = 0; channel < 3 && channel < img->channelCount; channel++) {
+               dmtxImageSetPixelValue(img, i, pixelRow, channel,
+                     (moduleStatus & (DmtxModuleOnRed << channel)) ? 0 : 255);
+            }
+         }
+         break;
    }
 }
@@ -185,12 +185,18 @@ EncodeTmpRemainingInAscii(DmtxEncodeStream *stream, DmtxByte *storage,
    }
 
    /*
-    * We stopped encoding before attempting to write beyond output boundary so
-    * any stream errors are truly unexpected. The passFail status indicates
+    * We stopped encoding before attempting to write beyond output boundary, so
+    * the only expected error is an extended ASCII value (2 codewords) landing
+    * on the last free slot. That still means the remaining input needs at
+    * least capacity codewords, which is all the caller wants to know. Any
+    * other stream error is truly unexpected. The passFail status indicates
     * whether output.length can be trusted by the calling function.
     */
 
-   if(streamAscii.status == DmtxStatusInvalid || streamAscii.status == DmtxStatusFatal)
+   if(streamAscii.status == DmtxStatusFatal && output.length == capacity &&
+         streamAscii.reason == dmtxErrorMessage[DmtxErrorOutOfBounds])
+      *passFail = DmtxPass;
+   else if(streamAscii.status == DmtxStatusInvalid || streamAscii.status == DmtxStatusFatal)
       *passFail = DmtxFail;
    else
       *passFail = DmtxPass;
@@ -41,8 +41,9 @@ EncodeNextChunkBase256(DmtxEncodeStream *stream)
 }
 
 /**
- *
- *
+ * Values are randomized for their position as they are appended. The chain
+ * header only reserves space here; its values are written once by
+ * CloseBase256Chain() when the final chain length is known.
  */
 static void
 AppendValueBase256(DmtxEncodeStream *stream, DmtxByte value)
@@ -89,6 +90,7 @@ CompleteIfDoneBase256(DmtxEncodeStream *stream, int sizeIdxRequest)
             {
                /* Perfect fit -- complete encoding */
                UpdateBase256ChainHeader(stream, sizeIdx); CHKERR;
+               CloseBase256Chain(stream, sizeIdx); CHKERR;
                StreamMarkComplete(stream, sizeIdx);
                return;
             }
@@ -104,22 +106,18 @@ CompleteIfDoneBase256(DmtxEncodeStream *stream, int sizeIdxRequest)
 }
 
 /**
- *
- *
+ * Keep the right number of header bytes in front of the chain. Only the size
+ * is maintained here; the header values are written by CloseBase256Chain().
  */
 static void
 UpdateBase256ChainHeader(DmtxEncodeStream *stream, int perfectSizeIdx)
 {
-   int headerIndex;
    int outputLength;
    int headerByteCount;
    int symbolDataWords;
    DmtxBoolean perfectFit;
-   DmtxByte headerValue0;
-   DmtxByte headerValue1;
 
    outputLength = stream->outputChainValueCount;
-   headerIndex = stream->output->length - stream->outputChainWordCount;
    headerByteCount = stream->outputChainWordCount - stream->outputChainValueCount;
    perfectFit = (perfectSizeIdx == DmtxUndefined) ? DmtxFalse : DmtxTrue;
 
@@ -138,34 +136,48 @@ UpdateBase256ChainHeader(DmtxEncodeStream *stream, int perfectSizeIdx)
    }
 
    /*
-    * Adjust header to hold correct number of bytes, not worrying about the
-    * values held there until below. Note: Header bytes are not considered
-    * scheme "values" so we can insert or remove them without updating the
-    * outputChainValueCount.
+    * Adjust header to hold correct number of bytes. Note: Header bytes are
+    * not considered scheme "values" so we can insert or remove them without
+    * updating the outputChainValueCount.
     */
 
    if(headerByteCount == 0 && stream->outputChainWordCount == 0)
    {
       /* No output words written yet -- insert single header byte */
       StreamOutputChainAppend(stream, 0); CHKERR;
-      headerByteCount++;
    }
    else if(!perfectFit && headerByteCount == 1 && outputLength > 249)
    {
       /* Beyond 249 bytes requires a second header byte */
       Base256OutputChainInsertFirst(stream); CHKERR;
-      headerByteCount++;
    }
    else if(perfectFit && headerByteCount == 2)
    {
       /* Encoding to exact end of symbol only requires single byte */
       Base256OutputChainRemoveFirst(stream); CHKERR;
-      headerByteCount--;
    }
+}
 
-   /*
-    * Encode header byte(s) with current length
-    */
+/**
+ * Write the final length header. Called exactly once when leaving Base 256 or
+ * when a perfect fit completes the symbol while still in Base 256.
+ */
+static void
+CloseBase256Chain(DmtxEncodeStream *stream, int perfectSizeIdx)
+{
+   int headerIndex;
+   int outputLength;
+   int headerByteCount;
+   DmtxBoolean perfectFit;
+   DmtxByte headerValue0;
+   DmtxByte headerValue1;
+
+   CHKSCHEME(DmtxSchemeBase256);
+
+   outputLength = stream->outputChainValueCount;
+   headerIndex = stream->output->length - stream->outputChainWordCount;
+   headerByteCount = stream->outputChainWordCount - stream->outputChainValueCount;
+   perfectFit = (perfectSizeIdx == DmtxUndefined) ? DmtxFalse : DmtxTrue;
 
    if(!perfectFit && headerByteCount == 1 && outputLength <= 249)
    {
@@ -191,7 +203,6 @@ UpdateBase256ChainHeader(DmtxEncodeStream *stream, int perfectSizeIdx)
    else
    {
       StreamMarkFatal(stream, DmtxErrorUnknown);
-      return;
    }
 }
 
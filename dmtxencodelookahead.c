@@ -0,0 +1,358 @@
+/**
+ * libdmtx - Data Matrix Encoding/Decoding Library
+ * Copyright 2011 Mike Laughton. All rights reserved.
+ * Copyright 2012-2016 Vadim A. Misbakh-Soloviov. All rights reserved.
+ *
+ * See LICENSE file in the main project directory for full
+ * terms of use and distribution.
+ *
+ * Contact:
+ * Vadim A. Misbakh-Soloviov <dmtx@mva.name>
+ * Mike Laughton <mike@dragonflylogic.com>
+ *
+ * \file dmtxencodelookahead.c
+ * \brief Logic for look-ahead (fast multiple scheme) encoding
+ */
+
+/**
+ * The look-ahead test from ISO/IEC 16022 Annex P keeps a running codeword
+ * cost for every scheme. Costs move in steps of 1/2 (ASCII digits), 1/3
+ * (C40/Text/X12 values) and 1/4 (EDIFACT values), so they are tracked here
+ * in twelfths of a codeword to keep all comparisons exact.
+ */
+#define LookAheadUnit 12
+
+/**
+ * \brief  Encode input using a single pass that picks each scheme by look-ahead
+ * \param  input
+ * \param  output
+ * \param  sizeIdxRequest
+ * \param  fnc1
+ * \return Symbol size index, or DmtxUndefined if encoding failed
+ *
+ * Unlike EncodeOptimizeBest() this carries only one stream, so compaction is
+ * usually close to (but not always as good as) the optimizer at a fraction
+ * of the work.
+ */
+static int
+EncodeAutoFast(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest, int fnc1)
+{
+   DmtxEncodeStream stream;
+   DmtxScheme targetScheme;
+
+   stream = StreamInit(input, output);
+   stream.fnc1 = fnc1;
+
+   /* 1st FNC1 special case, encode before scheme switch */
+   if(fnc1 != DmtxUndefined && (int)(input->b[0]) == fnc1)
+   {
+      StreamInputAdvanceNext(&stream);
+      AppendValueAscii(&stream, DmtxValueFNC1);
+   }
+
+   /* Continue encoding until complete, choosing a scheme for every chunk */
+   while(stream.status == DmtxStatusEncoding)
+   {
+      targetScheme = LookAheadNextScheme(&stream);
+      EncodeNextChunk(&stream, targetScheme, DmtxEncodeNormal, sizeIdxRequest);
+   }
+
+   /* Verify encoding completed and all inputs were consumed */
+   if(stream.status != DmtxStatusComplete || StreamInputHasNext(&stream))
+      return DmtxUndefined;
+
+   return stream.sizeIdx;
+}
+
+/**
+ * \brief  Choose the scheme for the next chunk of input
+ * \param  stream
+ * \return Target scheme
+ *
+ * Chunks in C40/Text/X12 always end on a value triplet boundary, so this is
+ * only ever consulted where a scheme change is legal.
+ */
+static DmtxScheme
+LookAheadNextScheme(DmtxEncodeStream *stream)
+{
+   int inputNext;
+   DmtxScheme currentScheme, targetScheme;
+   DmtxByteList *input = stream->input;
+
+   currentScheme = stream->currentScheme;
+
+   if(!StreamInputHasNext(stream))
+      return currentScheme;
+
+   /* Stay in the current scheme for as long as the look-ahead test agrees */
+   if(currentScheme != DmtxSchemeAscii &&
+         LookAheadTest(stream, currentScheme) == currentScheme &&
+         LookAheadChunkFits(stream, currentScheme) == DmtxTrue)
+   {
+      return currentScheme;
+   }
+
+   /* Otherwise decide as if returning to ASCII: digit pairs never leave it */
+   inputNext = stream->inputNext;
+   if(inputNext + 1 < input->length &&
+         ISDIGIT(input->b[inputNext]) && ISDIGIT(input->b[inputNext + 1]) &&
+         LookAheadIsFnc1(stream, input->b[inputNext + 1]) == DmtxFalse)
+   {
+      return DmtxSchemeAscii;
+   }
+
+   targetScheme = LookAheadTest(stream, DmtxSchemeAscii);
+   if(LookAheadChunkFits(stream, targetScheme) == DmtxFalse)
+      targetScheme = DmtxSchemeAscii;
+
+   return targetScheme;
+}
+
+/**
+ * \brief  Look-ahead test from ISO/IEC 16022 Annex P (steps J through S)
+ * \param  stream
+ * \param  currentScheme Scheme the encoder would be in at stream->inputNext
+ * \return Scheme that is expected to encode the upcoming input most compactly
+ */
+static DmtxScheme
+LookAheadTest(DmtxEncodeStream *stream, DmtxScheme currentScheme)
+{
+   int i, inputIdx, charsProcessed;
+   int count[DmtxSchemeBase256 + 1];
+   DmtxByte value;
+   DmtxBoolean isFnc1;
+   DmtxByteList *input = stream->input;
+
+   /* Step J: Initialize counts, favoring the current scheme */
+   if(currentScheme == DmtxSchemeAscii)
+   {
+      count[DmtxSchemeAscii] = 0;
+      count[DmtxSchemeC40] = count[DmtxSchemeText] = LookAheadUnit;
+      count[DmtxSchemeX12] = count[DmtxSchemeEdifact] = LookAheadUnit;
+      count[DmtxSchemeBase256] = (5 * LookAheadUnit) / 4;
+   }
+   else
+   {
+      count[DmtxSchemeAscii] = LookAheadUnit;
+      count[DmtxSchemeC40] = count[DmtxSchemeText] = 2 * LookAheadUnit;
+      count[DmtxSchemeX12] = count[DmtxSchemeEdifact] = 2 * LookAheadUnit;
+      count[DmtxSchemeBase256] = (9 * LookAheadUnit) / 4;
+      count[currentScheme] = 0;
+   }
+
+   for(inputIdx = stream->inputNext; ; inputIdx++)
+   {
+      /* Step K: End of data reached, compare whole codeword counts */
+      if(inputIdx == input->length)
+      {
+         for(i = DmtxSchemeAscii; i <= DmtxSchemeBase256; i++)
+            count[i] = ((count[i] + LookAheadUnit - 1) / LookAheadUnit) * LookAheadUnit;
+
+         if(LookAheadIsLeast(count, DmtxSchemeAscii, 0, DmtxTrue) == DmtxTrue)
+            return DmtxSchemeAscii;
+         if(LookAheadIsLeast(count, DmtxSchemeBase256, 0, DmtxFalse) == DmtxTrue)
+            return DmtxSchemeBase256;
+         if(LookAheadIsLeast(count, DmtxSchemeEdifact, 0, DmtxFalse) == DmtxTrue)
+            return DmtxSchemeEdifact;
+         if(LookAheadIsLeast(count, DmtxSchemeText, 0, DmtxFalse) == DmtxTrue)
+            return DmtxSchemeText;
+         if(LookAheadIsLeast(count, DmtxSchemeX12, 0, DmtxFalse) == DmtxTrue)
+            return DmtxSchemeX12;
+         return DmtxSchemeC40;
+      }
+
+      value = input->b[inputIdx];
+      isFnc1 = LookAheadIsFnc1(stream, value);
+
+      /* Step L: ASCII */
+      if(ISDIGIT(value) && isFnc1 == DmtxFalse)
+      {
+         count[DmtxSchemeAscii] += LookAheadUnit / 2;
+      }
+      else
+      {
+         count[DmtxSchemeAscii] = ((count[DmtxSchemeAscii] + LookAheadUnit - 1) /
+               LookAheadUnit) * LookAheadUnit;
+         count[DmtxSchemeAscii] += (value > 127 && isFnc1 == DmtxFalse) ?
+               2 * LookAheadUnit : LookAheadUnit;
+      }
+
+      /* Steps M, N, O: C40, Text, X12 */
+      count[DmtxSchemeC40] += LookAheadCTXCost(stream, value, DmtxSchemeC40);
+      count[DmtxSchemeText] += LookAheadCTXCost(stream, value, DmtxSchemeText);
+      count[DmtxSchemeX12] += LookAheadCTXCost(stream, value, DmtxSchemeX12);
+
+      /* Step P: EDIFACT */
+      if(isFnc1 == DmtxFalse && value >= 32 && value <= 94)
+         count[DmtxSchemeEdifact] += (3 * LookAheadUnit) / 4;
+      else if(isFnc1 == DmtxFalse && value > 127)
+         count[DmtxSchemeEdifact] += (17 * LookAheadUnit) / 4;
+      else
+         count[DmtxSchemeEdifact] += (13 * LookAheadUnit) / 4;
+
+      /* Step Q: Base 256 (function characters must leave via ASCII) */
+      count[DmtxSchemeBase256] += (isFnc1 == DmtxTrue) ? 4 * LookAheadUnit : LookAheadUnit;
+
+      /* Step R: Decide once at least 4 characters have been processed */
+      charsProcessed = inputIdx - stream->inputNext + 1;
+      if(charsProcessed < 4)
+         continue;
+
+      if(LookAheadIsLeast(count, DmtxSchemeAscii, LookAheadUnit, DmtxTrue) == DmtxTrue)
+         return DmtxSchemeAscii;
+
+      if(count[DmtxSchemeBase256] + LookAheadUnit <= count[DmtxSchemeAscii] ||
+            LookAheadIsLeast(count, DmtxSchemeBase256, LookAheadUnit, DmtxFalse) == DmtxTrue)
+         return DmtxSchemeBase256;
+
+      if(LookAheadIsLeast(count, DmtxSchemeEdifact, LookAheadUnit, DmtxFalse) == DmtxTrue)
+         return DmtxSchemeEdifact;
+      if(LookAheadIsLeast(count, DmtxSchemeText, LookAheadUnit, DmtxFalse) == DmtxTrue)
+         return DmtxSchemeText;
+      if(LookAheadIsLeast(count, DmtxSchemeX12, LookAheadUnit, DmtxFalse) == DmtxTrue)
+         return DmtxSchemeX12;
+
+      if(count[DmtxSchemeC40] + LookAheadUnit < count[DmtxSchemeAscii] &&
+            count[DmtxSchemeC40] + LookAheadUnit < count[DmtxSchemeBase256] &&
+            count[DmtxSchemeC40] + LookAheadUnit < count[DmtxSchemeEdifact] &&
+            count[DmtxSchemeC40] + LookAheadUnit < count[DmtxSchemeText])
+      {
+         if(count[DmtxSchemeC40] < count[DmtxSchemeX12])
+            return DmtxSchemeC40;
+
+         if(count[DmtxSchemeC40] == count[DmtxSchemeX12])
+         {
+            /* Step S: Prefer X12 only if a terminator or separator follows */
+            for(i = inputIdx + 1; i < input->length; i++)
+            {
+               value = input->b[i];
+               if(LookAheadIsFnc1(stream, value) == DmtxTrue)
+                  break;
+               if(value == 13 || value == 42 || value == 62)
+                  return DmtxSchemeX12;
+               if(LookAheadCTXCost(stream, value, DmtxSchemeX12) != (2 * LookAheadUnit) / 3)
+                  break;
+            }
+            return DmtxSchemeC40;
+         }
+      }
+   }
+}
+
+/**
+ * \brief  Cost of one input value in C40, Text, or X12 (in LookAheadUnits)
+ * \param  stream
+ * \param  value
+ * \param  scheme
+ * \return Cost
+ */
+static int
+LookAheadCTXCost(DmtxEncodeStream *stream, DmtxByte value, DmtxScheme scheme)
+{
+   DmtxBoolean isNative;
+
+   if(LookAheadIsFnc1(stream, value) == DmtxTrue)
+      return (scheme == DmtxSchemeX12) ? (10 * LookAheadUnit) / 3 : (4 * LookAheadUnit) / 3;
+
+   switch(scheme)
+   {
+      case DmtxSchemeC40:
+         isNative = (value == 32 || ISDIGIT(value) ||
+               (value >= 'A' && value <= 'Z')) ? DmtxTrue : DmtxFalse;
+         break;
+      case DmtxSchemeText:
+         isNative = (value == 32 || ISDIGIT(value) ||
+               (value >= 'a' && value <= 'z')) ? DmtxTrue : DmtxFalse;
+         break;
+      default:
+         isNative = (value == 13 || value == 42 || value == 62 || value == 32 ||
+               ISDIGIT(value) || (value >= 'A' && value <= 'Z')) ? DmtxTrue : DmtxFalse;
+         break;
+   }
+
+   if(isNative == DmtxTrue)
+      return (2 * LookAheadUnit) / 3;
+
+   if(scheme == DmtxSchemeX12)
+      return (value > 127) ? (13 * LookAheadUnit) / 3 : (10 * LookAheadUnit) / 3;
+
+   return (value > 127) ? (8 * LookAheadUnit) / 3 : (4 * LookAheadUnit) / 3;
+}
+
+/**
+ * \brief  Test whether one scheme's count beats all others by a margin
+ * \param  count
+ * \param  scheme
+ * \param  margin Amount added to count[scheme] before comparing
+ * \param  allowTie Accept equal counts (<=) instead of requiring (<)
+ * \return DmtxTrue | DmtxFalse
+ */
+static DmtxBoolean
+LookAheadIsLeast(const int *count, DmtxScheme scheme, int margin, DmtxBoolean allowTie)
+{
+   int i;
+
+   for(i = DmtxSchemeAscii; i <= DmtxSchemeBase256; i++)
+   {
+      if(i == (int)scheme)
+         continue;
+
+      if(count[scheme] + margin > count[i] ||
+            (allowTie == DmtxFalse && count[scheme] + margin == count[i]))
+         return DmtxFalse;
+   }
+
+   return DmtxTrue;
+}
+
+/**
+ * \brief  Verify the next chunk can be written in scheme without failing
+ * \param  stream
+ * \param  scheme
+ * \return DmtxTrue | DmtxFalse
+ *
+ * The look-ahead test only weighs costs, so it can pick X12 or EDIFACT even
+ * when the very next values are not representable there. Those chunks are
+ * written in ASCII instead and the test is repeated afterward.
+ */
+static DmtxBoolean
+LookAheadChunkFits(DmtxEncodeStream *stream, DmtxScheme scheme)
+{
+   int i, chunkSize;
+   DmtxByte value;
+
+   if(scheme == DmtxSchemeX12)
+      chunkSize = 3;
+   else if(scheme == DmtxSchemeEdifact)
+      chunkSize = 1;
+   else
+      return DmtxTrue;
+
+   for(i = stream->inputNext; i < stream->input->length && i < stream->inputNext + chunkSize; i++)
+   {
+      value = stream->input->b[i];
+      if(LookAheadIsFnc1(stream, value) == DmtxTrue)
+         return DmtxFalse;
+
+      if(scheme == DmtxSchemeX12 && LookAheadCTXCost(stream, value, DmtxSchemeX12) !=
+            (2 * LookAheadUnit) / 3)
+         return DmtxFalse;
+
+      if(scheme == DmtxSchemeEdifact && (value < 32 || value > 94))
+         return DmtxFalse;
+   }
+
+   return DmtxTrue;
+}
+
+/**
+ * \brief  Check for the stream's FNC1 stand-in character
+ * \param  stream
+ * \param  value
+ * \return DmtxTrue | DmtxFalse
+ */
+static DmtxBoolean
+LookAheadIsFnc1(DmtxEncodeStream *stream, DmtxByte value)
+{
+   return (stream->fnc1 != DmtxUndefined && (int)value == stream->fnc1) ? DmtxTrue : DmtxFalse;
+}
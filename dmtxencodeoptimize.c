@@ -38,105 +38,123 @@ enum SchemeState {
 };
 
 #if DUMPSTREAMS
-static void DumpStreams(DmtxEncodeStream *streamBest)
+static void DumpStreams(DmtxOptimizeNode *nodesBest)
 {
    enum SchemeState state;
-   char prefix[32];
+   DmtxEncodeStream *stream;
 
    fprintf(stdout, "----------------------------------------\n");
    for(state = 0; state < SchemeStateCount; state++)
    {
-      if(streamBest[state].status == DmtxStatusEncoding ||
-            streamBest[state].status == DmtxStatusComplete)
-         fprintf(stdout, "\"%c\" ", streamBest[state].input->b[streamBest[state].inputNext-1]);
+      stream = &(nodesBest[state].stream);
+
+      if(stream->status == DmtxStatusEncoding || stream->status == DmtxStatusComplete)
+         fprintf(stdout, "\"%c\" ", stream->input->b[stream->inputNext-1]);
       else
          fprintf(stdout, "    ");
 
-      switch(streamBest[state].status) {
+      switch(stream->status) {
          case DmtxStatusEncoding:
-            snprintf(prefix, sizeof(prefix), "%2d (%s): ", state, " encode ");
+            fprintf(stdout, "%2d (%s): ", state, " encode ");
             break;
          case DmtxStatusComplete:
-            snprintf(prefix, sizeof(prefix), "%2d (%s): ", state, "complete");
+            fprintf(stdout, "%2d (%s): ", state, "complete");
             break;
          case DmtxStatusInvalid:
-            snprintf(prefix, sizeof(prefix), "%2d (%s): ", state, "invalid ");
+            fprintf(stdout, "%2d (%s): ", state, "invalid ");
             break;
          case DmtxStatusFatal:
-            snprintf(prefix, sizeof(prefix), "%2d (%s): ", state, " fatal  ");
+            fprintf(stdout, "%2d (%s): ", state, " fatal  ");
             break;
       }
-      dmtxByteListPrint(streamBest[state].output, prefix);
+      fprintf(stdout, "%d words, last chunk %d\n", stream->output->length, nodesBest[state].chunk);
    }
 }
 #endif
 
 
 /**
- *
- *
+ * Dynamic programming over (input position, scheme state). Each state keeps
+ * one candidate stream, but streams carry only their scalar progress and
+ * output length -- the encoders never branch on codeword values, so all
+ * candidates write into one shared scratch buffer whose contents are never
+ * read back. Every chunk a candidate encodes is recorded as a back-pointer,
+ * and the winning codeword sequence is rebuilt once at the end by replaying
+ * its chunks on a real stream.
  */
 static int
 EncodeOptimizeBest(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest, int fnc1)
 {
    enum SchemeState state;
    int inputNext, c40ValueCount, textValueCount, x12ValueCount;
-   int sizeIdx;
-   DmtxEncodeStream *winner;
+   int sizeIdx, chunkCount;
+   DmtxOptimizeNode *winner;
+   DmtxOptimizeChunk *chunks;
    DmtxPassFail passFail;
-   DmtxEncodeStream streamsBest[SchemeStateCount];
-   DmtxEncodeStream streamsTemp[SchemeStateCount];
-   DmtxByte outputsBestStorage[SchemeStateCount][4096];
-   DmtxByte outputsTempStorage[SchemeStateCount][4096];
+   DmtxOptimizeNode nodesBest[SchemeStateCount];
+   DmtxOptimizeNode nodesTemp[SchemeStateCount];
+   DmtxByte scratchStorage[4096];
    DmtxByte ctxTempStorage[4];
-   DmtxByteList outputsBest[SchemeStateCount];
-   DmtxByteList outputsTemp[SchemeStateCount];
    DmtxByteList ctxTemp = dmtxByteListBuild(ctxTempStorage, sizeof(ctxTempStorage));
 
-   /* Initialize all streams with their own output storage */
+   if(input->length <= 0)
+      return DmtxUndefined;
+
+   /* Each input position commits at most one chunk per state */
+   chunks = (DmtxOptimizeChunk *)malloc(SchemeStateCount * input->length * sizeof(DmtxOptimizeChunk));
+   if(chunks == NULL)
+      return DmtxUndefined;
+   chunkCount = 0;
+
+   /* Initialize all nodes on top of the shared scratch output */
    for(state = 0; state < SchemeStateCount; state++)
    {
-      outputsBest[state] = dmtxByteListBuild(outputsBestStorage[state], sizeof(outputsBestStorage[state]));
-      outputsTemp[state] = dmtxByteListBuild(outputsTempStorage[state], sizeof(outputsTempStorage[state]));
-      streamsBest[state] = StreamInit(input, &(outputsBest[state]));
-      streamsTemp[state] = StreamInit(input, &(outputsTemp[state]));
-      streamsBest[state].fnc1 = fnc1;
-      streamsTemp[state].fnc1 = fnc1;
+      NodeInit(&(nodesBest[state]), input, scratchStorage, sizeof(scratchStorage), fnc1);
+      NodeInit(&(nodesTemp[state]), input, scratchStorage, sizeof(scratchStorage), fnc1);
    }
 
    c40ValueCount = textValueCount = x12ValueCount = 0;
 
    for(inputNext = 0; inputNext < input->length; inputNext++)
    {
-      StreamAdvanceFromBest(streamsTemp, streamsBest, AsciiFull, sizeIdxRequest);
+      StreamAdvanceFromBest(nodesTemp, nodesBest, AsciiFull, sizeIdxRequest);
 
-      AdvanceAsciiCompact(streamsTemp, streamsBest, AsciiCompactOffset0, inputNext, sizeIdxRequest);
-      AdvanceAsciiCompact(streamsTemp, streamsBest, AsciiCompactOffset1, inputNext, sizeIdxRequest);
+      AdvanceAsciiCompact(nodesTemp, nodesBest, AsciiCompactOffset0, inputNext, sizeIdxRequest);
+      AdvanceAsciiCompact(nodesTemp, nodesBest, AsciiCompactOffset1, inputNext, sizeIdxRequest);
 
-      AdvanceCTX(streamsTemp, streamsBest, C40Offset0, inputNext, c40ValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, C40Offset1, inputNext, c40ValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, C40Offset2, inputNext, c40ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, C40Offset0, inputNext, c40ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, C40Offset1, inputNext, c40ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, C40Offset2, inputNext, c40ValueCount, sizeIdxRequest);
 
-      AdvanceCTX(streamsTemp, streamsBest, TextOffset0, inputNext, textValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, TextOffset1, inputNext, textValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, TextOffset2, inputNext, textValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, TextOffset0, inputNext, textValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, TextOffset1, inputNext, textValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, TextOffset2, inputNext, textValueCount, sizeIdxRequest);
 
-      AdvanceCTX(streamsTemp, streamsBest, X12Offset0, inputNext, x12ValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, X12Offset1, inputNext, x12ValueCount, sizeIdxRequest);
-      AdvanceCTX(streamsTemp, streamsBest, X12Offset2, inputNext, x12ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, X12Offset0, inputNext, x12ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, X12Offset1, inputNext, x12ValueCount, sizeIdxRequest);
+      AdvanceCTX(nodesTemp, nodesBest, X12Offset2, inputNext, x12ValueCount, sizeIdxRequest);
 
-      AdvanceEdifact(streamsTemp, streamsBest, EdifactOffset0, inputNext, sizeIdxRequest);
-      AdvanceEdifact(streamsTemp, streamsBest, EdifactOffset1, inputNext, sizeIdxRequest);
-      AdvanceEdifact(streamsTemp, streamsBest, EdifactOffset2, inputNext, sizeIdxRequest);
-      AdvanceEdifact(streamsTemp, streamsBest, EdifactOffset3, inputNext, sizeIdxRequest);
+      AdvanceEdifact(nodesTemp, nodesBest, EdifactOffset0, inputNext, sizeIdxRequest);
+      AdvanceEdifact(nodesTemp, nodesBest, EdifactOffset1, inputNext, sizeIdxRequest);
+      AdvanceEdifact(nodesTemp, nodesBest, EdifactOffset2, inputNext, sizeIdxRequest);
+      AdvanceEdifact(nodesTemp, nodesBest, EdifactOffset3, inputNext, sizeIdxRequest);
 
-      StreamAdvanceFromBest(streamsTemp, streamsBest, Base256, sizeIdxRequest);
+      StreamAdvanceFromBest(nodesTemp, nodesBest, Base256, sizeIdxRequest);
 
-      /* Overwrite best streams with new results */
+      /* Overwrite best nodes with new results, committing their latest chunk */
       for(state = 0; state < SchemeStateCount; state++)
       {
-         if(streamsBest[state].status != DmtxStatusComplete)
-            StreamCopy(&(streamsBest[state]), &(streamsTemp[state]));
+         if(nodesBest[state].stream.status == DmtxStatusComplete)
+            continue;
+
+         if(nodesTemp[state].hasPending == DmtxTrue)
+         {
+            chunks[chunkCount] = nodesTemp[state].pending;
+            nodesTemp[state].chunk = chunkCount++;
+            nodesTemp[state].hasPending = DmtxFalse;
+         }
+
+         NodeCopy(&(nodesBest[state]), &(nodesTemp[state]));
       }
 
       dmtxByteListClear(&ctxTemp);
@@ -152,7 +170,7 @@ EncodeOptimizeBest(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest
       x12ValueCount += ((passFail == DmtxPass) ? ctxTemp.length : 1);
 
 #if DUMPSTREAMS
-      DumpStreams(streamsBest);
+      DumpStreams(nodesBest);
 #endif
    }
 
@@ -160,25 +178,108 @@ EncodeOptimizeBest(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest
    winner = NULL;
    for(state = 0; state < SchemeStateCount; state++)
    {
-      if(streamsBest[state].status == DmtxStatusComplete)
+      if(nodesBest[state].stream.status == DmtxStatusComplete)
       {
-         if(winner == NULL || streamsBest[state].output->length < winner->output->length)
-            winner = &(streamsBest[state]);
+         if(winner == NULL || nodesBest[state].output.length < winner->output.length)
+            winner = &(nodesBest[state]);
       }
    }
 
-   /* Copy winner to output */
+   /* Rebuild winner into output */
    if(winner == NULL)
-   {
       sizeIdx = DmtxUndefined;
-   }
    else
+      sizeIdx = ReplayChunks(input, output, chunks, winner->chunk, sizeIdxRequest, fnc1);
+
+   free(chunks);
+
+   return sizeIdx;
+}
+
+/**
+ * \brief  Encode the chunk sequence ending at lastChunk into output
+ * \param  input
+ * \param  output
+ * \param  chunks Chunk records; links along the replayed path are reversed
+ * \param  lastChunk
+ * \param  sizeIdxRequest
+ * \param  fnc1
+ * \return Symbol size index, or DmtxUndefined if replay did not complete
+ */
+static int
+ReplayChunks(DmtxByteList *input, DmtxByteList *output, DmtxOptimizeChunk *chunks,
+      int lastChunk, int sizeIdxRequest, int fnc1)
+{
+   int chunk, next, prev;
+   DmtxEncodeStream stream;
+
+   /* Reverse back-pointers in place so the path can be walked forward */
+   prev = DmtxUndefined;
+   for(chunk = lastChunk; chunk != DmtxUndefined; chunk = next)
    {
-      dmtxByteListCopy(output, winner->output, &passFail);
-      sizeIdx = (passFail == DmtxPass) ? winner->sizeIdx : DmtxUndefined;
+      next = chunks[chunk].prev;
+      chunks[chunk].prev = prev;
+      prev = chunk;
    }
 
-   return sizeIdx;
+   dmtxByteListClear(output);
+   stream = StreamInit(input, output);
+   stream.fnc1 = fnc1;
+
+   for(chunk = prev; chunk != DmtxUndefined; chunk = chunks[chunk].prev)
+   {
+      EncodeNextChunk(&stream, chunks[chunk].scheme, chunks[chunk].option, sizeIdxRequest);
+      if(stream.status == DmtxStatusInvalid || stream.status == DmtxStatusFatal)
+         return DmtxUndefined;
+   }
+
+   return (stream.status == DmtxStatusComplete) ? stream.sizeIdx : DmtxUndefined;
+}
+
+/**
+ *
+ *
+ */
+static void
+NodeInit(DmtxOptimizeNode *node, DmtxByteList *input, DmtxByte *scratch, int capacity, int fnc1)
+{
+   node->output = dmtxByteListBuild(scratch, capacity);
+   node->stream = StreamInit(input, &(node->output));
+   node->stream.fnc1 = fnc1;
+   node->chunk = DmtxUndefined;
+   node->hasPending = DmtxFalse;
+}
+
+/**
+ * Copies progress only. Output storage is shared, so the list header (and
+ * with it the length) comes along without touching any codewords.
+ */
+static void
+NodeCopy(DmtxOptimizeNode *dst, DmtxOptimizeNode *src)
+{
+   dst->stream = src->stream;
+   dst->output = src->output;
+   dst->stream.output = &(dst->output);
+   dst->chunk = src->chunk;
+   dst->pending = src->pending;
+   dst->hasPending = src->hasPending;
+}
+
+/**
+ * Every advance starts from a committed node, so a node holds at most one
+ * pending chunk until the end of the current input position.
+ */
+static void
+NodeEncodeNextChunk(DmtxOptimizeNode *node, int scheme, int option, int sizeIdxRequest)
+{
+   assert(node->hasPending == DmtxFalse);
+
+   node->pending.prev = node->chunk;
+   node->pending.scheme = (signed char)scheme;
+   node->pending.option = (signed char)option;
+   node->hasPending = DmtxTrue;
+
+   EncodeNextChunk(&(node->stream), scheme, option, sizeIdxRequest);
 }
 
 /**
@@ -187,18 +288,15 @@ EncodeOptimizeBest(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest
  * is the number of latches/unlatches that are also encoded
  */
 static void
-StreamAdvanceFromBest(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
+StreamAdvanceFromBest(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
      int targetState, int sizeIdxRequest)
 {
    enum SchemeState fromState;
    DmtxScheme targetScheme;
    DmtxEncodeOption encodeOption;
-   DmtxByte outputTempStorage[4096];
-   DmtxByteList outputTemp = dmtxByteListBuild(outputTempStorage, sizeof(outputTempStorage));
-   DmtxEncodeStream streamTemp;
-   DmtxEncodeStream *targetStream = &(streamsNext[targetState]);
+   DmtxOptimizeNode nodeTemp;
+   DmtxOptimizeNode *targetNode = &(nodesNext[targetState]);
 
-   streamTemp.output = &outputTemp; /* Set directly instead of calling StreamInit() */
    targetScheme = GetScheme(targetState);
 
    if(targetState == AsciiFull)
@@ -210,19 +308,19 @@ StreamAdvanceFromBest(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBe
 
    for(fromState = 0; fromState < SchemeStateCount; fromState++)
    {
-      if(streamsBest[fromState].status != DmtxStatusEncoding ||
+      if(nodesBest[fromState].stream.status != DmtxStatusEncoding ||
             ValidStateSwitch(fromState, targetState) == DmtxFalse)
       {
          continue;
       }
 
-      StreamCopy(&streamTemp, &(streamsBest[fromState]));
-      EncodeNextChunk(&streamTemp, targetScheme, encodeOption, sizeIdxRequest);
+      NodeCopy(&nodeTemp, &(nodesBest[fromState]));
+      NodeEncodeNextChunk(&nodeTemp, targetScheme, encodeOption, sizeIdxRequest);
 
-      if(fromState == 0 || (streamTemp.status != DmtxStatusInvalid &&
-            streamTemp.output->length < targetStream->output->length))
+      if(fromState == 0 || (nodeTemp.stream.status != DmtxStatusInvalid &&
+            nodeTemp.output.length < targetNode->output.length))
       {
-         StreamCopy(targetStream, &streamTemp);
+         NodeCopy(targetNode, &nodeTemp);
       }
    }
 }
@@ -231,11 +329,11 @@ StreamAdvanceFromBest(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBe
  *
  */
 static void
-AdvanceAsciiCompact(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
+AdvanceAsciiCompact(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int targetState, int inputNext, int sizeIdxRequest)
 {
-   DmtxEncodeStream *currentStream = &(streamsBest[targetState]);
-   DmtxEncodeStream *targetStream = &(streamsNext[targetState]);
+   DmtxOptimizeNode *currentNode = &(nodesBest[targetState]);
+   DmtxOptimizeNode *targetNode = &(nodesNext[targetState]);
    DmtxBoolean isStartState;
 
    switch(targetState)
@@ -249,22 +347,22 @@ AdvanceAsciiCompact(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest
          break;
 
       default:
-         StreamMarkFatal(targetStream, DmtxErrorIllegalParameterValue);
+         StreamMarkFatal(&(targetNode->stream), DmtxErrorIllegalParameterValue);
          return;
    }
 
-   if(inputNext < currentStream->inputNext)
+   if(inputNext < currentNode->stream.inputNext)
    {
-      StreamCopy(targetStream, currentStream);
+      NodeCopy(targetNode, currentNode);
    }
    else if(isStartState == DmtxTrue)
    {
-      StreamAdvanceFromBest(streamsNext, streamsBest, targetState, sizeIdxRequest);
+      StreamAdvanceFromBest(nodesNext, nodesBest, targetState, sizeIdxRequest);
    }
    else
    {
-      StreamCopy(targetStream, currentStream);
-      StreamMarkInvalid(targetStream, DmtxErrorUnknown);
+      NodeCopy(targetNode, currentNode);
+      StreamMarkInvalid(&(targetNode->stream), DmtxErrorUnknown);
    }
 }
 
@@ -272,11 +370,11 @@ AdvanceAsciiCompact(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest
  *
  */
 static void
-AdvanceCTX(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
+AdvanceCTX(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int targetState, int inputNext, int ctxValueCount, int sizeIdxRequest)
 {
-   DmtxEncodeStream *currentStream = &(streamsBest[targetState]);
-   DmtxEncodeStream *targetStream = &(streamsNext[targetState]);
+   DmtxOptimizeNode *currentNode = &(nodesBest[targetState]);
+   DmtxOptimizeNode *targetNode = &(nodesNext[targetState]);
    DmtxBoolean isStartState;
 
    /* we won't actually use inputNext here */
@@ -301,22 +399,22 @@ AdvanceCTX(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
          break;
 
       default:
-         StreamMarkFatal(targetStream, DmtxErrorIllegalParameterValue);
+         StreamMarkFatal(&(targetNode->stream), DmtxErrorIllegalParameterValue);
          return;
    }
 
-   if(inputNext < currentStream->inputNext)
+   if(inputNext < currentNode->stream.inputNext)
    {
-      StreamCopy(targetStream, currentStream);
+      NodeCopy(targetNode, currentNode);
    }
    else if(isStartState == DmtxTrue)
    {
-      StreamAdvanceFromBest(streamsNext, streamsBest, targetState, sizeIdxRequest);
+      StreamAdvanceFromBest(nodesNext, nodesBest, targetState, sizeIdxRequest);
    }
    else
    {
-      StreamCopy(targetStream, currentStream);
-      StreamMarkInvalid(targetStream, DmtxErrorUnknown);
+      NodeCopy(targetNode, currentNode);
+      StreamMarkInvalid(&(targetNode->stream), DmtxErrorUnknown);
    }
 }
 
@@ -324,11 +422,11 @@ AdvanceCTX(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
  *
  */
 static void
-AdvanceEdifact(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
+AdvanceEdifact(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int targetState, int inputNext, int sizeIdxRequest)
 {
-   DmtxEncodeStream *currentStream = &(streamsBest[targetState]);
-   DmtxEncodeStream *targetStream = &(streamsNext[targetState]);
+   DmtxOptimizeNode *currentNode = &(nodesBest[targetState]);
+   DmtxOptimizeNode *targetNode = &(nodesNext[targetState]);
    DmtxBoolean isStartState;
 
    switch(targetState)
@@ -350,21 +448,22 @@ AdvanceEdifact(DmtxEncodeStream *streamsNext, DmtxEncodeStream *streamsBest,
          break;
 
       default:
-         StreamMarkFatal(targetStream, DmtxErrorIllegalParameterValue);
+         StreamMarkFatal(&(targetNode->stream), DmtxErrorIllegalParameterValue);
          return;
    }
 
    if(isStartState == DmtxTrue)
    {
-      StreamAdvanceFromBest(streamsNext, streamsBest, targetState, sizeIdxRequest);
+      StreamAdvanceFromBest(nodesNext, nodesBest, targetState, sizeIdxRequest);
    }
    else
    {
-      StreamCopy(targetStream, currentStream);
-      if(currentStream->status == DmtxStatusEncoding && currentStream->currentScheme == DmtxSchemeEdifact)
-         EncodeNextChunk(targetStream, DmtxSchemeEdifact, DmtxEncodeNormal, sizeIdxRequest);
+      NodeCopy(targetNode, currentNode);
+      if(currentNode->stream.status == DmtxStatusEncoding &&
+            currentNode->stream.currentScheme == DmtxSchemeEdifact)
+         NodeEncodeNextChunk(targetNode, DmtxSchemeEdifact, DmtxEncodeNormal, sizeIdxRequest);
       else
-         StreamMarkInvalid(targetStream, DmtxErrorUnknown);
+         StreamMarkInvalid(&(targetNode->stream), DmtxErrorUnknown);
    }
 }
 
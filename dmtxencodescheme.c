@@ -192,10 +192,13 @@ EncodeChangeScheme(DmtxEncodeStream *stream, DmtxScheme targetScheme, int unlatc
             AppendValueEdifact(stream, DmtxValueEdifactUnlatch); CHKERR;
          }
          break;
+      case DmtxSchemeBase256:
+         /* No unlatch value, but the chain still needs its length header */
+         CloseBase256Chain(stream, DmtxUndefined); CHKERR;
+         break;
       default:
-         /* Nothing to do for ASCII or Base 256 */
-         assert(stream->currentScheme == DmtxSchemeAscii ||
-               stream->currentScheme == DmtxSchemeBase256);
+         /* Nothing to do for ASCII */
+         assert(stream->currentScheme == DmtxSchemeAscii);
          break;
    }
    stream->currentScheme = DmtxSchemeAscii;
@@ -37,28 +37,6 @@ StreamInit(DmtxByteList *input, DmtxByteList *output)
    return stream;
 }
 
-/**
- *
- *
- */
-static void
-StreamCopy(DmtxEncodeStream *dst, DmtxEncodeStream *src)
-{
-   DmtxPassFail passFail;
-
-   dst->currentScheme = src->currentScheme;
-   dst->inputNext = src->inputNext;
-   dst->outputChainValueCount = src->outputChainValueCount;
-   dst->outputChainWordCount = src->outputChainWordCount;
-   dst->reason = src->reason;
-   dst->sizeIdx = src->sizeIdx;
-   dst->status = src->status;
-   dst->input = src->input;
-   dst->fnc1 = src->fnc1;
-
-   dmtxByteListCopy(dst->output, src->output, &passFail);
-}
-
 /**
  *
  *
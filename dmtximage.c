@@ -79,7 +79,7 @@ dmtxImageCreate(unsigned char *pxl, int width, int height, int pack)
    img->bitsPerPixel = GetBitsPerPixel(pack);
    img->bytesPerPixel = img->bitsPerPixel/8;
    img->rowPadBytes = 0;
-   img->rowSizeBytes = img->width * img->bytesPerPixel + img->rowPadBytes;
+   img->rowSizeBytes = (img->width * img->bitsPerPixel + 7) / 8 + img->rowPadBytes;
    img->imageFlip = DmtxFlipNone;
 
    /* Leave channelStart[] and bitsPerChannel[] with zeros from calloc */
@@ -90,8 +90,7 @@ dmtxImageCreate(unsigned char *pxl, int width, int height, int pack)
          break;
       case DmtxPack1bppK:
          dmtxImageSetChannel(img, 0, 1);
-         return NULL; /* unsupported packing order */
-/*       break; */
+         break;
       case DmtxPack8bppK:
          dmtxImageSetChannel(img, 0, 8);
          break;
@@ -195,7 +194,7 @@ dmtxImageSetProp(DmtxImage *img, int prop, int value)
    switch(prop) {
       case DmtxPropRowPadBytes:
          img->rowPadBytes = value;
-         img->rowSizeBytes = img->width * (img->bitsPerPixel/8) + img->rowPadBytes;
+         img->rowSizeBytes = (img->width * img->bitsPerPixel + 7) / 8 + img->rowPadBytes;
          break;
       case DmtxPropImageFlip:
          img->imageFlip = value;
@@ -254,16 +253,21 @@ dmtxImageGetProp(DmtxImage *img, int prop)
 extern int
 dmtxImageGetByteOffset(DmtxImage *img, int x, int y)
 {
+   int xOffset;
+
    assert(img != NULL);
    assert(!(img->imageFlip & DmtxFlipX)); /* DmtxFlipX is not an option */
 
    if(dmtxImageContainsInt(img, 0, x, y) == DmtxFalse)
       return DmtxUndefined;
 
+   /* 1 bpp pixels share bytes; return the byte holding the pixel */
+   xOffset = (img->bitsPerPixel == 1) ? (x >> 3) : x * img->bytesPerPixel;
+
    if(img->imageFlip & DmtxFlipY)
-      return (y * img->rowSizeBytes + x * img->bytesPerPixel);
+      return (y * img->rowSizeBytes + xOffset);
 
-   return ((img->height - y - 1) * img->rowSizeBytes + x * img->bytesPerPixel);
+   return ((img->height - y - 1) * img->rowSizeBytes + xOffset);
 }
 
 /**
@@ -288,9 +292,8 @@ dmtxImageGetPixelValue(DmtxImage *img, int x, int y, int channel, int *value)
 
    switch(img->bitsPerChannel[channel]) {
       case 1:
-/*       assert(img->bitsPerPixel == 1);
-         mask = 0x01 << (7 - offset%8);
-         *value = (img->pxl[offset/8] & mask) ? 255 : 0; */
+         assert(img->bitsPerPixel == 1);
+         *value = (img->pxl[offset] & (0x80 >> (x & 0x07))) ? 255 : 0;
          break;
       case 5:
          /* XXX might be expensive if we want to scale perfect 0-255 range */
@@ -333,9 +336,12 @@ dmtxImageSetPixelValue(DmtxImage *img, int x, int y, int channel, int value)
 
    switch(img->bitsPerChannel[channel]) {
       case 1:
-/*       assert(img->bitsPerPixel == 1);
-         mask = 0x01 << (7 - offset%8);
-         *value = (img->pxl[offset/8] & mask) ? 255 : 0; */
+         /* Set bits are white, matching dmtxImageGetPixelValue() */
+         assert(img->bitsPerPixel == 1);
+         if(value > 127)
+            img->pxl[offset] |= (0x80 >> (x & 0x07));
+         else
+            img->pxl[offset] &= ~(0x80 >> (x & 0x07));
          break;
       case 5:
          /* XXX might be expensive if we want to scale perfect 0-255 range */
@@ -72,6 +72,83 @@ dmtxMessageCreate(int sizeIdx, int symbolFormat)
    return message;
 }
 
+/**
+ * \brief  Number of bytes of storage needed by dmtxMessageInit()
+ * \param  sizeIdx Symbol size, or DmtxUndefined for the largest of any size
+ * \param  symbolFormat DmtxFormatMatrix | DmtxFormatMosaic
+ * \return Storage size in bytes
+ */
+extern size_t
+dmtxMessageGetStorageSize(int sizeIdx, int symbolFormat)
+{
+   int i;
+   size_t arraySize, codeSize, storageSize;
+
+   assert(symbolFormat == DmtxFormatMatrix || symbolFormat == DmtxFormatMosaic);
+
+   if(sizeIdx == DmtxUndefined) {
+      storageSize = 0;
+      for(i = 0; i < DmtxSymbolSquareCount + DmtxSymbolRectCount; i++)
+         storageSize = max(storageSize, dmtxMessageGetStorageSize(i, symbolFormat));
+      return storageSize;
+   }
+
+   arraySize = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixRows, sizeIdx) *
+         dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixCols, sizeIdx);
+   codeSize = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx) +
+         dmtxGetSymbolAttribute(DmtxSymAttribSymbolErrorWords, sizeIdx);
+
+   if(symbolFormat == DmtxFormatMosaic)
+      codeSize *= 3;
+
+   /* Array, code words, and output sized as in dmtxMessageCreate() */
+   return arraySize + codeSize + codeSize * 10;
+}
+
+/**
+ * \brief  Initialize message using caller provided storage
+ * \param  msg
+ * \param  sizeIdx
+ * \param  symbolFormat DmtxFormatMatrix | DmtxFormatMosaic
+ * \param  storage
+ * \param  storageSize Must be at least dmtxMessageGetStorageSize(sizeIdx, symbolFormat)
+ * \return DmtxPass | DmtxFail
+ * \note   Messages initialized this way must not be passed to dmtxMessageDestroy()
+ */
+extern DmtxPassFail
+dmtxMessageInit(DmtxMessage *msg, int sizeIdx, int symbolFormat,
+      unsigned char *storage, size_t storageSize)
+{
+   size_t requiredSize;
+
+   if(msg == NULL || storage == NULL || sizeIdx < 0 ||
+         sizeIdx >= DmtxSymbolSquareCount + DmtxSymbolRectCount)
+      return DmtxFail;
+
+   requiredSize = dmtxMessageGetStorageSize(sizeIdx, symbolFormat);
+   if(storageSize < requiredSize)
+      return DmtxFail;
+
+   memset(msg, 0x00, sizeof(DmtxMessage));
+   memset(storage, 0x00, requiredSize);
+
+   msg->arraySize = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixRows, sizeIdx) *
+         dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixCols, sizeIdx);
+   msg->codeSize = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx) +
+         dmtxGetSymbolAttribute(DmtxSymAttribSymbolErrorWords, sizeIdx);
+
+   if(symbolFormat == DmtxFormatMosaic)
+      msg->codeSize *= 3;
+
+   msg->outputSize = msg->codeSize * 10;
+
+   msg->array = storage;
+   msg->code = msg->array + msg->arraySize;
+   msg->output = msg->code + msg->codeSize;
+
+   return DmtxPass;
+}
+
 /**
  * \brief  Free memory previously allocated for message
  * \param  message
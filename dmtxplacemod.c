@@ -14,6 +14,9 @@
  * \brief Data Matrix module placement
  */
 
+/* Unsure count of codeword i (if counts are being kept) */
+#define UnsureWord(u,i) (((u) == NULL) ? NULL : &((u)[(i)]))
+
 /**
  * receives symbol row and col and returns status
  * DmtxModuleOn / !DmtxModuleOn (DmtxModuleOff)
@@ -60,20 +63,146 @@ dmtxSymbolModuleStatus(DmtxMessage *message, int sizeIdx, int symbolRow, int sym
  * \brief  Logical relationship between bit and module locations
  * \param  modules
  * \param  codewords
+ * \param  unsure Per-codeword count of DmtxModuleUnsure modules, or NULL
+ * \param  map Placement map built for sizeIdx by BuildPlacementMap()
  * \param  sizeIdx
  * \param  moduleOnColor
  * \return Number of codewords read
  */
 static int
-ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, int sizeIdx, int moduleOnColor)
+ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, unsigned char *unsure,
+      const unsigned short *map, int sizeIdx, int moduleOnColor)
 {
-   int row, col, chr;
+   int chr, bit, codewordCount;
    int mappingRows, mappingCols;
+   const DmtxSymbolLayout *layout;
 
    assert(moduleOnColor & (DmtxModuleOnRed | DmtxModuleOnGreen | DmtxModuleOnBlue));
 
-   mappingRows = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixRows, sizeIdx);
-   mappingCols = dmtxGetSymbolAttribute(DmtxSymAttribMappingMatrixCols, sizeIdx);
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
+      return 0;
+
+   mappingRows = layout->mappingRows;
+   mappingCols = layout->mappingCols;
+   codewordCount = layout->symbolDataWords + layout->symbolErrorWords;
+
+   /* Gather (decode) or scatter (encode) each codeword's 8 modules */
+   for(chr = 0; chr < codewordCount; chr++, map += 8) {
+      for(bit = 0; bit < 8; bit++)
+         PlaceModule(modules, map[bit], &(codewords[chr]), UnsureWord(unsure, chr),
+               0x01 << bit, moduleOnColor);
+   }
+
+   /* If lower righthand corner is untouched then fill in the fixed pattern */
+   if(!(modules[mappingRows * mappingCols - 1] &
+         DmtxModuleVisited)) {
+
+      modules[mappingRows * mappingCols - 1] |= moduleOnColor;
+      modules[(mappingRows * mappingCols) - mappingCols - 2] |= moduleOnColor;
+   } /* XXX should this fixed pattern also be used in reading somehow? */
+
+   return codewordCount;
+}
+
+/**
+ * \brief  Return placement map for sizeIdx, building it on first use
+ * \param  map Map storage owned by the caller (allocated here if NULL)
+ * \param  mapSizeIdx Size currently held in map, or DmtxUndefined
+ * \param  sizeIdx
+ * \return Placement map, or NULL if storage could not be allocated
+ */
+static const unsigned short *
+GetPlacementMap(unsigned short **map, int *mapSizeIdx, int sizeIdx)
+{
+   if(*map == NULL) {
+      *map = (unsigned short *)malloc(DmtxPlacementMapMax * sizeof(unsigned short));
+      if(*map == NULL)
+         return NULL;
+      *mapSizeIdx = DmtxUndefined;
+   }
+
+   if(*mapSizeIdx != sizeIdx) {
+      if(BuildPlacementMap(*map, sizeIdx) == DmtxFail) {
+         *mapSizeIdx = DmtxUndefined;
+         return NULL;
+      }
+      *mapSizeIdx = sizeIdx;
+   }
+
+   return *map;
+}
+
+/**
+ * \brief  Return the process-wide placement map for sizeIdx, building it on first use
+ * \param  sizeIdx
+ * \return Placement map, or NULL if it could not be built
+ *
+ * For callers with no decoder or encoder to keep a map in, such as
+ * dmtxDecodePopulatedArray(). Every lookup takes the lock. Maps are built at
+ * most once per symbol size and are never freed; they stay allocated until
+ * the process exits, which bounds the retained memory to one map per size.
+ */
+static const unsigned short *
+GetSharedPlacementMap(int sizeIdx)
+{
+   static unsigned short *sharedMap[DmtxSymbolSquareCount + DmtxSymbolRectCount];
+#ifdef HAVE_PTHREAD_H
+   static pthread_mutex_t sharedMapMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+   unsigned short *map;
+   const DmtxSymbolLayout *layout;
+
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
+      return NULL;
+
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_lock(&sharedMapMutex);
+#endif
+   if(sharedMap[sizeIdx] == NULL) {
+      map = (unsigned short *)malloc(layout->mappingRows * layout->mappingCols *
+            sizeof(unsigned short));
+      if(map != NULL && BuildPlacementMap(map, sizeIdx) == DmtxFail) {
+         free(map);
+         map = NULL;
+      }
+      sharedMap[sizeIdx] = map;
+   }
+   map = sharedMap[sizeIdx];
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_unlock(&sharedMapMutex);
+#endif
+
+   return map;
+}
+
+/**
+ * \brief  Record module index of every codeword bit for a symbol size
+ * \param  map Receives 8 entries per codeword, entry n holding the bit masked by (0x01 << n)
+ * \param  sizeIdx
+ * \return DmtxPass | DmtxFail
+ *
+ * Walks the ECC200 diagonal placement once. The map only depends on sizeIdx,
+ * so placing or reading codewords afterward is a simple gather or scatter.
+ */
+static DmtxPassFail
+BuildPlacementMap(unsigned short *map, int sizeIdx)
+{
+   int row, col, chr;
+   int mappingRows, mappingCols;
+   unsigned char visited[DmtxPlacementMapMax];
+   const DmtxSymbolLayout *layout;
+
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
+      return DmtxFail;
+
+   mappingRows = layout->mappingRows;
+   mappingCols = layout->mappingCols;
+   assert(mappingRows * mappingCols <= DmtxPlacementMapMax);
+
+   memset(visited, 0x00, mappingRows * mappingCols);
 
    /* Start in the nominal location for the 8th bit of the first character */
    chr = 0;
@@ -83,19 +212,19 @@ ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, int size
    do {
       /* Repeatedly first check for one of the special corner cases */
       if((row == mappingRows) && (col == 0))
-         PatternShapeSpecial1(modules, mappingRows, mappingCols, &(codewords[chr++]), moduleOnColor);
+         PatternShapeSpecial1(&(map[8 * chr++]), visited, mappingRows, mappingCols);
       else if((row == mappingRows-2) && (col == 0) && (mappingCols%4 != 0))
-         PatternShapeSpecial2(modules, mappingRows, mappingCols, &(codewords[chr++]), moduleOnColor);
+         PatternShapeSpecial2(&(map[8 * chr++]), visited, mappingRows, mappingCols);
       else if((row == mappingRows-2) && (col == 0) && (mappingCols%8 == 4))
-         PatternShapeSpecial3(modules, mappingRows, mappingCols, &(codewords[chr++]), moduleOnColor);
+         PatternShapeSpecial3(&(map[8 * chr++]), visited, mappingRows, mappingCols);
       else if((row == mappingRows+4) && (col == 2) && (mappingCols%8 == 0))
-         PatternShapeSpecial4(modules, mappingRows, mappingCols, &(codewords[chr++]), moduleOnColor);
+         PatternShapeSpecial4(&(map[8 * chr++]), visited, mappingRows, mappingCols);
 
       /* Sweep upward diagonally, inserting successive characters */
       do {
          if((row < mappingRows) && (col >= 0) &&
-               !(modules[row*mappingCols+col] & DmtxModuleVisited))
-            PatternShapeStandard(modules, mappingRows, mappingCols, row, col, &(codewords[chr++]), moduleOnColor);
+               !visited[row*mappingCols+col])
+            PatternShapeStandard(&(map[8 * chr++]), visited, mappingRows, mappingCols, row, col);
          row -= 2;
          col += 2;
       } while ((row >= 0) && (col < mappingCols));
@@ -105,8 +234,8 @@ ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, int size
       /* Sweep downward diagonally, inserting successive characters */
       do {
          if((row >= 0) && (col < mappingCols) &&
-               !(modules[row*mappingCols+col] & DmtxModuleVisited))
-            PatternShapeStandard(modules, mappingRows, mappingCols, row, col, &(codewords[chr++]), moduleOnColor);
+               !visited[row*mappingCols+col])
+            PatternShapeStandard(&(map[8 * chr++]), visited, mappingRows, mappingCols, row, col);
          row += 2;
          col -= 2;
       } while ((row < mappingRows) && (col >= 0));
@@ -115,145 +244,134 @@ ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, int size
       /* ... until the entire modules array is scanned */
    } while ((row < mappingRows) || (col < mappingCols));
 
-   /* If lower righthand corner is untouched then fill in the fixed pattern */
-   if(!(modules[mappingRows * mappingCols - 1] &
-         DmtxModuleVisited)) {
+   assert(chr == layout->symbolDataWords + layout->symbolErrorWords);
 
-      modules[mappingRows * mappingCols - 1] |= moduleOnColor;
-      modules[(mappingRows * mappingCols) - mappingCols - 2] |= moduleOnColor;
-   } /* XXX should this fixed pattern also be used in reading somehow? */
-
-   /* XXX compare that chr == region->dataSize here */
-   return chr; /* XXX number of codewords read off */
+   return DmtxPass;
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
  * \param  row
  * \param  col
- * \param  codeword
- * \param  moduleOnColor
  * \return void
  */
 static void
-PatternShapeStandard(unsigned char *modules, int mappingRows, int mappingCols, int row, int col, unsigned char *codeword, int moduleOnColor)
+PatternShapeStandard(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols, int row, int col)
 {
-   PlaceModule(modules, mappingRows, mappingCols, row-2, col-2, codeword, DmtxMaskBit1, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row-2, col-1, codeword, DmtxMaskBit2, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row-1, col-2, codeword, DmtxMaskBit3, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row-1, col-1, codeword, DmtxMaskBit4, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row-1, col,   codeword, DmtxMaskBit5, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row,   col-2, codeword, DmtxMaskBit6, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row,   col-1, codeword, DmtxMaskBit7, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, row,   col,   codeword, DmtxMaskBit8, moduleOnColor);
+   MapModule(map, visited, mappingRows, mappingCols, row-2, col-2, DmtxMaskBit1);
+   MapModule(map, visited, mappingRows, mappingCols, row-2, col-1, DmtxMaskBit2);
+   MapModule(map, visited, mappingRows, mappingCols, row-1, col-2, DmtxMaskBit3);
+   MapModule(map, visited, mappingRows, mappingCols, row-1, col-1, DmtxMaskBit4);
+   MapModule(map, visited, mappingRows, mappingCols, row-1, col, DmtxMaskBit5);
+   MapModule(map, visited, mappingRows, mappingCols, row, col-2, DmtxMaskBit6);
+   MapModule(map, visited, mappingRows, mappingCols, row, col-1, DmtxMaskBit7);
+   MapModule(map, visited, mappingRows, mappingCols, row, col, DmtxMaskBit8);
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
- * \param  codeword
- * \param  moduleOnColor
  * \return void
  */
 static void
-PatternShapeSpecial1(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor)
+PatternShapeSpecial1(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols)
 {
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 0, codeword, DmtxMaskBit1, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 1, codeword, DmtxMaskBit2, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 2, codeword, DmtxMaskBit3, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-2, codeword, DmtxMaskBit4, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-1, codeword, DmtxMaskBit5, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-1, codeword, DmtxMaskBit6, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 2, mappingCols-1, codeword, DmtxMaskBit7, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 3, mappingCols-1, codeword, DmtxMaskBit8, moduleOnColor);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 0, DmtxMaskBit1);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 1, DmtxMaskBit2);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 2, DmtxMaskBit3);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-2, DmtxMaskBit4);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-1, DmtxMaskBit5);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-1, DmtxMaskBit6);
+   MapModule(map, visited, mappingRows, mappingCols, 2, mappingCols-1, DmtxMaskBit7);
+   MapModule(map, visited, mappingRows, mappingCols, 3, mappingCols-1, DmtxMaskBit8);
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
- * \param  codeword
- * \param  moduleOnColor
  * \return void
  */
 static void
-PatternShapeSpecial2(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor)
+PatternShapeSpecial2(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols)
 {
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-3, 0, codeword, DmtxMaskBit1, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-2, 0, codeword, DmtxMaskBit2, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 0, codeword, DmtxMaskBit3, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-4, codeword, DmtxMaskBit4, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-3, codeword, DmtxMaskBit5, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-2, codeword, DmtxMaskBit6, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-1, codeword, DmtxMaskBit7, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-1, codeword, DmtxMaskBit8, moduleOnColor);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-3, 0, DmtxMaskBit1);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-2, 0, DmtxMaskBit2);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 0, DmtxMaskBit3);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-4, DmtxMaskBit4);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-3, DmtxMaskBit5);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-2, DmtxMaskBit6);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-1, DmtxMaskBit7);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-1, DmtxMaskBit8);
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
- * \param  codeword
- * \param  moduleOnColor
  * \return void
  */
 static void
-PatternShapeSpecial3(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor)
+PatternShapeSpecial3(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols)
 {
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-3, 0, codeword, DmtxMaskBit1, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-2, 0, codeword, DmtxMaskBit2, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 0, codeword, DmtxMaskBit3, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-2, codeword, DmtxMaskBit4, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-1, codeword, DmtxMaskBit5, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-1, codeword, DmtxMaskBit6, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 2, mappingCols-1, codeword, DmtxMaskBit7, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 3, mappingCols-1, codeword, DmtxMaskBit8, moduleOnColor);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-3, 0, DmtxMaskBit1);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-2, 0, DmtxMaskBit2);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 0, DmtxMaskBit3);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-2, DmtxMaskBit4);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-1, DmtxMaskBit5);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-1, DmtxMaskBit6);
+   MapModule(map, visited, mappingRows, mappingCols, 2, mappingCols-1, DmtxMaskBit7);
+   MapModule(map, visited, mappingRows, mappingCols, 3, mappingCols-1, DmtxMaskBit8);
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
- * \param  codeword
- * \param  moduleOnColor
  * \return void
  */
 static void
-PatternShapeSpecial4(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor)
+PatternShapeSpecial4(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols)
 {
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, 0, codeword, DmtxMaskBit1, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, mappingRows-1, mappingCols-1, codeword, DmtxMaskBit2, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-3, codeword, DmtxMaskBit3, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-2, codeword, DmtxMaskBit4, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 0, mappingCols-1, codeword, DmtxMaskBit5, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-3, codeword, DmtxMaskBit6, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-2, codeword, DmtxMaskBit7, moduleOnColor);
-   PlaceModule(modules, mappingRows, mappingCols, 1, mappingCols-1, codeword, DmtxMaskBit8, moduleOnColor);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, 0, DmtxMaskBit1);
+   MapModule(map, visited, mappingRows, mappingCols, mappingRows-1, mappingCols-1, DmtxMaskBit2);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-3, DmtxMaskBit3);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-2, DmtxMaskBit4);
+   MapModule(map, visited, mappingRows, mappingCols, 0, mappingCols-1, DmtxMaskBit5);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-3, DmtxMaskBit6);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-2, DmtxMaskBit7);
+   MapModule(map, visited, mappingRows, mappingCols, 1, mappingCols-1, DmtxMaskBit8);
 }
 
 /**
  * \brief  XXX
- * \param  modules
+ * \param  map
+ * \param  visited
  * \param  mappingRows
  * \param  mappingCols
  * \param  row
  * \param  col
- * \param  codeword
  * \param  mask
- * \param  moduleOnColor
  * \return void
  */
 static void
-PlaceModule(unsigned char *modules, int mappingRows, int mappingCols, int row, int col, unsigned char *codeword, int mask, int moduleOnColor)
+MapModule(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols, int row, int col, int mask)
 {
+   int bit, moduleIdx;
+
    if(row < 0) {
       row += mappingRows;
       col += 4 - ((mappingRows+4)%8);
@@ -263,20 +381,47 @@ PlaceModule(unsigned char *modules, int mappingRows, int mappingCols, int row, i
       row += 4 - ((mappingCols+4)%8);
    }
 
+   for(bit = 0; (0x01 << bit) != mask; bit++)
+      ;
+
+   moduleIdx = row * mappingCols + col;
+   assert(moduleIdx >= 0 && moduleIdx < DmtxPlacementMapMax);
+
+   map[bit] = (unsigned short)moduleIdx;
+   visited[moduleIdx] = 1;
+}
+
+/**
+ * \brief  XXX
+ * \param  modules
+ * \param  moduleIdx
+ * \param  codeword
+ * \param  unsure Count of doubtful modules in codeword, or NULL
+ * \param  mask
+ * \param  moduleOnColor
+ * \return void
+ */
+static void
+PlaceModule(unsigned char *modules, int moduleIdx, unsigned char *codeword, unsigned char *unsure, int mask, int moduleOnColor)
+{
    /* If module has already been assigned then we are decoding the pattern into codewords */
-   if((modules[row*mappingCols+col] & DmtxModuleAssigned) != 0) {
-      if((modules[row*mappingCols+col] & moduleOnColor) != 0)
+   if((modules[moduleIdx] & DmtxModuleAssigned) != 0) {
+      if((modules[moduleIdx] & moduleOnColor) != 0)
          *codeword |= mask;
       else
          *codeword &= (0xff ^ mask);
+
+      /* Count doubtful modules so the codeword can be treated as an erasure */
+      if(unsure != NULL && (modules[moduleIdx] & DmtxModuleUnsure) != 0)
+         (*unsure)++;
    }
    /* Otherwise we are encoding the codewords into a pattern */
    else {
       if((*codeword & mask) != 0x00)
-         modules[row*mappingCols+col] |= moduleOnColor;
+         modules[moduleIdx] |= moduleOnColor;
 
-      modules[row*mappingCols+col] |= DmtxModuleAssigned;
+      modules[moduleIdx] |= DmtxModuleAssigned;
    }
 
-   modules[row*mappingCols+col] |= DmtxModuleVisited;
+   modules[moduleIdx] |= DmtxModuleVisited;
 }
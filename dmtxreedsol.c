@@ -26,6 +26,7 @@
 
 #define NN                      255
 #define MAX_ERROR_WORD_COUNT     68
+#define ERASURE_CHECK_WORDS       3
 
 /* GF add (a + b) */
 #define GfAdd(a,b) \
@@ -33,11 +34,11 @@
 
 /* GF multiply (a * b) */
 #define GfMult(a,b) \
-   (((a) == 0 || (b) == 0) ? 0 : antilog301[(log301[(a)] + log301[(b)]) % NN])
+   (((a) == 0 || (b) == 0) ? 0 : antilog301[log301[(a)] + log301[(b)]])
 
-/* GF multiply by antilog (a * alpha**b) */
+/* GF multiply by antilog (a * alpha**b), where 0 <= b <= NN */
 #define GfMultAntilog(a,b) \
-   (((a) == 0) ? 0 : antilog301[(log301[(a)] + (b)) % NN])
+   (((a) == 0) ? 0 : antilog301[log301[(a)] + (b)])
 
 /* GF(256) log values using primitive polynomial 301 */
 static DmtxByte log301[] =
@@ -58,8 +59,28 @@ static DmtxByte log301[] =
       58,  69, 148,  18,  15,  16,  68,  17, 121, 149, 129,  19, 155,  59, 249,  70,
      214, 250, 168,  71, 201, 156,  64,  60, 237, 130, 111,  20,  93, 122, 177, 150 };
 
-/* GF(256) antilog values using primitive polynomial 301 */
-static DmtxByte antilog301[] =
+/* Smaller root y of y**2 + y = c in GF(256), or 0 where c has no roots */
+static DmtxByte quadRoot301[] =
+   {   0, 190, 108, 210, 110, 208,   2, 188,   0,   0,   0,   0,   0,   0,   0,   0,
+     106, 212,   6, 184,   4, 186, 104, 214,   0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0, 170,  20, 198, 120, 196, 122, 168,  22,
+       0,   0,   0,   0,   0,   0,   0,   0, 192, 126, 172,  18, 174,  16, 194, 124,
+       0,   0,   0,   0,   0,   0,   0,   0,   8, 182, 100, 218, 102, 216,  10, 180,
+       0,   0,   0,   0,   0,   0,   0,   0,  98, 220,  14, 176,  12, 178,  96, 222,
+     162,  28, 206, 112, 204, 114, 160,  30,   0,   0,   0,   0,   0,   0,   0,   0,
+     200, 118, 164,  26, 166,  24, 202, 116,   0,   0,   0,   0,   0,   0,   0,   0,
+      36, 154,  72, 246,  74, 244,  38, 152,   0,   0,   0,   0,   0,   0,   0,   0,
+      78, 240,  34, 156,  32, 158,  76, 242,   0,   0,   0,   0,   0,   0,   0,   0,
+       0,   0,   0,   0,   0,   0,   0,   0, 142,  48, 226,  92, 224,  94, 140,  50,
+       0,   0,   0,   0,   0,   0,   0,   0, 228,  90, 136,  54, 138,  52, 230,  88,
+       0,   0,   0,   0,   0,   0,   0,   0,  44, 146,  64, 254,  66, 252,  46, 144,
+       0,   0,   0,   0,   0,   0,   0,   0,  70, 248,  42, 148,  40, 150,  68, 250,
+     134,  56, 234,  84, 232,  86, 132,  58,   0,   0,   0,   0,   0,   0,   0,   0,
+     236,  82, 128,  62, 130,  60, 238,  80,   0,   0,   0,   0,   0,   0,   0,   0 };
+
+/* GF(256) antilog values using primitive polynomial 301, repeated twice so
+   that the sum of two logs (each at most NN-1) can be used without modulo */
+static DmtxByte antilog301[2*NN] =
    {   1,   2,   4,   8,  16,  32,  64, 128,  45,  90, 180,  69, 138,  57, 114, 228,
      229, 231, 227, 235, 251, 219, 155,  27,  54, 108, 216, 157,  23,  46,  92, 184,
       93, 186,  89, 178,  73, 146,   9,  18,  36,  72, 144,  13,  26,  52, 104, 208,
@@ -75,7 +96,23 @@ static DmtxByte antilog301[] =
      177,  79, 158,  17,  34,  68, 136,  61, 122, 244, 197, 167,  99, 198, 161, 111,
      222, 145,  15,  30,  60, 120, 240, 205, 183,  67, 134,  33,  66, 132,  37,  74,
      148,   5,  10,  20,  40,  80, 160, 109, 218, 153,  31,  62, 124, 248, 221, 151,
-       3,   6,  12,  24,  48,  96, 192, 173, 119, 238, 241, 207, 179,  75, 150,   0 };
+       3,   6,  12,  24,  48,  96, 192, 173, 119, 238, 241, 207, 179,  75, 150,   1,
+       2,   4,   8,  16,  32,  64, 128,  45,  90, 180,  69, 138,  57, 114, 228, 229,
+     231, 227, 235, 251, 219, 155,  27,  54, 108, 216, 157,  23,  46,  92, 184,  93,
+     186,  89, 178,  73, 146,   9,  18,  36,  72, 144,  13,  26,  52, 104, 208, 141,
+      55, 110, 220, 149,   7,  14,  28,  56, 112, 224, 237, 247, 195, 171, 123, 246,
+     193, 175, 115, 230, 225, 239, 243, 203, 187,  91, 182,  65, 130,  41,  82, 164,
+     101, 202, 185,  95, 190,  81, 162, 105, 210, 137,  63, 126, 252, 213, 135,  35,
+      70, 140,  53, 106, 212, 133,  39,  78, 156,  21,  42,  84, 168, 125, 250, 217,
+     159,  19,  38,  76, 152,  29,  58, 116, 232, 253, 215, 131,  43,  86, 172, 117,
+     234, 249, 223, 147,  11,  22,  44,  88, 176,  77, 154,  25,  50, 100, 200, 189,
+      87, 174, 113, 226, 233, 255, 211, 139,  59, 118, 236, 245, 199, 163, 107, 214,
+     129,  47,  94, 188,  85, 170, 121, 242, 201, 191,  83, 166,  97, 194, 169, 127,
+     254, 209, 143,  51, 102, 204, 181,  71, 142,  49,  98, 196, 165, 103, 206, 177,
+      79, 158,  17,  34,  68, 136,  61, 122, 244, 197, 167,  99, 198, 161, 111, 222,
+     145,  15,  30,  60, 120, 240, 205, 183,  67, 134,  33,  66, 132,  37,  74, 148,
+       5,  10,  20,  40,  80, 160, 109, 218, 153,  31,  62, 124, 248, 221, 151,   3,
+       6,  12,  24,  48,  96, 192, 173, 119, 238, 241, 207, 179,  75, 150 };
 
 /**
  * Encode xyz.
@@ -91,22 +128,26 @@ RsEncode(DmtxMessage *message, int sizeIdx)
 {
    int i, j;
    int blockStride, blockIdx;
-   int blockErrorWords, symbolDataWords, symbolErrorWords, symbolTotalWords;
+   int blockErrorWords, symbolDataWords, symbolTotalWords;
+   int valLog;
+   const unsigned char *genLog;
+   const DmtxSymbolLayout *layout;
    DmtxPassFail passFail;
    DmtxByte val, *eccPtr;
-   DmtxByte genStorage[MAX_ERROR_WORD_COUNT];
    DmtxByte eccStorage[MAX_ERROR_WORD_COUNT];
-   DmtxByteList gen = dmtxByteListBuild(genStorage, sizeof(genStorage));
    DmtxByteList ecc = dmtxByteListBuild(eccStorage, sizeof(eccStorage));
 
-   blockStride = dmtxGetSymbolAttribute(DmtxSymAttribInterleavedBlocks, sizeIdx);
-   blockErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribBlockErrorWords, sizeIdx);
-   symbolDataWords = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx);
-   symbolErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribSymbolErrorWords, sizeIdx);
-   symbolTotalWords = symbolDataWords + symbolErrorWords;
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
+      return DmtxFail;
 
-   /* Populate generator polynomial */
-   RsGenPoly(&gen, blockErrorWords);
+   blockStride = layout->blockStride;
+   blockErrorWords = layout->blockErrorWords;
+   symbolDataWords = layout->symbolDataWords;
+   symbolTotalWords = symbolDataWords + layout->symbolErrorWords;
+
+   /* Generator polynomial is kept in log form (it has no zero terms) */
+   genLog = layout->genLog;
 
    /* For each interleaved block... */
    for(blockIdx = 0; blockIdx < blockStride; blockIdx++)
@@ -117,13 +158,23 @@ RsEncode(DmtxMessage *message, int sizeIdx)
       {
          val = GfAdd(ecc.b[blockErrorWords-1], message->code[i]);
 
+         if(val == 0)
+         {
+            /* Multiplying by zero leaves a plain shift */
+            for(j = blockErrorWords - 1; j > 0; j--)
+               ecc.b[j] = ecc.b[j-1];
+            ecc.b[0] = 0;
+            continue;
+         }
+
+         valLog = log301[val];
          for(j = blockErrorWords - 1; j > 0; j--)
          {
-            DMTX_CHECK_BOUNDS(&ecc, j); DMTX_CHECK_BOUNDS(&ecc, j-1); DMTX_CHECK_BOUNDS(&gen, j);
-            ecc.b[j] = GfAdd(ecc.b[j-1], GfMult(gen.b[j], val));
+            DMTX_CHECK_BOUNDS(&ecc, j); DMTX_CHECK_BOUNDS(&ecc, j-1);
+            ecc.b[j] = GfAdd(ecc.b[j-1], antilog301[genLog[j] + valLog]);
          }
 
-         ecc.b[0] = GfMult(gen.b[0], val);
+         ecc.b[0] = antilog301[genLog[0] + valLog];
       }
 
       /* Copy to output message */
@@ -139,8 +190,10 @@ RsEncode(DmtxMessage *message, int sizeIdx)
 
 /**
  * Decode xyz.
- * More detailed description.
+ * Blocks that cannot be repaired from errors alone are tried again treating
+ * the codewords with the most unsure modules as erasures.
  * \param code
+ * \param unsure Per-codeword count of unsure modules, or NULL
  * \param sizeIdx
  * \param fix
  * \return Function success (DmtxPass|DmtxFail)
@@ -148,17 +201,18 @@ RsEncode(DmtxMessage *message, int sizeIdx)
 #undef CHKPASS
 #define CHKPASS { if(passFail == DmtxFail) return DmtxFail; }
 static DmtxPassFail
-RsDecode(unsigned char *code, int sizeIdx, int fix)
+RsDecode(unsigned char *code, const unsigned char *unsure, int sizeIdx, int fix)
 {
    int i;
    int blockStride, blockIdx;
-   int blockDataWords, blockErrorWords, blockMaxCorrectable;
-//   int blockDataWords, blockErrorWords, blockTotalWords, blockMaxCorrectable;
-   int symbolDataWords, symbolErrorWords, symbolTotalWords;
+   int blockDataWords, blockErrorWords, blockTotalWords, blockMaxCorrectable;
+   int symbolDataWords, symbolTotalWords;
+   const DmtxSymbolLayout *layout;
    DmtxBoolean error, repairable;
    DmtxPassFail passFail;
    unsigned char *word;
-   DmtxByte elpStorage[MAX_ERROR_WORD_COUNT];
+   DmtxByte recUnsure[NN];
+   DmtxByte elpStorage[MAX_ERROR_WORD_COUNT+1];
    DmtxByte synStorage[MAX_ERROR_WORD_COUNT+1];
    DmtxByte recStorage[NN];
    DmtxByte locStorage[NN];
@@ -167,19 +221,22 @@ RsDecode(unsigned char *code, int sizeIdx, int fix)
    DmtxByteList rec = dmtxByteListBuild(recStorage, sizeof(recStorage));
    DmtxByteList loc = dmtxByteListBuild(locStorage, sizeof(locStorage));
 
-   blockStride = dmtxGetSymbolAttribute(DmtxSymAttribInterleavedBlocks, sizeIdx);
-   blockErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribBlockErrorWords, sizeIdx);
-   blockMaxCorrectable = dmtxGetSymbolAttribute(DmtxSymAttribBlockMaxCorrectable, sizeIdx);
-   symbolDataWords = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx);
-   symbolErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribSymbolErrorWords, sizeIdx);
-   symbolTotalWords = symbolDataWords + symbolErrorWords;
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
+      return DmtxFail;
+
+   blockStride = layout->blockStride;
+   blockErrorWords = layout->blockErrorWords;
+   blockMaxCorrectable = layout->blockMaxCorrectable;
+   symbolDataWords = layout->symbolDataWords;
+   symbolTotalWords = symbolDataWords + layout->symbolErrorWords;
 
    /* For each interleaved block */
    for(blockIdx = 0; blockIdx < blockStride; blockIdx++)
    {
       /* Data word count depends on blockIdx due to special case at 144x144 */
-      blockDataWords = dmtxGetBlockDataSize(sizeIdx, blockIdx);
-//      blockTotalWords = blockErrorWords + blockDataWords;
+      blockDataWords = GetBlockDataWords(layout, blockIdx);
+      blockTotalWords = blockErrorWords + blockDataWords;
 
       /* Populate received list (rec) with data and error codewords */
       dmtxByteListInit(&rec, 0, 0, &passFail); CHKPASS;
@@ -188,6 +245,7 @@ RsDecode(unsigned char *code, int sizeIdx, int fix)
       word = code + symbolTotalWords + blockIdx - blockStride;
       for(i = 0; i < blockErrorWords; i++)
       {
+         recUnsure[rec.length] = (unsure == NULL) ? 0 : unsure[word - code];
          dmtxByteListPush(&rec, *word, &passFail); CHKPASS;
          word -= blockStride;
       }
@@ -196,6 +254,7 @@ RsDecode(unsigned char *code, int sizeIdx, int fix)
       word = code + blockIdx + (blockStride * (blockDataWords - 1));
       for(i = 0; i < blockDataWords; i++)
       {
+         recUnsure[rec.length] = (unsure == NULL) ? 0 : unsure[word - code];
          dmtxByteListPush(&rec, *word, &passFail); CHKPASS;
          word -= blockStride;
       }
@@ -208,11 +267,16 @@ RsDecode(unsigned char *code, int sizeIdx, int fix)
       {
          /* Find error locator polynomial (elp) */
          repairable = RsFindErrorLocatorPoly(&elp, &syn, blockErrorWords, blockMaxCorrectable);
-         if(!repairable)
-            return DmtxFail;
 
          /* Find error positions (loc) */
-         repairable = RsFindErrorLocations(&loc, &elp);
+         if(repairable)
+            repairable = RsFindErrorLocations(&loc, &elp, blockTotalWords);
+
+         /* Otherwise let doubtful codewords stand in as known error positions */
+         if(!repairable)
+            repairable = RsFindErrataLocations(&loc, &elp, &syn, recUnsure,
+                  blockTotalWords, blockErrorWords, blockMaxCorrectable);
+
          if(!repairable)
             return DmtxFail;
 
@@ -244,44 +308,18 @@ RsDecode(unsigned char *code, int sizeIdx, int fix)
    return DmtxPass;
 }
 
-/**
- * Populate generator polynomial.
- * More detailed description.
- * \param gen
- * \param errorWordCount
- * \return Function success (DmtxPass|DmtxFail)
- */
-#undef CHKPASS
-#define CHKPASS { if(passFail == DmtxFail) return DmtxFail; }
-static DmtxPassFail
-RsGenPoly(DmtxByteList *gen, int errorWordCount)
-{
-   int i, j;
-   DmtxPassFail passFail;
-
-   /* Initialize all coefficients to 1 */
-   dmtxByteListInit(gen, errorWordCount, 1, &passFail); CHKPASS;
-
-   /* Generate polynomial */
-   for(i = 0; i < gen->length; i++)
-   {
-      for(j = i; j >= 0; j--)
-      {
-         gen->b[j] = GfMultAntilog(gen->b[j], i+1);
-         if(j > 0)
-            gen->b[j] = GfAdd(gen->b[j], gen->b[j-1]);
-      }
-   }
-
-   return DmtxPass;
-}
-
 /**
  * Populate generator polynomial.
  * Assume we have received bits grouped into mm-bit symbols in rec[i],
  * i=0..(nn-1),  and rec[i] is index form (ie as powers of alpha). We first
  * compute the 2*tt syndromes by substituting alpha**i into rec(X) and
  * evaluating, storing the syndromes in syn[i], i=1..2tt (leave syn[0] zero).
+ * Zero codewords are dropped up front and each remaining term keeps its
+ * exponent log(rec[j]) + i*j, which steps by j from one syndrome to the next
+ * and stays below NN by a single subtraction. The terms are independent so
+ * their table lookups overlap. Vectorized GF multiply (e.g. split-nibble
+ * PSHUFB tables) needs the same multiplier in every lane, but each term here
+ * has its own alpha**j and a block is at most 255 bytes, so it stays scalar.
  * \param syn
  * \param rec
  * \param blockErrorWords
@@ -293,21 +331,43 @@ RsGenPoly(DmtxByteList *gen, int errorWordCount)
 static DmtxBoolean
 RsComputeSyndromes(DmtxByteList *syn, const DmtxByteList *rec, int blockErrorWords)
 {
-   int i, j;
+   int i, j, t, termCount;
+   int termStep[NN], termExp[NN];
    DmtxPassFail passFail;
    DmtxBoolean error = DmtxFalse;
+   DmtxByte s;
 
    /* Initialize all coefficients to 0 */
    dmtxByteListInit(syn, blockErrorWords + 1, 0, &passFail); CHKPASS;
 
+   assert(rec->length <= NN);
+
+   /* Keep nonzero terms in log form (exponent for syndrome 0) */
+   for(termCount = 0, j = 0; j < rec->length; j++) /* alternatively: j < blockTotalWords */
+   {
+      if(rec->b[j] != 0)
+      {
+         termStep[termCount] = j;
+         termExp[termCount] = log301[rec->b[j]];
+         termCount++;
+      }
+   }
+
    for(i = 1; i < syn->length; i++)
    {
       /* Calculate syndrome at i */
-      for(j = 0; j < rec->length; j++) /* alternatively: j < blockTotalWords */
-         syn->b[i] = GfAdd(syn->b[i], GfMultAntilog(rec->b[j], i*j));
+      for(s = 0, t = 0; t < termCount; t++)
+      {
+         termExp[t] += termStep[t];
+         s = GfAdd(s, antilog301[termExp[t]]);
+         if(termExp[t] >= NN)
+            termExp[t] -= NN;
+      }
+
+      syn->b[i] = s;
 
       /* Non-zero syndrome indicates presence of error(s) */
-      if(syn->b[i] != 0)
+      if(s != 0)
          error = DmtxTrue;
    }
 
@@ -396,31 +456,214 @@ RsFindErrorLocatorPoly(DmtxByteList *elpOut, const DmtxByteList *syn, int errorW
    return (lambda <= maxCorrectable) ? DmtxTrue : DmtxFalse;
 }
 
+/**
+ * Find the errata locator polynomial using Berlekamp-Massey seeded with the
+ * erasure locator. Each erasure uses up one error word and each unknown error
+ * two. Erasures give no check of their own, so ERASURE_CHECK_WORDS error words
+ * are always left over to catch miscorrection, and the total also stays
+ * within the 2*maxCorrectable that decoding errors alone may use.
+ * \param elpOut
+ * \param syn
+ * \param era Erasure positions
+ * \param errorWordCount
+ * \param maxCorrectable
+ * \return Is block repairable? (DmtxTrue|DmtxFalse)
+ */
+#undef CHKPASS
+#define CHKPASS { if(passFail == DmtxFail) return DmtxFalse; }
+static DmtxBoolean
+RsFindErrataLocatorPoly(DmtxByteList *elpOut, const DmtxByteList *syn, const DmtxByteList *era, int errorWordCount, int maxCorrectable)
+{
+   int i, j, r;
+   int lambda, degree, budget;
+   DmtxPassFail passFail;
+   DmtxByte dis, prevStorage[MAX_ERROR_WORD_COUNT+1], nextStorage[MAX_ERROR_WORD_COUNT+1];
+   DmtxByteList prev = dmtxByteListBuild(prevStorage, sizeof(prevStorage));
+   DmtxByteList next = dmtxByteListBuild(nextStorage, sizeof(nextStorage));
+
+   budget = min(2 * maxCorrectable, errorWordCount - ERASURE_CHECK_WORDS);
+   if(era->length > budget)
+      return DmtxFalse;
+
+   /* Erasure locator is the product of (1 + X*x) over erasure positions X */
+   dmtxByteListInit(elpOut, errorWordCount + 1, 0, &passFail); CHKPASS;
+   elpOut->b[0] = 1;
+   for(i = 0; i < era->length; i++)
+   {
+      for(j = i + 1; j > 0; j--)
+         elpOut->b[j] = GfAdd(elpOut->b[j], GfMultAntilog(elpOut->b[j-1], era->b[i]));
+   }
+
+   dmtxByteListCopy(&prev, elpOut, &passFail); CHKPASS;
+   dmtxByteListInit(&next, errorWordCount + 1, 0, &passFail); CHKPASS;
+   lambda = era->length;
+
+   for(r = era->length + 1; r <= errorWordCount; r++)
+   {
+      /* Calculate discrepancy at step r */
+      for(dis = 0, j = 0; j < r; j++)
+         dis = GfAdd(dis, GfMult(elpOut->b[j], syn->b[r-j]));
+
+      if(dis != 0)
+      {
+         /* next = elp - dis * x * prev */
+         next.b[0] = elpOut->b[0];
+         for(j = 0; j < errorWordCount; j++)
+            next.b[j+1] = GfAdd(elpOut->b[j+1], GfMult(dis, prev.b[j]));
+
+         if(2 * lambda <= r + era->length - 1)
+         {
+            /* Length change: prev becomes elp / dis */
+            lambda = r + era->length - lambda;
+            for(j = 0; j <= errorWordCount; j++)
+               prev.b[j] = GfMultAntilog(elpOut->b[j], NN - log301[dis]);
+         }
+         else
+         {
+            for(j = errorWordCount; j > 0; j--)
+               prev.b[j] = prev.b[j-1];
+            prev.b[0] = 0;
+         }
+
+         dmtxByteListCopy(elpOut, &next, &passFail); CHKPASS;
+      }
+      else
+      {
+         for(j = errorWordCount; j > 0; j--)
+            prev.b[j] = prev.b[j-1];
+         prev.b[0] = 0;
+      }
+   }
+
+   /* Trim to true degree */
+   for(degree = errorWordCount; degree > 0 && elpOut->b[degree] == 0; degree--)
+      ;
+   elpOut->length = degree + 1;
+
+   if(degree < era->length || degree != lambda)
+      return DmtxFalse;
+
+   return (2 * degree - era->length <= budget) ? DmtxTrue : DmtxFalse;
+}
+
+/**
+ * Locate errors with help from erasures.
+ * Codewords are taken as erasures in order of how many of their modules were
+ * unsure, first as many as allowed and then half as many to leave room for
+ * errors elsewhere.
+ * \param loc
+ * \param elp
+ * \param syn
+ * \param recUnsure Count of unsure modules for each received word
+ * \param blockTotalWords
+ * \param blockErrorWords
+ * \param blockMaxCorrectable
+ * \return Is block repairable? (DmtxTrue|DmtxFalse)
+ */
+#undef CHKPASS
+#define CHKPASS { if(passFail == DmtxFail) return DmtxFalse; }
+static DmtxBoolean
+RsFindErrataLocations(DmtxByteList *loc, DmtxByteList *elp, const DmtxByteList *syn,
+      const DmtxByte *recUnsure, int blockTotalWords, int blockErrorWords, int blockMaxCorrectable)
+{
+   int i, count, eraMax, eraTotal, eraLimit;
+   DmtxPassFail passFail;
+   DmtxByte eraStorage[MAX_ERROR_WORD_COUNT];
+   DmtxByteList era = dmtxByteListBuild(eraStorage, sizeof(eraStorage));
+
+   /* Rank candidates by unsure module count (at most 8 per codeword) */
+   dmtxByteListInit(&era, 0, 0, &passFail); CHKPASS;
+   eraLimit = min(2 * blockMaxCorrectable, blockErrorWords - ERASURE_CHECK_WORDS);
+   for(count = 8; count > 0 && era.length < eraLimit; count--)
+   {
+      for(i = 0; i < blockTotalWords && era.length < eraLimit; i++)
+      {
+         if(recUnsure[i] == count)
+         {
+            dmtxByteListPush(&era, i, &passFail); CHKPASS;
+         }
+      }
+   }
+
+   /* Shortening the list drops the least doubtful candidates */
+   for(eraTotal = era.length, eraMax = eraTotal; eraMax > 0;
+         eraMax = (eraMax == eraTotal) ? eraMax / 2 : 0)
+   {
+      era.length = eraMax;
+
+      if(RsFindErrataLocatorPoly(elp, syn, &era, blockErrorWords, blockMaxCorrectable) &&
+            RsFindErrorLocations(loc, elp, blockTotalWords))
+         return DmtxTrue;
+   }
+
+   return DmtxFalse;
+}
+
 /**
  * Find roots of the error locator polynomial (Chien Search).
- * If the degree of elp is <= tt, we substitute alpha**i, i=1..n into the elp
- * to get the roots, hence the inverse roots, the error location numbers.
- * If the number of errors located does not equal the degree of the elp, we
- * have more than tt errors and cannot correct them.
+ * If the degree of elp is <= tt, we substitute alpha**i into the elp to get
+ * the roots, hence the inverse roots, the error location numbers. Only the
+ * alpha**i matching the blockTotalWords positions in the block are tried, and
+ * the search stops once all roots are found. One or two roots are solved for
+ * directly instead. If the number of errors located does not equal the degree
+ * of the elp, we have more than tt errors and cannot correct them.
  * \param loc
  * \param elp
+ * \param blockTotalWords
  * \return Is block repairable? (DmtxTrue|DmtxFalse)
  */
 #undef CHKPASS
 #define CHKPASS { if(passFail == DmtxFail) return DmtxFalse; }
 static DmtxBoolean
-RsFindErrorLocations(DmtxByteList *loc, const DmtxByteList *elp)
+RsFindErrorLocations(DmtxByteList *loc, const DmtxByteList *elp, int blockTotalWords)
 {
-   int i, j;
+   int i, j, iBeg;
    int lambda = elp->length - 1;
    DmtxPassFail passFail;
-   DmtxByte q, regStorage[MAX_ERROR_WORD_COUNT];
+   DmtxByte q, x0, x1, regStorage[MAX_ERROR_WORD_COUNT+1];
    DmtxByteList reg = dmtxByteListBuild(regStorage, sizeof(regStorage));
 
-   dmtxByteListCopy(&reg, elp, &passFail); CHKPASS;
    dmtxByteListInit(loc, 0, 0, &passFail); CHKPASS;
 
-   for(i = 1; i <= NN; i++)
+   if(lambda == 1)
+   {
+      /* 1 + e1*x has its inverse root at e1 */
+      if(elp->b[1] == 0 || log301[elp->b[1]] >= blockTotalWords)
+         return DmtxFalse;
+
+      dmtxByteListPush(loc, log301[elp->b[1]], &passFail); CHKPASS;
+      return DmtxTrue;
+   }
+   else if(lambda == 2)
+   {
+      /* Inverse roots solve X**2 + e1*X + e2 = 0, or with X = e1*y, solve
+         y**2 + y = e2/e1**2 where the roots are y and y + 1 */
+      if(elp->b[1] == 0 || elp->b[2] == 0)
+         return DmtxFalse;
+
+      q = antilog301[log301[elp->b[2]] + NN - ((2 * log301[elp->b[1]]) % NN)];
+      if(quadRoot301[q] == 0)
+         return DmtxFalse;
+
+      x0 = GfMult(elp->b[1], quadRoot301[q]);
+      x1 = GfAdd(x0, elp->b[1]);
+      if(log301[x0] >= blockTotalWords || log301[x1] >= blockTotalWords)
+         return DmtxFalse;
+
+      /* Report in the same (descending) order as the search below */
+      dmtxByteListPush(loc, max(log301[x0], log301[x1]), &passFail); CHKPASS;
+      dmtxByteListPush(loc, min(log301[x0], log301[x1]), &passFail); CHKPASS;
+      return DmtxTrue;
+   }
+
+   /* Location NN-i is tested at alpha**i, so skip ahead to the first valid one */
+   iBeg = NN - blockTotalWords + 1;
+
+   dmtxByteListCopy(&reg, elp, &passFail); CHKPASS;
+   for(j = 1; j <= lambda; j++)
+      reg.b[j] = GfMultAntilog(reg.b[j], (j * (iBeg - 1)) % NN);
+
+   for(i = iBeg; i <= NN && loc->length < lambda; i++)
    {
       for(q = 1, j = 1; j <= lambda; j++)
       {
@@ -478,7 +721,7 @@ RsRepairErrors(DmtxByteList *rec, const DmtxByteList *loc, const DmtxByteList *e
       root = NN - loc->b[i];
 
       for(err = 1, j = 1; j <= lambda; j++)
-         err = GfAdd(err, GfMultAntilog(z.b[j], j * root));
+         err = GfAdd(err, GfMultAntilog(z.b[j], (j * root) % NN));
 
       if(err == 0)
          continue;
@@ -15,8 +15,6 @@
  * \brief Detect barcode regions
  */
 
-#define DMTX_HOUGH_RES 180
-
 /**
  * \brief  Create copy of existing region struct
  * \param  None
@@ -59,31 +57,114 @@ dmtxRegionDestroy(DmtxRegion **reg)
  * \param  dec Pointer to DmtxDecode information struct
  * \param  timeout Pointer to timeout time (NULL if none)
  * \return Detected region (if found)
+ *
+ * With DmtxPropThreadCount other than 1 the whole image is searched in
+ * tiles on the first call, see dmtxregiontile.c.
  */
 extern DmtxRegion *
 dmtxRegionFindNext(DmtxDecode *dec, DmtxTime *timeout)
 {
-   int locStatus;
+   return dmtxRegionFindNextNsec(dec, (timeout == NULL) ? DmtxUndefined : TimeToNsec(*timeout));
+}
+
+/**
+ * \brief  Find next barcode region before a nanosecond deadline
+ * \param  dec Pointer to DmtxDecode information struct
+ * \param  deadline Deadline from dmtxTimeNowNsec(), or DmtxUndefined if none
+ * \return Detected region (if found)
+ */
+extern DmtxRegion *
+dmtxRegionFindNextNsec(DmtxDecode *dec, long long deadline)
+{
+   return dmtxRegionFindNextStatus(dec, deadline, DmtxUndefined, NULL);
+}
+
+/**
+ * \brief  Find next barcode region, reporting why none was found
+ * \param  dec Pointer to DmtxDecode information struct
+ * \param  deadline Deadline from dmtxTimeNowNsec(), or DmtxUndefined if none
+ * \param  budget Grid locations (pixels) this call may test, or DmtxUndefined
+ * \param  status Receives DmtxScanFound, DmtxScanExhausted, DmtxScanTimedOut
+ *         or DmtxScanBudgetSpent (may be NULL)
+ * \return Detected region (if found)
+ *
+ * The scan grid stays in the decoder, so after DmtxScanTimedOut or
+ * DmtxScanBudgetSpent the next call continues from the following location.
+ * A tiled search (DmtxPropThreadCount other than 1) spends the budget a
+ * whole tile at a time.
+ */
+extern DmtxRegion *
+dmtxRegionFindNextStatus(DmtxDecode *dec, long long deadline, long budget,
+      DmtxScanStatus *status)
+{
+   long scanned;
+   DmtxScanStatus scanStatus;
+
+   if(status == NULL)
+      status = &scanStatus;
+
+   if(dec->threadCount != 1)
+      return TileRegionFindNext(dec, deadline, budget, status);
+
+   return GridRegionFindNext(dec, deadline, budget, &scanned, status);
+}
+
+/**
+ * \brief  Test scan grid locations until a region is found or a limit is hit
+ * \param  dec Pointer to DmtxDecode information struct
+ * \param  deadline Deadline from dmtxTimeNowNsec(), or DmtxUndefined if none
+ * \param  budget Grid locations to test at most, or DmtxUndefined
+ * \param  scanned Receives the number of locations tested
+ * \param  status Receives the reason for returning
+ * \return Detected region (if found)
+ *
+ * Reading the clock costs about as much as rejecting a location, so it is
+ * read after each location that got as far as fitting a region, and
+ * otherwise only once every DmtxDeadlineCheckInterval locations.
+ */
+static DmtxRegion *
+GridRegionFindNext(DmtxDecode *dec, long long deadline, long budget, long *scanned,
+      DmtxScanStatus *status)
+{
+   int locStatus, countdown;
+   DmtxBoolean fitted;
    DmtxPixelLoc loc;
    DmtxRegion   *reg;
 
+   *scanned = 0;
+   countdown = DmtxDeadlineCheckInterval;
+
    /* Continue until we find a region or run out of chances */
    for(;;) {
+      if(budget != DmtxUndefined && *scanned >= budget) {
+         *status = DmtxScanBudgetSpent;
+         return NULL;
+      }
+
       locStatus = PopGridLocation(&(dec->grid), &loc);
-      if(locStatus == DmtxRangeEnd)
-         break;
+      if(locStatus == DmtxRangeEnd) {
+         *status = DmtxScanExhausted;
+         return NULL;
+      }
 
       /* Scan location for presence of valid barcode region */
-      reg = dmtxRegionScanPixel(dec, loc.X, loc.Y);
-      if(reg != NULL)
+      (*scanned)++;
+      reg = (dec->windowEdges != 0) ? TileScanPixel(dec, loc, &fitted) :
+            RegionScanPixel(dec, loc, &fitted);
+      if(reg != NULL) {
+         *status = DmtxScanFound;
          return reg;
+      }
 
       /* Ran out of time? */
-      if(timeout != NULL && dmtxTimeExceeded(*timeout))
-         break;
+      if(deadline != DmtxUndefined && (fitted == DmtxTrue || --countdown == 0)) {
+         if(DeadlineExceeded(deadline) == DmtxTrue) {
+            *status = DmtxScanTimedOut;
+            return NULL;
+         }
+         countdown = DmtxDeadlineCheckInterval;
+      }
    }
-
-   return NULL;
 }
 
 /**
@@ -95,14 +176,31 @@ dmtxRegionFindNext(DmtxDecode *dec, DmtxTime *timeout)
 extern DmtxRegion *
 dmtxRegionScanPixel(DmtxDecode *dec, int x, int y)
 {
-   unsigned char *cache;
-   DmtxRegion reg;
-   DmtxPointFlow flowBegin;
+   DmtxBoolean fitted;
    DmtxPixelLoc loc;
 
    loc.X = x;
    loc.Y = y;
 
+   return RegionScanPixel(dec, loc, &fitted);
+}
+
+/**
+ * \brief  Scan individual pixel, reporting whether a region fit was attempted
+ * \param  dec Pointer to DmtxDecode information struct
+ * \param  loc Pixel location
+ * \param  fitted Set to DmtxTrue if an edge was strong enough to fit a region
+ * \return Detected region (if any)
+ */
+static DmtxRegion *
+RegionScanPixel(DmtxDecode *dec, DmtxPixelLoc loc, DmtxBoolean *fitted)
+{
+   unsigned char *cache;
+   DmtxRegion reg;
+   DmtxPointFlow flowBegin;
+
+   *fitted = DmtxFalse;
+
    cache = dmtxDecodeGetCache(dec, loc.X, loc.Y);
    if(cache == NULL)
       return NULL;
@@ -115,6 +213,8 @@ dmtxRegionScanPixel(DmtxDecode *dec, int x, int y)
    if(flowBegin.mag < (int)(dec->edgeThresh * 7.65 + 0.5))
       return NULL;
 
+   *fitted = DmtxTrue;
+
    memset(&reg, 0x00, sizeof(DmtxRegion));
 
    /* Determine barcode orientation */
@@ -235,6 +335,13 @@ MatrixRegionOrientation(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow begin)
       return DmtxFail;
    }
 
+   /* A tile cannot fit an edge that runs out of its window, see TileScanPixel() */
+   if((dec->windowEdgesHit & dec->windowEdges) != 0) {
+      AppendTileOpenTrail(dec->windowResult, reg);
+      TrailClear(dec, reg, 0x40);
+      return DmtxFail;
+   }
+
    /* Filter out region candidates that are smaller than expected */
    if(dec->edgeMin != DmtxUndefined) {
       scale = dmtxDecodeGetProp(dec, DmtxPropScale);
@@ -581,44 +688,84 @@ RightAngleTrueness(DmtxVector2 c0, DmtxVector2 c1, DmtxVector2 c2, double angle)
 }
 
 /**
- * \brief  Read color of Data Matrix module location
+ * \brief  Read colors of a rectangular block of Data Matrix modules
  * \param  dec
  * \param  reg
- * \param  symbolRow
- * \param  symbolCol
+ * \param  symbolRow Bottom row of block
+ * \param  symbolCol Left column of block
+ * \param  rows
+ * \param  cols
  * \param  sizeIdx
- * \return Averaged module color
+ * \param  colorPlane
+ * \param  colors Output holding rows * cols values, bottom row first
+ * \return void
+ *
+ * Each module color is the average of 5 samples around the module center.
+ * Products of fit2raw that depend only on the sample column or only on the
+ * sample row are computed once per column and once per row.
  */
-static int
-ReadModuleColor(DmtxDecode *dec, DmtxRegion *reg, int symbolRow, int symbolCol,
-      int sizeIdx, int colorPlane)
+static void
+ReadModuleColorBlock(DmtxDecode *dec, DmtxRegion *reg, int symbolRow, int symbolCol,
+      int rows, int cols, int sizeIdx, int colorPlane, int *colors)
 {
-   int i;
+   int i, j, row, col;
    int symbolRows, symbolCols;
    int color, colorTmp;
-   double sampleX[] = { 0.5, 0.4, 0.5, 0.6, 0.5 };
-   double sampleY[] = { 0.5, 0.5, 0.4, 0.5, 0.6 };
-   DmtxVector2 p;
+   double pX, pY, w;
+   double xTerm[DmtxModuleBlockMax][3][3];
+   double yTerm[3][3];
+   const double sampleOffset[] = { 0.4, 0.5, 0.6 };
+   const int sampleX[] = { 1, 0, 1, 2, 1 };
+   const int sampleY[] = { 1, 1, 0, 1, 2 };
+
+   assert(cols <= DmtxModuleBlockMax);
 
    symbolRows = dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx);
    symbolCols = dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx);
 
-   color = 0;
-   for(i = 0; i < 5; i++) {
+   /* Products of each sample X coordinate with first matrix row */
+   for(col = 0; col < cols; col++) {
+      for(j = 0; j < 3; j++) {
+         pX = (1.0/symbolCols) * (symbolCol + col + sampleOffset[j]);
+         xTerm[col][j][0] = pX * reg->fit2raw[0][0];
+         xTerm[col][j][1] = pX * reg->fit2raw[0][1];
+         xTerm[col][j][2] = pX * reg->fit2raw[0][2];
+      }
+   }
 
-      p.X = (1.0/symbolCols) * (symbolCol + sampleX[i]);
-      p.Y = (1.0/symbolRows) * (symbolRow + sampleY[i]);
+   colorTmp = 0;
+   for(row = 0; row < rows; row++) {
 
-      dmtxMatrix3VMultiplyBy(&p, reg->fit2raw);
+      /* Products of each sample Y coordinate with second matrix row */
+      for(j = 0; j < 3; j++) {
+         pY = (1.0/symbolRows) * (symbolRow + row + sampleOffset[j]);
+         yTerm[j][0] = pY * reg->fit2raw[1][0];
+         yTerm[j][1] = pY * reg->fit2raw[1][1];
+         yTerm[j][2] = pY * reg->fit2raw[1][2];
+      }
 
-      //fprintf(stdout, "%dx%d\n", (int)(p.X + 0.5), (int)(p.Y + 0.5));
+      for(col = 0; col < cols; col++) {
+         color = 0;
+         for(i = 0; i < 5; i++) {
 
-      dmtxDecodeGetPixelValue(dec, (int)(p.X + 0.5), (int)(p.Y + 0.5),
-            colorPlane, &colorTmp);
-      color += colorTmp;
+            /* Same operation order as dmtxMatrix3VMultiply() */
+            w = xTerm[col][sampleX[i]][2] + yTerm[sampleY[i]][2] + reg->fit2raw[2][2];
+            if(fabs(w) <= DmtxAlmostZero) {
+               pX = FLT_MAX;
+               pY = FLT_MAX;
+            }
+            else {
+               pX = (xTerm[col][sampleX[i]][0] + yTerm[sampleY[i]][0] + reg->fit2raw[2][0])/w;
+               pY = (xTerm[col][sampleX[i]][1] + yTerm[sampleY[i]][1] + reg->fit2raw[2][1])/w;
+            }
+
+            dmtxDecodeGetPixelValue(dec, (int)(pX + 0.5), (int)(pY + 0.5),
+                  colorPlane, &colorTmp);
+            color += colorTmp;
+         }
+         colors[row * cols + col] = color/5;
+      }
    }
-   //fprintf(stdout, "\n");
-   return color/5;
 }
 
 /**
@@ -630,21 +777,9 @@ ReadModuleColor(DmtxDecode *dec, DmtxRegion *reg, int symbolRow, int symbolCol,
 static DmtxPassFail
 MatrixRegionFindSize(DmtxDecode *dec, DmtxRegion *reg)
 {
-   int row, col;
    int sizeIdxBeg, sizeIdxEnd;
-   int sizeIdx, bestSizeIdx;
-   int symbolRows, symbolCols;
-   int jumpCount, errors;
-   int color;
-   int colorOnAvg, bestColorOnAvg;
-   int colorOffAvg, bestColorOffAvg;
-   int contrast, bestContrast;
-//   DmtxImage *img;
-
-//   img = dec->image;
-   bestSizeIdx = DmtxUndefined;
-   bestContrast = 0;
-   bestColorOnAvg = bestColorOffAvg = 0;
+   int sizeIdx, sizeIdxCount;
+   int sizeIdxList[DmtxSymbolSquareCount + DmtxSymbolRectCount];
 
    if(dec->sizeIdxExpected == DmtxSymbolShapeAuto) {
       sizeIdxBeg = 0;
@@ -663,31 +798,225 @@ MatrixRegionFindSize(DmtxDecode *dec, DmtxRegion *reg)
       sizeIdxEnd = dec->sizeIdxExpected + 1;
    }
 
-   /* Test each barcode size to find best contrast in calibration modules */
+   /* Only test sizes nearest the estimated module counts when there is an
+      estimate. Most candidate regions are not symbols, so a failed estimate
+      is not retried against every size */
+   sizeIdxCount = MatrixRegionEstimateSizes(dec, reg, sizeIdxBeg, sizeIdxEnd, sizeIdxList);
+   if(sizeIdxCount > 0)
+      return MatrixRegionTestSizes(dec, reg, sizeIdxList, sizeIdxCount);
+
+   /* No estimate possible, so test every size */
+   for(sizeIdx = sizeIdxBeg; sizeIdx < sizeIdxEnd; sizeIdx++)
+      sizeIdxList[sizeIdxCount++] = sizeIdx;
+
+   return MatrixRegionTestSizes(dec, reg, sizeIdxList, sizeIdxCount);
+}
+
+/**
+ * \brief  Count light/dark transitions sampled along a calibration bar
+ * \param  dec
+ * \param  reg
+ * \param  dir DmtxDirRight for horizontal bar, DmtxDirUp for vertical bar
+ * \param  depth Distance of sampled line inside outer edge (fit coordinates)
+ * \return Transition count, or DmtxUndefined if bar shows too little contrast
+ */
+static int
+CountCalibrationJumps(DmtxDecode *dec, DmtxRegion *reg, DmtxDirection dir, double depth)
+{
+   int i, samples;
+   int color, colorMin, colorMax;
+   int threshLo, threshHi;
+   int state, jumpCount;
+   int colors[DmtxSizeEstimateMax];
+   double length;
+   DmtxVector2 p, pBeg, pEnd;
+
+   assert(dir == DmtxDirRight || dir == DmtxDirUp);
+
+   /* Sample roughly twice per pixel along the bar */
+   pBeg.X = (dir == DmtxDirRight) ? 0.0 : 1.0 - depth;
+   pBeg.Y = (dir == DmtxDirRight) ? 1.0 - depth : 0.0;
+   pEnd.X = 1.0 - depth;
+   pEnd.Y = 1.0 - depth;
+   dmtxMatrix3VMultiplyBy(&pBeg, reg->fit2raw);
+   dmtxMatrix3VMultiplyBy(&pEnd, reg->fit2raw);
+   length = dmtxVector2Mag(dmtxVector2Sub(&p, &pEnd, &pBeg));
+
+   samples = min((int)(2.0 * length), DmtxSizeEstimateMax);
+   if(samples < 16)
+      return DmtxUndefined;
+
+   color = 0;
+   colorMin = INT_MAX;
+   colorMax = INT_MIN;
+   for(i = 0; i < samples; i++) {
+      p.X = (dir == DmtxDirRight) ? (i + 0.5)/samples : 1.0 - depth;
+      p.Y = (dir == DmtxDirRight) ? 1.0 - depth : (i + 0.5)/samples;
+      dmtxMatrix3VMultiplyBy(&p, reg->fit2raw);
+      dmtxDecodeGetPixelValue(dec, (int)(p.X + 0.5), (int)(p.Y + 0.5),
+            reg->flowBegin.plane, &color);
+      colors[i] = color;
+      colorMin = min(colorMin, color);
+      colorMax = max(colorMax, color);
+   }
+
+   if(colorMax - colorMin < 20)
+      return DmtxUndefined;
+
+   /* Count crossings of a band around the midpoint to ignore noise */
+   threshLo = colorMin + (colorMax - colorMin) * 2/5;
+   threshHi = colorMin + (colorMax - colorMin) * 3/5;
+
+   state = (colors[0] > threshLo);
+   jumpCount = 0;
+   for(i = 1; i < samples; i++) {
+      if(state && colors[i] < threshLo) {
+         state = 0;
+         jumpCount++;
+      }
+      else if(!state && colors[i] > threshHi) {
+         state = 1;
+         jumpCount++;
+      }
+   }
+
+   return jumpCount;
+}
+
+/**
+ * \brief  List the few sizes whose module counts best match calibration bars
+ * \param  dec
+ * \param  reg
+ * \param  sizeIdxBeg
+ * \param  sizeIdxEnd
+ * \param  sizeIdxList Output, in increasing sizeIdx order
+ * \return Number of sizes listed, or 0 if no useful estimate was found
+ */
+static int
+MatrixRegionEstimateSizes(DmtxDecode *dec, DmtxRegion *reg, int sizeIdxBeg,
+      int sizeIdxEnd, int *sizeIdxList)
+{
+   int i, j;
+   int sizeIdx, sizeIdxCount;
+   int symbolRows, symbolCols;
+   int rowsMax, colsMax;
+   int jumpsHoriz, jumpsVert;
+   int dist, distList[DmtxSizeCandidates];
+   double widthPx, heightPx;
+   DmtxVector2 p01, p11, p10, v;
+
+   if(sizeIdxEnd - sizeIdxBeg <= DmtxSizeCandidates)
+      return 0;
+
+   rowsMax = colsMax = 0;
    for(sizeIdx = sizeIdxBeg; sizeIdx < sizeIdxEnd; sizeIdx++) {
+      rowsMax = max(rowsMax, dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx));
+      colsMax = max(colsMax, dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx));
+   }
+
+   p01.X = p10.Y = 0.0;
+   p01.Y = p10.X = 1.0;
+   p11.X = p11.Y = 1.0;
+   dmtxMatrix3VMultiplyBy(&p01, reg->fit2raw);
+   dmtxMatrix3VMultiplyBy(&p11, reg->fit2raw);
+   dmtxMatrix3VMultiplyBy(&p10, reg->fit2raw);
+   widthPx = dmtxVector2Mag(dmtxVector2Sub(&v, &p11, &p01));
+   heightPx = dmtxVector2Mag(dmtxVector2Sub(&v, &p11, &p10));
+   if(widthPx < 1.0 || heightPx < 1.0)
+      return 0;
+
+   /* Sample through the middle of the thinnest possible calibration bar,
+      but at least one pixel inside the outer edge */
+   jumpsHoriz = CountCalibrationJumps(dec, reg, DmtxDirRight, max(0.5/rowsMax, 1.0/heightPx));
+   jumpsVert = CountCalibrationJumps(dec, reg, DmtxDirUp, max(0.5/colsMax, 1.0/widthPx));
+   if(jumpsHoriz == DmtxUndefined || jumpsVert == DmtxUndefined)
+      return 0;
+
+   /* Keep nearest sizes by total module count error (ties favor smaller) */
+   sizeIdxCount = 0;
+   for(sizeIdx = sizeIdxBeg; sizeIdx < sizeIdxEnd; sizeIdx++) {
+      symbolRows = dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx);
+      symbolCols = dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx);
+      dist = abs(symbolCols - 1 - jumpsHoriz) + abs(symbolRows - 1 - jumpsVert);
+
+      for(i = sizeIdxCount; i > 0 && dist < distList[i-1]; i--)
+         ;
+      if(i == DmtxSizeCandidates)
+         continue;
+
+      if(sizeIdxCount < DmtxSizeCandidates)
+         sizeIdxCount++;
+      for(j = sizeIdxCount - 1; j > i; j--) {
+         sizeIdxList[j] = sizeIdxList[j-1];
+         distList[j] = distList[j-1];
+      }
+      sizeIdxList[i] = sizeIdx;
+      distList[i] = dist;
+   }
+
+   /* Restore sizeIdx order so contrast ties resolve as in a full search */
+   for(i = 1; i < sizeIdxCount; i++) {
+      for(j = i; j > 0 && sizeIdxList[j] < sizeIdxList[j-1]; j--) {
+         sizeIdx = sizeIdxList[j];
+         sizeIdxList[j] = sizeIdxList[j-1];
+         sizeIdxList[j-1] = sizeIdx;
+      }
+   }
+
+   return sizeIdxCount;
+}
+
+/**
+ * \brief  Choose best contrast size from list and verify it
+ * \param  dec
+ * \param  reg
+ * \param  sizeIdxList
+ * \param  sizeIdxCount
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+MatrixRegionTestSizes(DmtxDecode *dec, DmtxRegion *reg, int *sizeIdxList, int sizeIdxCount)
+{
+   int i, row, col;
+   int sizeIdx, bestSizeIdx;
+   int symbolRows, symbolCols;
+   int jumpCount, errors;
+   int colors[DmtxModuleBlockMax];
+   int colorOnAvg, bestColorOnAvg;
+   int colorOffAvg, bestColorOffAvg;
+   int contrast, bestContrast;
+
+   bestSizeIdx = DmtxUndefined;
+   bestContrast = 0;
+   bestColorOnAvg = bestColorOffAvg = 0;
+
+   /* Test each barcode size to find best contrast in calibration modules */
+   for(i = 0; i < sizeIdxCount; i++) {
+
+      sizeIdx = sizeIdxList[i];
 
       symbolRows = dmtxGetSymbolAttribute(DmtxSymAttribSymbolRows, sizeIdx);
       symbolCols = dmtxGetSymbolAttribute(DmtxSymAttribSymbolCols, sizeIdx);
       colorOnAvg = colorOffAvg = 0;
 
       /* Sum module colors along horizontal calibration bar */
-      row = symbolRows - 1;
+      ReadModuleColorBlock(dec, reg, symbolRows - 1, 0, 1, symbolCols,
+            sizeIdx, reg->flowBegin.plane, colors);
       for(col = 0; col < symbolCols; col++) {
-         color = ReadModuleColor(dec, reg, row, col, sizeIdx, reg->flowBegin.plane);
          if((col & 0x01) != 0x00)
-            colorOffAvg += color;
+            colorOffAvg += colors[col];
          else
-            colorOnAvg += color;
+            colorOnAvg += colors[col];
       }
 
       /* Sum module colors along vertical calibration bar */
-      col = symbolCols - 1;
+      ReadModuleColorBlock(dec, reg, 0, symbolCols - 1, symbolRows, 1,
+            sizeIdx, reg->flowBegin.plane, colors);
       for(row = 0; row < symbolRows; row++) {
-         color = ReadModuleColor(dec, reg, row, col, sizeIdx, reg->flowBegin.plane);
          if((row & 0x01) != 0x00)
-            colorOffAvg += color;
+            colorOffAvg += colors[row];
          else
-            colorOnAvg += color;
+            colorOnAvg += colors[row];
       }
 
       colorOnAvg = (colorOnAvg * 2)/(symbolRows + symbolCols);
@@ -772,40 +1101,42 @@ MatrixRegionFindSize(DmtxDecode *dec, DmtxRegion *reg)
 static int
 CountJumpTally(DmtxDecode *dec, DmtxRegion *reg, int xStart, int yStart, DmtxDirection dir)
 {
-   int x, xInc = 0;
-   int y, yInc = 0;
+   int i, count;
    int state = DmtxModuleOn;
    int jumpCount = 0;
    int jumpThreshold;
    int tModule, tPrev;
    int darkOnLight;
-   int color;
+   int colors[DmtxModuleBlockMax];
 
    assert(xStart == 0 || yStart == 0);
    assert(dir == DmtxDirRight || dir == DmtxDirUp);
 
-   if(dir == DmtxDirRight)
-      xInc = 1;
-   else
-      yInc = 1;
-
    if(xStart == -1 || xStart == reg->symbolCols ||
          yStart == -1 || yStart == reg->symbolRows)
       state = DmtxModuleOff;
 
    darkOnLight = (int)(reg->offColor > reg->onColor);
    jumpThreshold = abs((int)(0.4 * (reg->onColor - reg->offColor) + 0.5));
-   color = ReadModuleColor(dec, reg, yStart, xStart, reg->sizeIdx, reg->flowBegin.plane);
-   tModule = (darkOnLight) ? reg->offColor - color : color - reg->offColor;
 
-   for(x = xStart + xInc, y = yStart + yInc;
-         (dir == DmtxDirRight && x < reg->symbolCols) ||
-         (dir == DmtxDirUp && y < reg->symbolRows);
-         x += xInc, y += yInc) {
+   /* Sample whole line of modules at once */
+   if(dir == DmtxDirRight) {
+      count = reg->symbolCols - xStart;
+      ReadModuleColorBlock(dec, reg, yStart, xStart, 1, count,
+            reg->sizeIdx, reg->flowBegin.plane, colors);
+   }
+   else {
+      count = reg->symbolRows - yStart;
+      ReadModuleColorBlock(dec, reg, yStart, xStart, count, 1,
+            reg->sizeIdx, reg->flowBegin.plane, colors);
+   }
+
+   tModule = (darkOnLight) ? reg->offColor - colors[0] : colors[0] - reg->offColor;
+
+   for(i = 1; i < count; i++) {
 
       tPrev = tModule;
-      color = ReadModuleColor(dec, reg, y, x, reg->sizeIdx, reg->flowBegin.plane);
-      tModule = (darkOnLight) ? reg->offColor - color : color - reg->offColor;
+      tModule = (darkOnLight) ? reg->offColor - colors[i] : colors[i] - reg->offColor;
 
       if(state == DmtxModuleOff) {
          if(tModule > tPrev + jumpThreshold) {
@@ -824,6 +1155,157 @@ CountJumpTally(DmtxDecode *dec, DmtxRegion *reg, int xStart, int yStart, DmtxDir
    return jumpCount;
 }
 
+/**
+ * \brief  Find the cached flow of one tile, filling a slot on first visit
+ * \param  dec
+ * \param  colorPlane
+ * \param  tileX
+ * \param  tileY
+ * \return Tile flow (DmtxFlowTileSize entries per row), or NULL without storage
+ *
+ * Slots are allocated as tiles are visited, so only the scanned part of an
+ * image is cached. Past DmtxFlowSlotsMax the oldest slot is recycled; trails
+ * stay local, so recently filled tiles are the ones visited again.
+ */
+static unsigned short *
+GetFlowTile(DmtxDecode *dec, int colorPlane, int tileX, int tileY)
+{
+   int tile, slot, slotCount, *slotTile;
+   unsigned short *flowCache;
+
+   tile = (colorPlane * dec->flowTileRows + tileY) * dec->flowTileCols + tileX;
+   slot = dec->flowTileSlot[tile];
+
+   if(slot == DmtxUndefined) {
+      if(dec->flowSlotUsed == dec->flowSlotCount && dec->flowSlotCount < DmtxFlowSlotsMax) {
+         slotCount = (dec->flowSlotCount == 0) ? DmtxFlowSlotsMin :
+               min(dec->flowSlotCount * 2, DmtxFlowSlotsMax);
+         flowCache = (unsigned short *)realloc(dec->flowCache, (size_t)slotCount *
+               DmtxFlowTileSize * DmtxFlowTileSize * sizeof(unsigned short));
+         if(flowCache != NULL)
+            dec->flowCache = flowCache;
+         slotTile = (int *)realloc(dec->flowSlotTile, slotCount * sizeof(int));
+         if(slotTile != NULL)
+            dec->flowSlotTile = slotTile;
+         if(flowCache != NULL && slotTile != NULL)
+            dec->flowSlotCount = slotCount;
+      }
+
+      if(dec->flowSlotUsed < dec->flowSlotCount) {
+         slot = dec->flowSlotUsed++;
+      }
+      else if(dec->flowSlotCount > 0) {
+         slot = dec->flowSlotNext;
+         dec->flowSlotNext = (slot + 1) % dec->flowSlotCount;
+         dec->flowTileSlot[dec->flowSlotTile[slot]] = DmtxUndefined;
+      }
+      else {
+         return NULL;
+      }
+
+      FillFlowTile(dec, colorPlane, tileX, tileY, dec->flowCache +
+            (size_t)slot * DmtxFlowTileSize * DmtxFlowTileSize);
+      dec->flowTileSlot[tile] = slot;
+      dec->flowSlotTile[slot] = tile;
+   }
+
+   return dec->flowCache + (size_t)slot * DmtxFlowTileSize * DmtxFlowTileSize;
+}
+
+/**
+ * \brief  Calculate flow of every pixel within one tile of the flow cache
+ * \param  dec
+ * \param  colorPlane
+ * \param  tileX
+ * \param  tileY
+ * \param  flow Receives DmtxFlowTileSize entries per tile row
+ * \return void
+ *
+ * Produces the same magnitude and departure direction as the per-pixel
+ * convolution in GetPointFlow(), packed as (mag << 3 | depart). Pixels
+ * whose neighborhood leaves the image are stored as DmtxFlowBlank.
+ */
+static void
+FillFlowTile(DmtxDecode *dec, int colorPlane, int tileX, int tileY, unsigned short *flow)
+{
+   int x, y, xBeg, xEnd, yBeg, yEnd;
+   int width, height;
+   int col, row;
+   int m0, m1, m2, m3;
+   int magMax, magAbs, depart, tmp;
+   unsigned char *pxl;
+   unsigned short *flowRow;
+   short win[DmtxFlowTileSize + 2][DmtxFlowTileSize + 2];
+   short *up, *mid, *down;
+
+   width = dec->colCount;
+   height = dec->rowCount;
+
+   xBeg = tileX * DmtxFlowTileSize;
+   yBeg = tileY * DmtxFlowTileSize;
+   xEnd = min(xBeg + DmtxFlowTileSize, width);
+   yEnd = min(yBeg + DmtxFlowTileSize, height);
+
+   /* Gather tile and its 1 pixel border into contiguous storage */
+   pxl = dec->image->pxl + colorPlane;
+   for(y = yBeg - 1; y <= yEnd; y++) {
+      row = y - yBeg + 1;
+      for(x = xBeg - 1; x <= xEnd; x++) {
+         col = x - xBeg + 1;
+         if(x < 0 || x >= width || y < 0 || y >= height)
+            win[row][col] = 0;
+         else
+            win[row][col] = pxl[dec->rowOffset[y] + x * dec->colStride];
+      }
+   }
+
+   for(y = yBeg; y < yEnd; y++) {
+      row = y - yBeg + 1;
+      up = win[row - 1] + 1;
+      mid = win[row] + 1;
+      down = win[row + 1] + 1;
+      flowRow = flow + (y - yBeg) * DmtxFlowTileSize;
+
+      for(col = 0; col < xEnd - xBeg; col++) {
+
+         /* Same 4 compass directions (-45, 0, 45, 90) as GetPointFlow() */
+         m0 = up[col] + 2*up[col+1] + mid[col+1] - down[col] - 2*down[col-1] - mid[col-1];
+         m1 = up[col+1] + 2*mid[col+1] + down[col+1] - down[col-1] - 2*mid[col-1] - up[col-1];
+         m2 = mid[col+1] + 2*down[col+1] + down[col] - mid[col-1] - 2*up[col-1] - up[col];
+         m3 = down[col+1] + 2*down[col] + down[col-1] - up[col-1] - 2*up[col] - up[col+1];
+
+         /* Strongest compass wins; earlier compass wins ties */
+         magMax = m0;
+         magAbs = abs(m0);
+         depart = 0;
+
+         tmp = abs(m1);
+         if(tmp > magAbs) { magMax = m1; magAbs = tmp; depart = 1; }
+         tmp = abs(m2);
+         if(tmp > magAbs) { magMax = m2; magAbs = tmp; depart = 2; }
+         tmp = abs(m3);
+         if(tmp > magAbs) { magMax = m3; magAbs = tmp; depart = 3; }
+
+         if(magMax > 0)
+            depart += 4;
+
+         flowRow[col] = (unsigned short)((magAbs << 3) | depart);
+      }
+
+      /* Neighborhood of image border pixels falls outside the image */
+      if(y == 0 || y == height - 1) {
+         for(col = 0; col < xEnd - xBeg; col++)
+            flowRow[col] = DmtxFlowBlank;
+      }
+      else {
+         if(xBeg == 0)
+            flowRow[0] = DmtxFlowBlank;
+         if(xEnd == width)
+            flowRow[width - 1 - xBeg] = DmtxFlowBlank;
+      }
+   }
+}
+
 /**
  *
  *
@@ -838,8 +1320,41 @@ GetPointFlow(DmtxDecode *dec, int colorPlane, DmtxPixelLoc loc, int arrive)
    int mag[4] = { 0 };
    int xAdjust, yAdjust;
    int color, colorPattern[8];
+   unsigned short packed, *tileFlow;
    DmtxPointFlow flow;
 
+   /* Use cached flow when available, filling its tile on first visit */
+   if(dec->flowTileSlot != NULL) {
+      if((unsigned int)loc.X >= (unsigned int)dec->colCount ||
+            (unsigned int)loc.Y >= (unsigned int)dec->rowCount) {
+         if(dec->windowEdges != 0)
+            NoteWindowEdge(dec, loc.X, loc.Y);
+         return dmtxBlankEdge;
+      }
+
+      tileFlow = GetFlowTile(dec, colorPlane, loc.X / DmtxFlowTileSize, loc.Y / DmtxFlowTileSize);
+   }
+   else {
+      tileFlow = NULL;
+   }
+
+   if(tileFlow != NULL) {
+      packed = tileFlow[(loc.Y % DmtxFlowTileSize) * DmtxFlowTileSize + loc.X % DmtxFlowTileSize];
+      if(packed == DmtxFlowBlank) {
+         if(dec->windowEdges != 0)
+            NoteWindowEdge(dec, loc.X, loc.Y);
+         return dmtxBlankEdge;
+      }
+
+      flow.plane = colorPlane;
+      flow.arrive = arrive;
+      flow.depart = packed & 0x07;
+      flow.mag = packed >> 3;
+      flow.loc = loc;
+
+      return flow;
+   }
+
    for(patternIdx = 0; patternIdx < 8; patternIdx++) {
       xAdjust = loc.X + dmtxPatternX[patternIdx];
       yAdjust = loc.Y + dmtxPatternY[patternIdx];
@@ -952,23 +1467,19 @@ FindStrongestNeighbor(DmtxDecode *dec, DmtxPointFlow center, int sign)
 static DmtxFollow
 FollowSeek(DmtxDecode *dec, DmtxRegion *reg, int seek)
 {
-   int i;
-   int sign;
+   int factor;
    DmtxFollow follow;
 
-   follow.loc = reg->flowBegin.loc;
-   follow.step = 0;
+   assert(abs(seek) <= reg->stepsTotal);
+
+   /* Trail is recorded in step order, so seeking is a direct lookup */
+   factor = reg->stepsTotal + 1;
+   follow.loc = dec->trail[(factor + (seek % factor)) % factor];
+   follow.step = seek;
    follow.ptr = dmtxDecodeGetCache(dec, follow.loc.X, follow.loc.Y);
    assert(follow.ptr != NULL);
    follow.neighbor = *follow.ptr;
 
-   sign = (seek > 0) ? +1 : -1;
-   for(i = 0; i != seek; i += sign) {
-      follow = FollowStep(dec, reg, follow, sign);
-      assert(follow.ptr != NULL);
-      assert(abs(follow.step) <= reg->stepsTotal);
-   }
-
    return follow;
 }
 
@@ -998,7 +1509,6 @@ FollowSeekLoc(DmtxDecode *dec, DmtxPixelLoc loc)
 static DmtxFollow
 FollowStep(DmtxDecode *dec, DmtxRegion *reg, DmtxFollow followBeg, int sign)
 {
-   int patternIdx;
    int stepMod;
    int factor;
    DmtxFollow follow;
@@ -1006,28 +1516,12 @@ FollowStep(DmtxDecode *dec, DmtxRegion *reg, DmtxFollow followBeg, int sign)
    assert(abs(sign) == 1);
    assert((int)(followBeg.neighbor & 0x40) != 0x00);
 
+   /* Wrapping index also covers the magic jumps between trail ends */
    factor = reg->stepsTotal + 1;
-   if(sign > 0)
-      stepMod = (factor + (followBeg.step % factor)) % factor;
-   else
-      stepMod = (factor - (followBeg.step % factor)) % factor;
-
-   /* End of positive trail -- magic jump */
-   if(sign > 0 && stepMod == reg->jumpToNeg) {
-      follow.loc = reg->finalNeg;
-   }
-   /* End of negative trail -- magic jump */
-   else if(sign < 0 && stepMod == reg->jumpToPos) {
-      follow.loc = reg->finalPos;
-   }
-   /* Trail in progress -- normal jump */
-   else {
-      patternIdx = (sign < 0) ? followBeg.neighbor & 0x07 : ((followBeg.neighbor & 0x38) >> 3);
-      follow.loc.X = followBeg.loc.X + dmtxPatternX[patternIdx];
-      follow.loc.Y = followBeg.loc.Y + dmtxPatternY[patternIdx];
-   }
-
    follow.step = followBeg.step + sign;
+   stepMod = (factor + (follow.step % factor)) % factor;
+
+   follow.loc = dec->trail[stepMod];
    follow.ptr = dmtxDecodeGetCache(dec, follow.loc.X, follow.loc.Y);
    assert(follow.ptr != NULL);
    follow.neighbor = *follow.ptr;
@@ -1060,6 +1554,32 @@ FollowStep2(DmtxDecode *dec, DmtxFollow followBeg, int sign)
    return follow;
 }
 
+/**
+ * \brief  Make room for at least size locations in the decoder's trail buffer
+ * \param  dec
+ * \param  size
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+TrailGrow(DmtxDecode *dec, int size)
+{
+   int trailSize;
+   DmtxPixelLoc *trail;
+
+   if(size <= dec->trailSize)
+      return DmtxPass;
+
+   trailSize = max(size, 2 * dec->trailSize);
+   trail = (DmtxPixelLoc *)realloc(dec->trail, trailSize * sizeof(DmtxPixelLoc));
+   if(trail == NULL)
+      return DmtxFail;
+
+   dec->trail = trail;
+   dec->trailSize = trailSize;
+
+   return DmtxPass;
+}
+
 /**
  * vaiiiooo
  * --------
@@ -1074,9 +1594,10 @@ TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin,
    int posAssigns, negAssigns, clears;
    int sign;
    int steps;
+   int index, indexBase;
    unsigned char *cache, *cacheNext, *cacheBeg;
    DmtxPointFlow flow, flowNext;
-   DmtxPixelLoc boundMin, boundMax;
+   DmtxPixelLoc boundMin, boundMax, locTmp;
 
    boundMin = boundMax = flowBegin.loc;
    cacheBeg = dmtxDecodeGetCache(dec, flowBegin.loc.X, flowBegin.loc.Y);
@@ -1086,6 +1607,11 @@ TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin,
 
    reg->flowBegin = flowBegin;
 
+   /* Trail buffer holds flowBegin at index 0, then the positive trail
+    * in step order, then the negative trail (reversed below) */
+   dec->trail[0] = flowBegin.loc;
+   indexBase = 0;
+
    posAssigns = negAssigns = 0;
    for(sign = 1; sign >= -1; sign -= 2) {
 
@@ -1109,6 +1635,12 @@ TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin,
             break;
          assert(!(*cacheNext & 0x80));
 
+         /* End trail early if it cannot be recorded */
+         index = indexBase + steps + 1;
+         if(TrailGrow(dec, index + 1) == DmtxFail)
+            break;
+         dec->trail[index] = flowNext.loc;
+
          /* Mark departure from current location. If flowing downstream
           * (sign < 0) then departure vector here is the arrival vector
           * of the next location. Upstream flow uses the opposite rule. */
@@ -1141,6 +1673,7 @@ TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin,
       if(sign > 0) {
          reg->finalPos = flow.loc;
          reg->jumpToNeg = steps;
+         indexBase = steps;
       }
       else {
          reg->finalNeg = flow.loc;
@@ -1148,8 +1681,16 @@ TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin,
       }
    }
    reg->stepsTotal = reg->jumpToPos + reg->jumpToNeg;
+
+   /* Positive steps continue from the far end of the negative trail */
+   for(index = 0; index < reg->jumpToPos/2; index++) {
+      locTmp = dec->trail[indexBase + 1 + index];
+      dec->trail[indexBase + 1 + index] = dec->trail[reg->stepsTotal - index];
+      dec->trail[reg->stepsTotal - index] = locTmp;
+   }
    reg->boundMin = boundMin;
    reg->boundMax = boundMax;
+   CacheMarkDirty(dec, boundMin, boundMax);
 
    /* Clear "visited" bit from trail */
    clears = TrailClear(dec, reg, 0x80);
@@ -1196,6 +1737,7 @@ TrailBlazeGapped(DmtxDecode *dec, DmtxRegion *reg, DmtxBresLine line, int stream
       return DmtxFail;
    else
       *beforeCache = 0x00; /* probably should just overwrite one direction */
+   CacheMarkDirty(dec, loc0, loc0);
 
    do {
       if(onEdge == DmtxTrue) {
@@ -1234,6 +1776,8 @@ TrailBlazeGapped(DmtxDecode *dec, DmtxRegion *reg, DmtxBresLine line, int stream
       stepDir = dirMap[3 * yStep + xStep + 4];
       assert(stepDir != 8);
 
+      CacheMarkDirty(dec, afterStep, afterStep);
+
       if(streamDir < 0) {
          *beforeCache |= (0x40 | stepDir);
          *afterCache = (((stepDir + 4)%8) << 3);
@@ -1265,18 +1809,16 @@ static int
 TrailClear(DmtxDecode *dec, DmtxRegion *reg, int clearMask)
 {
    int clears;
-   DmtxFollow follow;
+   unsigned char *cache;
 
    assert((clearMask | 0xff) == 0xff);
 
    /* Clear "visited" bit from trail */
-   clears = 0;
-   follow = FollowSeek(dec, reg, 0);
-   while(abs(follow.step) <= reg->stepsTotal) {
-      assert((int)(*follow.ptr & clearMask) != 0x00);
-      *follow.ptr &= (clearMask ^ 0xff);
-      follow = FollowStep(dec, reg, follow, +1);
-      clears++;
+   for(clears = 0; clears <= reg->stepsTotal; clears++) {
+      cache = dmtxDecodeGetCache(dec, dec->trail[clears].X, dec->trail[clears].Y);
+      assert(cache != NULL);
+      assert((int)(*cache & clearMask) != 0x00);
+      *cache &= (clearMask ^ 0xff);
    }
 
    return clears;
@@ -1289,26 +1831,16 @@ TrailClear(DmtxDecode *dec, DmtxRegion *reg, int clearMask)
 static DmtxBestLine
 FindBestSolidLine(DmtxDecode *dec, DmtxRegion *reg, int step0, int step1, int streamDir, int houghAvoid)
 {
-   int hough[3][DMTX_HOUGH_RES] = { { 0 } };
-   int houghMin, houghMax;
-   char houghTest[DMTX_HOUGH_RES];
-   int i;
    int step;
    int sign;
    int tripSteps;
-   int angleBest;
-   int hOffset, hOffsetBest;
-   int xDiff, yDiff;
-   int dH;
-   DmtxRay2 rH;
-   DmtxFollow follow;
+   int pass;
+   DmtxHough hough, coarse, *accum;
+   DmtxFollow follow, followBeg;
    DmtxBestLine line;
    DmtxPixelLoc rHp;
 
    memset(&line, 0x00, sizeof(DmtxBestLine));
-   memset(&rH, 0x00, sizeof(DmtxRay2));
-   angleBest = 0;
-   hOffset = hOffsetBest = 0;
 
    sign = 0;
 
@@ -1335,69 +1867,40 @@ FindBestSolidLine(DmtxDecode *dec, DmtxRegion *reg, int step0, int step1, int st
    }
    assert(sign == streamDir);
 
-   follow = FollowSeek(dec, reg, step0);
-   rHp = follow.loc;
+   followBeg = FollowSeek(dec, reg, step0);
+   rHp = followBeg.loc;
 
    line.stepBeg = line.stepPos = line.stepNeg = step0;
-   line.locBeg = follow.loc;
-   line.locPos = follow.loc;
-   line.locNeg = follow.loc;
-
-   /* Predetermine which angles to test */
-   for(i = 0; i < DMTX_HOUGH_RES; i++) {
-      if(houghAvoid == DmtxUndefined) {
-         houghTest[i] = 1;
-      }
-      else {
-         houghMin = (houghAvoid + DMTX_HOUGH_RES/6) % DMTX_HOUGH_RES;
-         houghMax = (houghAvoid - DMTX_HOUGH_RES/6 + DMTX_HOUGH_RES) % DMTX_HOUGH_RES;
-         if(houghMin > houghMax)
-            houghTest[i] = (i > houghMin || i < houghMax) ? 1 : 0;
-         else
-            houghTest[i] = (i > houghMin && i < houghMax) ? 1 : 0;
-      }
-   }
-
-   /* Test each angle for steps along path */
-   for(step = 0; step < tripSteps; step++) {
+   line.locBeg = followBeg.loc;
+   line.locPos = followBeg.loc;
+   line.locNeg = followBeg.loc;
 
-      xDiff = follow.loc.X - rHp.X;
-      yDiff = follow.loc.Y - rHp.Y;
+   HoughInit(&hough, houghAvoid);
+   if(dec->houghMode == DmtxHoughCoarseToFine)
+      HoughCoarse(&coarse, &hough);
 
-      /* Increment Hough accumulator */
-      for(i = 0; i < DMTX_HOUGH_RES; i++) {
+   /* Optional coarse pass narrows the angles tested in the final pass */
+   for(pass = (dec->houghMode == DmtxHoughCoarseToFine) ? 0 : 1; pass < 2; pass++) {
+      accum = (pass == 0) ? &coarse : &hough;
+      follow = followBeg;
 
-         if((int)houghTest[i] == 0)
-            continue;
-
-         dH = (rHvX[i] * yDiff) - (rHvY[i] * xDiff);
-         if(dH >= -384 && dH <= 384) {
+      /* Test each angle for steps along path */
+      for(step = 0; step < tripSteps; step++) {
 
-            if(dH > 128)
-               hOffset = 2;
-            else if(dH >= -128)
-               hOffset = 1;
-            else
-               hOffset = 0;
+         HoughVote(accum, follow.loc.X - rHp.X, follow.loc.Y - rHp.Y);
 
-            hough[hOffset][i]++;
+/*       CALLBACK_POINT_PLOT(follow.loc, (sign > 1) ? 4 : 3, 1, 2); */
 
-            /* New angle takes over lead */
-            if(hough[hOffset][i] > hough[hOffsetBest][angleBest]) {
-               angleBest = i;
-               hOffsetBest = hOffset;
-            }
-         }
+         follow = FollowStep(dec, reg, follow, sign);
       }
 
-/*    CALLBACK_POINT_PLOT(follow.loc, (sign > 1) ? 4 : 3, 1, 2); */
-
-      follow = FollowStep(dec, reg, follow, sign);
+      if(pass == 0)
+         HoughRefine(&hough, &coarse);
    }
 
-   line.angle = angleBest;
-   line.hOffset = hOffsetBest;
-   line.mag = hough[hOffsetBest][angleBest];
+   line.angle = hough.angleBest;
+   line.hOffset = hough.hOffsetBest;
+   line.mag = hough.mag;
 
    return line;
 }
@@ -1409,86 +1912,319 @@ FindBestSolidLine(DmtxDecode *dec, DmtxRegion *reg, int step0, int step1, int st
 static DmtxBestLine
 FindBestSolidLine2(DmtxDecode *dec, DmtxPixelLoc loc0, int tripSteps, int sign, int houghAvoid)
 {
-   int hough[3][DMTX_HOUGH_RES] = { { 0 } };
-   int houghMin, houghMax;
-   char houghTest[DMTX_HOUGH_RES];
-   int i;
    int step;
-   int angleBest;
-   int hOffset, hOffsetBest;
-   int xDiff, yDiff;
-   int dH;
-   DmtxRay2 rH;
+   int pass;
+   DmtxHough hough, coarse, *accum;
    DmtxBestLine line;
    DmtxPixelLoc rHp;
-   DmtxFollow follow;
+   DmtxFollow follow, followBeg;
 
    memset(&line, 0x00, sizeof(DmtxBestLine));
-   memset(&rH, 0x00, sizeof(DmtxRay2));
-   angleBest = 0;
-   hOffset = hOffsetBest = 0;
 
-   follow = FollowSeekLoc(dec, loc0);
-   rHp = line.locBeg = line.locPos = line.locNeg = follow.loc;
+   followBeg = FollowSeekLoc(dec, loc0);
+   rHp = line.locBeg = line.locPos = line.locNeg = followBeg.loc;
    line.stepBeg = line.stepPos = line.stepNeg = 0;
 
-   /* Predetermine which angles to test */
-   for(i = 0; i < DMTX_HOUGH_RES; i++) {
-      if(houghAvoid == DmtxUndefined) {
-         houghTest[i] = 1;
+   HoughInit(&hough, houghAvoid);
+   if(dec->houghMode == DmtxHoughCoarseToFine)
+      HoughCoarse(&coarse, &hough);
+
+   /* Optional coarse pass narrows the angles tested in the final pass */
+   for(pass = (dec->houghMode == DmtxHoughCoarseToFine) ? 0 : 1; pass < 2; pass++) {
+      accum = (pass == 0) ? &coarse : &hough;
+      follow = followBeg;
+
+      /* Test each angle for steps along path */
+      for(step = 0; step < tripSteps; step++) {
+
+         HoughVote(accum, follow.loc.X - rHp.X, follow.loc.Y - rHp.Y);
+
+/*       CALLBACK_POINT_PLOT(follow.loc, (sign > 1) ? 4 : 3, 1, 2); */
+
+         follow = FollowStep2(dec, follow, sign);
       }
-      else {
-         houghMin = (houghAvoid + DMTX_HOUGH_RES/6) % DMTX_HOUGH_RES;
-         houghMax = (houghAvoid - DMTX_HOUGH_RES/6 + DMTX_HOUGH_RES) % DMTX_HOUGH_RES;
-         if(houghMin > houghMax)
-            houghTest[i] = (i > houghMin || i < houghMax) ? 1 : 0;
-         else
-            houghTest[i] = (i > houghMin && i < houghMax) ? 1 : 0;
+
+      if(pass == 0)
+         HoughRefine(&hough, &coarse);
+   }
+
+   line.angle = hough.angleBest;
+   line.hOffset = hough.hOffsetBest;
+   line.mag = hough.mag;
+
+   return line;
+}
+
+/**
+ * \brief  Prepare Hough accumulator for the angles not near houghAvoid
+ * \param  hough
+ * \param  houghAvoid Angle to avoid, or DmtxUndefined to test all angles
+ * \return void
+ */
+static void
+HoughInit(DmtxHough *hough, int houghAvoid)
+{
+   int i;
+   int houghMin, houghMax;
+   DmtxBoolean test;
+
+   hough->count = 0;
+   HoughReset(hough);
+
+   houghMin = (houghAvoid + DMTX_HOUGH_RES/6) % DMTX_HOUGH_RES;
+   houghMax = (houghAvoid - DMTX_HOUGH_RES/6 + DMTX_HOUGH_RES) % DMTX_HOUGH_RES;
+
+   /* Compact tested angles so voting runs over them without gaps */
+   for(i = 0; i < DMTX_HOUGH_RES; i++) {
+      if(houghAvoid == DmtxUndefined)
+         test = DmtxTrue;
+      else if(houghMin > houghMax)
+         test = (i > houghMin || i < houghMax) ? DmtxTrue : DmtxFalse;
+      else
+         test = (i > houghMin && i < houghMax) ? DmtxTrue : DmtxFalse;
+
+      if(test == DmtxTrue) {
+         hough->angle[hough->count] = i;
+         hough->vXY[2 * hough->count] = (short)rHvX[i];
+         hough->vXY[2 * hough->count + 1] = (short)-rHvY[i];
+         hough->count++;
       }
    }
+}
+
+/**
+ * \brief  Clear votes and leader of Hough accumulator, keeping its angles
+ * \param  hough
+ * \return void
+ */
+static void
+HoughReset(DmtxHough *hough)
+{
+   memset(hough->hough, 0x00, sizeof(hough->hough));
+   hough->angleBest = 0;
+   hough->hOffsetBest = 0;
+   hough->mag = 0;
+}
 
-   /* Test each angle for steps along path */
-   for(step = 0; step < tripSteps; step++) {
+/**
+ * \brief  Prepare coarse accumulator holding every Nth angle of another
+ * \param  coarse
+ * \param  full
+ * \return void
+ */
+static void
+HoughCoarse(DmtxHough *coarse, DmtxHough *full)
+{
+   int i;
 
-      xDiff = follow.loc.X - rHp.X;
-      yDiff = follow.loc.Y - rHp.Y;
+   coarse->count = 0;
+   HoughReset(coarse);
 
-      /* Increment Hough accumulator */
-      for(i = 0; i < DMTX_HOUGH_RES; i++) {
+   for(i = 0; i < full->count; i++) {
+      if(full->angle[i] % DMTX_HOUGH_COARSE_STEP == 0) {
+         coarse->angle[coarse->count] = full->angle[i];
+         coarse->vXY[2 * coarse->count] = full->vXY[2 * i];
+         coarse->vXY[2 * coarse->count + 1] = full->vXY[2 * i + 1];
+         coarse->count++;
+      }
+   }
+}
 
-         if((int)houghTest[i] == 0)
-            continue;
+/**
+ * \brief  Restrict full accumulator to angles around the strongest coarse peaks
+ * \param  full
+ * \param  coarse Accumulator after coarse voting
+ * \return void
+ */
+static void
+HoughRefine(DmtxHough *full, DmtxHough *coarse)
+{
+   int i, j, k;
+   int count, mag, dist;
+   int peak[DMTX_HOUGH_COARSE_PEAKS];
+   int peakMag[DMTX_HOUGH_COARSE_PEAKS];
+
+   for(j = 0; j < DMTX_HOUGH_COARSE_PEAKS; j++) {
+      peak[j] = DmtxUndefined;
+      peakMag[j] = -1;
+   }
 
-         dH = (rHvX[i] * yDiff) - (rHvY[i] * xDiff);
-         if(dH >= -384 && dH <= 384) {
-            if(dH > 128)
-               hOffset = 2;
-            else if(dH >= -128)
-               hOffset = 1;
-            else
-               hOffset = 0;
-
-            hough[hOffset][i]++;
-
-            /* New angle takes over lead */
-            if(hough[hOffset][i] > hough[hOffsetBest][angleBest]) {
-               angleBest = i;
-               hOffsetBest = hOffset;
+   /* Rank coarse angles by their strongest offset */
+   for(i = 0; i < coarse->count; i++) {
+      mag = max(max(coarse->hough[0][i], coarse->hough[1][i]), coarse->hough[2][i]);
+      for(j = 0; j < DMTX_HOUGH_COARSE_PEAKS; j++) {
+         if(mag > peakMag[j]) {
+            for(k = DMTX_HOUGH_COARSE_PEAKS - 1; k > j; k--) {
+               peak[k] = peak[k-1];
+               peakMag[k] = peakMag[k-1];
             }
+            peak[j] = coarse->angle[i];
+            peakMag[j] = mag;
+            break;
+         }
+      }
+   }
+
+   /* Keep angles within half a coarse step of a peak (wrapping at 180) */
+   count = 0;
+   for(i = 0; i < full->count; i++) {
+      for(j = 0; j < DMTX_HOUGH_COARSE_PEAKS; j++) {
+         if(peak[j] == DmtxUndefined)
+            continue;
+         dist = abs(full->angle[i] - peak[j]);
+         if(min(dist, DMTX_HOUGH_RES - dist) <= DMTX_HOUGH_COARSE_STEP/2)
+            break;
+      }
+
+      if(j < DMTX_HOUGH_COARSE_PEAKS) {
+         full->angle[count] = full->angle[i];
+         full->vXY[2 * count] = full->vXY[2 * i];
+         full->vXY[2 * count + 1] = full->vXY[2 * i + 1];
+         count++;
+      }
+   }
+
+   full->count = count;
+   HoughReset(full);
+}
+
+/**
+ * \brief  Add votes from one trail location to the Hough accumulator
+ * \param  hough
+ * \param  xDiff X distance from the line's starting location
+ * \param  yDiff Y distance from the line's starting location
+ * \return void
+ */
+static void
+HoughVote(DmtxHough *hough, int xDiff, int yDiff)
+{
+   int i;
+   int dH;
+   int hOffset;
+
+#if defined(__SSE2__)
+   if(abs(xDiff) <= SHRT_MAX && abs(yDiff) <= SHRT_MAX) {
+      HoughVoteSSE2(hough, xDiff, yDiff);
+      return;
+   }
+#endif
+
+   for(i = 0; i < hough->count; i++) {
+
+      dH = (hough->vXY[2*i] * yDiff) + (hough->vXY[2*i+1] * xDiff);
+      if(dH >= -384 && dH <= 384) {
+
+         if(dH > 128)
+            hOffset = 2;
+         else if(dH >= -128)
+            hOffset = 1;
+         else
+            hOffset = 0;
+
+         hough->hough[hOffset][i]++;
+
+         /* New angle takes over lead */
+         if(hough->hough[hOffset][i] > hough->mag) {
+            hough->angleBest = hough->angle[i];
+            hough->hOffsetBest = hOffset;
+            hough->mag = hough->hough[hOffset][i];
          }
       }
+   }
+}
+
+#if defined(__SSE2__)
+/**
+ * \brief  Add votes from one trail location, 4 angles per instruction
+ * \param  hough
+ * \param  xDiff X distance from the line's starting location (16 bit)
+ * \param  yDiff Y distance from the line's starting location (16 bit)
+ * \return void
+ *
+ * Leadership is settled once per location instead of after every vote.
+ * This picks the same winner as HoughVote()'s running update:
+ * each angle gains at most one vote per location, so the first angle to
+ * reach the highest new count is the one that would have taken over last.
+ */
+static void
+HoughVoteSSE2(DmtxHough *hough, int xDiff, int yDiff)
+{
+   int i, count, chunkBest;
+   int dH, votes, votesMax;
+   int lane[4];
+   __m128i diff, vDH, vVotes, h;
+   __m128i in0, in1, in2;
+   const __m128i lo0 = _mm_set1_epi32(-385), hi0 = _mm_set1_epi32(-128);
+   const __m128i lo1 = _mm_set1_epi32(-129), hi1 = _mm_set1_epi32(129);
+   const __m128i lo2 = _mm_set1_epi32(128), hi2 = _mm_set1_epi32(385);
+
+   /* Each 32 bit lane of madd yields rHvX * yDiff - rHvY * xDiff */
+   diff = _mm_set1_epi32((int)(((unsigned int)xDiff << 16) | ((unsigned int)yDiff & 0xffff)));
+
+   votesMax = 0;
+   chunkBest = DmtxUndefined;
+
+   count = hough->count & ~0x03;
+   for(i = 0; i < count; i += 4) {
+      vDH = _mm_madd_epi16(_mm_loadu_si128((__m128i *)(hough->vXY + 2*i)), diff);
+
+      in0 = _mm_and_si128(_mm_cmpgt_epi32(vDH, lo0), _mm_cmplt_epi32(vDH, hi0));
+      in1 = _mm_and_si128(_mm_cmpgt_epi32(vDH, lo1), _mm_cmplt_epi32(vDH, hi1));
+      in2 = _mm_and_si128(_mm_cmpgt_epi32(vDH, lo2), _mm_cmplt_epi32(vDH, hi2));
+
+      /* Most angles miss the line entirely */
+      if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(in0, in1), in2)) == 0)
+         continue;
 
-/*    CALLBACK_POINT_PLOT(follow.loc, (sign > 1) ? 4 : 3, 1, 2); */
+      /* Masks are -1 where voting, so subtracting adds one vote */
+      h = _mm_sub_epi32(_mm_loadu_si128((__m128i *)(hough->hough[0] + i)), in0);
+      _mm_storeu_si128((__m128i *)(hough->hough[0] + i), h);
+      vVotes = _mm_and_si128(h, in0);
+
+      h = _mm_sub_epi32(_mm_loadu_si128((__m128i *)(hough->hough[1] + i)), in1);
+      _mm_storeu_si128((__m128i *)(hough->hough[1] + i), h);
+      vVotes = _mm_or_si128(vVotes, _mm_and_si128(h, in1));
+
+      h = _mm_sub_epi32(_mm_loadu_si128((__m128i *)(hough->hough[2] + i)), in2);
+      _mm_storeu_si128((__m128i *)(hough->hough[2] + i), h);
+      vVotes = _mm_or_si128(vVotes, _mm_and_si128(h, in2));
+
+      /* Remember first chunk holding the highest new count */
+      _mm_storeu_si128((__m128i *)lane, vVotes);
+      votes = max(max(lane[0], lane[1]), max(lane[2], lane[3]));
+      if(votes > votesMax) {
+         votesMax = votes;
+         chunkBest = i;
+      }
+   }
 
-      follow = FollowStep2(dec, follow, sign);
+   /* Remaining angles one at a time */
+   for(; i < hough->count; i++) {
+      dH = (hough->vXY[2*i] * yDiff) + (hough->vXY[2*i+1] * xDiff);
+      if(dH >= -384 && dH <= 384) {
+         votes = ++(hough->hough[(dH > 128) ? 2 : (dH >= -128) ? 1 : 0][i]);
+         if(votes > votesMax) {
+            votesMax = votes;
+            chunkBest = i;
+         }
+      }
    }
 
-   line.angle = angleBest;
-   line.hOffset = hOffsetBest;
-   line.mag = hough[hOffsetBest][angleBest];
+   /* New angle takes over lead */
+   if(votesMax > hough->mag) {
+      for(i = chunkBest; ; i++) {
+         dH = (hough->vXY[2*i] * yDiff) + (hough->vXY[2*i+1] * xDiff);
+         if(dH >= -384 && dH <= 384 &&
+               hough->hough[(dH > 128) ? 2 : (dH >= -128) ? 1 : 0][i] == votesMax)
+            break;
+      }
 
-   return line;
+      hough->angleBest = hough->angle[i];
+      hough->hOffsetBest = (dH > 128) ? 2 : (dH >= -128) ? 1 : 0;
+      hough->mag = votesMax;
+   }
 }
+#endif
 
 /**
  *
@@ -1654,6 +2390,12 @@ MatrixRegionAlignCalibEdge(DmtxDecode *dec, DmtxRegion *reg, int edgeLoc)
    line = BresLineInit(loc0, loc1, locOrigin);
    steps = TrailBlazeGapped(dec, reg, line, streamDir);
 
+   /* Same as a finder edge in MatrixRegionOrientation() */
+   if((dec->windowEdgesHit & dec->windowEdges) != 0) {
+      AppendTileOpenTrail(dec->windowResult, reg);
+      return DmtxFail;
+   }
+
    bestLine = FindBestSolidLine2(dec, loc0, steps, streamDir, avoidAngle);
    if(bestLine.mag < 5) {
       ;
@@ -0,0 +1,267 @@
+/**
+ * libdmtx - Data Matrix Encoding/Decoding Library
+ * Copyright 2008, 2009 Mike Laughton. All rights reserved.
+ * Copyright 2012-2016 Vadim A. Misbakh-Soloviov. All rights reserved.
+ *
+ * See LICENSE file in the main project directory for full
+ * terms of use and distribution.
+ *
+ * Contact:
+ * Vadim A. Misbakh-Soloviov <dmtx@mva.name>
+ * Mike Laughton <mike@dragonflylogic.com>
+ *
+ * \file dmtxregionall.c
+ * \brief Find (and optionally decode) every region of an image in one call
+ */
+
+/**
+ * dmtxRegionFindAll() runs the region search to completion before anything
+ * is decoded. Each region is marked in the cache as soon as it is found, so
+ * a symbol that later fails to decode is not found (and fitted) again, and
+ * regions describing the same symbol are merged by corner proximity.
+ *
+ * Decoding only reads the decoder, so regions are then decoded on up to
+ * DmtxPropThreadCount workers, each holding its own message storage and
+ * placement map. Results stay in the order regions were found.
+ */
+
+/**
+ * \brief  Find every region of the current image
+ * \param  dec
+ * \param  timeout Limits the search and decoding together (NULL if none)
+ * \param  decode DmtxTrue to decode each region, DmtxFalse to only locate them
+ * \param  count Receives the number of results
+ * \return Array of results, released with dmtxRegionFindAllDestroy(), or NULL
+ *         on failure
+ *
+ * Located regions that were not decoded report DmtxBatchFound when decoding
+ * was not requested, DmtxBatchFailed when decoding failed, and
+ * DmtxBatchTimedOut when time ran out first.
+ */
+extern DmtxDecodeResult *
+dmtxRegionFindAll(DmtxDecode *dec, DmtxTime *timeout, DmtxBoolean decode, int *count)
+{
+   int i, size;
+   long long deadline;
+   DmtxRegion *reg;
+   DmtxDecodeResult *results, *resultsGrown;
+
+   if(dec == NULL || count == NULL)
+      return NULL;
+
+   *count = 0;
+
+   deadline = (timeout == NULL) ? DmtxUndefined : TimeToNsec(*timeout);
+
+   size = DmtxTileRegionInit;
+   results = (DmtxDecodeResult *)malloc(size * sizeof(DmtxDecodeResult));
+   if(results == NULL)
+      return NULL;
+
+   for(;;) {
+      reg = dmtxRegionFindNextNsec(dec, deadline);
+      if(reg == NULL)
+         break;
+
+      /* Mark now so the area is not scanned again, whether or not it decodes */
+      CacheFillRegion(dec, reg);
+
+      for(i = 0; i < *count; i++) {
+         if(RegionsCoincide(&(results[i].region), reg) == DmtxTrue)
+            break;
+      }
+
+      if(i < *count) {
+         dmtxRegionDestroy(&reg);
+         continue;
+      }
+
+      if(*count == size) {
+         size *= 2;
+         resultsGrown = (DmtxDecodeResult *)realloc(results, size * sizeof(DmtxDecodeResult));
+         if(resultsGrown == NULL) {
+            dmtxRegionDestroy(&reg);
+            free(results);
+            *count = 0;
+            return NULL;
+         }
+         results = resultsGrown;
+      }
+
+      memset(&results[*count], 0x00, sizeof(DmtxDecodeResult));
+      results[*count].status = DmtxBatchFound;
+      results[*count].region = *reg;
+      GetRegionCorners(reg, results[*count].corner);
+      (*count)++;
+
+      dmtxRegionDestroy(&reg);
+   }
+
+   if(decode == DmtxTrue && *count > 0 &&
+         DecodeFoundRegions(dec, results, *count, deadline) == DmtxFail) {
+      dmtxRegionFindAllDestroy(&results, *count);
+      *count = 0;
+      return NULL;
+   }
+
+   return results;
+}
+
+/**
+ * \brief  Free results returned by dmtxRegionFindAll()
+ * \param  results
+ * \param  count
+ * \return DmtxPass | DmtxFail
+ */
+extern DmtxPassFail
+dmtxRegionFindAllDestroy(DmtxDecodeResult **results, int count)
+{
+   if(results == NULL || *results == NULL)
+      return DmtxFail;
+
+   dmtxDecodeBatchClearResults(*results, count);
+
+   free(*results);
+
+   *results = NULL;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Decode located regions across worker threads
+ * \param  dec
+ * \param  results
+ * \param  count
+ * \param  deadline
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+DecodeFoundRegions(DmtxDecode *dec, DmtxDecodeResult *results, int count, long long deadline)
+{
+   int i;
+   DmtxRegionDecodeJob job;
+   DmtxRegionDecodeWorker *worker;
+   DmtxPassFail err;
+
+   job.dec = dec;
+   job.results = results;
+   job.count = count;
+   job.deadline = deadline;
+   job.workerCount = GetThreadCount(dec->threadCount, count);
+   job.next = 0;
+
+   worker = (DmtxRegionDecodeWorker *)calloc(job.workerCount, sizeof(DmtxRegionDecodeWorker));
+   if(worker == NULL)
+      return DmtxFail;
+
+   for(i = 0; i < job.workerCount; i++) {
+      worker[i].job = &job;
+      worker[i].placeMapSizeIdx = DmtxUndefined;
+   }
+
+   err = DmtxPass;
+
+   if(job.workerCount == 1)
+      RegionDecodeWorker(&worker[0]);
+#ifdef HAVE_PTHREAD_H
+   else if(pthread_mutex_init(&job.mutex, NULL) != 0)
+      err = DmtxFail;
+   else {
+      for(i = 0; i < job.workerCount; i++) {
+         if(pthread_create(&worker[i].thread, NULL, RegionDecodeThread, &worker[i]) != 0)
+            break;
+      }
+
+      /* Threads that did start share all regions between them */
+      if(i == 0)
+         RegionDecodeWorker(&worker[0]);
+
+      while(i-- > 0)
+         pthread_join(worker[i].thread, NULL);
+
+      pthread_mutex_destroy(&job.mutex);
+   }
+#endif
+
+   for(i = 0; i < job.workerCount; i++) {
+      if(worker[i].messageStorage != NULL)
+         free(worker[i].messageStorage);
+      if(worker[i].placeMap != NULL)
+         free(worker[i].placeMap);
+   }
+   free(worker);
+
+   return err;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * \brief  pthread entry point for a region decode worker
+ * \param  arg DmtxRegionDecodeWorker
+ * \return NULL
+ */
+static void *
+RegionDecodeThread(void *arg)
+{
+   RegionDecodeWorker((DmtxRegionDecodeWorker *)arg);
+
+   return NULL;
+}
+#endif
+
+/**
+ * \brief  Decode regions from the shared job until none are left
+ * \param  worker
+ * \return void
+ */
+static void
+RegionDecodeWorker(DmtxRegionDecodeWorker *worker)
+{
+   int resultIdx;
+   DmtxRegionDecodeJob *job;
+   DmtxDecodeResult *result;
+
+   job = worker->job;
+
+   for(;;) {
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_lock(&job->mutex);
+#endif
+      resultIdx = job->next++;
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_unlock(&job->mutex);
+#endif
+
+      if(resultIdx >= job->count)
+         break;
+
+      result = &(job->results[resultIdx]);
+
+      if(DeadlineExceeded(job->deadline) == DmtxTrue) {
+         result->status = DmtxBatchTimedOut;
+         continue;
+      }
+
+      result->status = DmtxBatchFailed;
+
+      if(worker->messageStorage == NULL) {
+         worker->messageStorageSize = dmtxMessageGetStorageSize(DmtxUndefined, DmtxFormatMatrix);
+         worker->messageStorage = (unsigned char *)malloc(worker->messageStorageSize);
+         if(worker->messageStorage == NULL)
+            continue;
+      }
+
+      /* Region is already marked, so the shared decoder is only read */
+      if(dmtxMessageInit(&(worker->message), result->region.sizeIdx, DmtxFormatMatrix,
+            worker->messageStorage, worker->messageStorageSize) == DmtxFail ||
+            PopulateArrayFromMatrix(job->dec, &(result->region), &(worker->message)) == DmtxFail ||
+            DecodeRegionArray(job->dec, &(result->region), DmtxUndefined, &(worker->message),
+            &(worker->placeMap), &(worker->placeMapSizeIdx)) == DmtxFail)
+         continue;
+
+      SetResultOutput(result, &(worker->message));
+   }
+}
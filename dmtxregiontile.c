@@ -0,0 +1,895 @@
+/**
+ * libdmtx - Data Matrix Encoding/Decoding Library
+ * Copyright 2008, 2009 Mike Laughton. All rights reserved.
+ * Copyright 2012-2016 Vadim A. Misbakh-Soloviov. All rights reserved.
+ *
+ * See LICENSE file in the main project directory for full
+ * terms of use and distribution.
+ *
+ * Contact:
+ * Vadim A. Misbakh-Soloviov <dmtx@mva.name>
+ * Mike Laughton <mike@dragonflylogic.com>
+ *
+ * \file dmtxregiontile.c
+ * \brief Search for regions in overlapping tiles across worker threads
+ */
+
+/**
+ * When DmtxPropThreadCount is anything but 1, the first dmtxRegionFindNext()
+ * call on an image splits the search area into a grid of tiles and scans all
+ * of them, then later calls hand out the regions found one at a time.
+ *
+ * Each tile is scanned by an ordinary DmtxDecode attached to a window image
+ * that shares pixels with the caller's image, so every tile has its own scan
+ * grid, trail and visited cache and nothing written during the search is
+ * shared between threads. Scan grids partition the search area and windows
+ * reach only one pixel past their tile (plus DmtxPropTileOverlap, 0 unless
+ * set), so each location is tested once and no trail is followed twice.
+ *
+ * A tile keeps the regions that stay clear of its inner window edges. A
+ * location whose test reached an inner edge, or found a region close to one,
+ * may belong to a symbol that continues into the next tile, so the tile
+ * passes it back instead. Once the tiles are done the calling decoder tests
+ * those locations again on the whole image, where trails and regions have
+ * room to finish, and a symbol it finds that a tile already found is merged
+ * when their corners coincide.
+ *
+ * Regions are reported in tile order (row by row from the bottom) followed
+ * by those found from passed back locations, rather than the coarse-to-fine
+ * order of the sequential search.
+ *
+ * A scan stopped by a deadline or budget resumes with the tiles that were
+ * not scanned to the end, then the passed back locations not yet tested. A
+ * tile cut short by the deadline keeps its scan grid position but not its
+ * visited cache, so regions it finds again are merged with those already
+ * reported.
+ *
+ * Tile decoders are kept on the calling decoder and reused by later scans,
+ * until dmtxDecodeDestroy().
+ */
+
+/**
+ * \brief  Return the next region found by a tiled search of the image
+ * \param  dec
+ * \param  deadline Limits the scan when one runs
+ * \param  budget Locations the scan may test, spent a whole tile at a time
+ * \param  status Receives why no region was returned
+ * \return Detected region (if found)
+ */
+static DmtxRegion *
+TileRegionFindNext(DmtxDecode *dec, long long deadline, long budget, DmtxScanStatus *status)
+{
+   if(dec->tileRegionNext == DmtxUndefined) {
+      dec->tileRegionCount = 0;
+      dec->tileRegionNext = 0;
+      dec->tilePending = DmtxUndefined;
+   }
+
+   /* Scan more of the image once every region found so far is handed out */
+   if(dec->tileRegionNext >= dec->tileRegionCount && dec->tilePending != 0) {
+      if(ScanTiles(dec, deadline, budget) == DmtxFail)
+         dec->tilePending = 0;
+   }
+
+   if(dec->tileRegionNext < dec->tileRegionCount) {
+      *status = DmtxScanFound;
+      return dmtxRegionCreate(&(dec->tileRegion[dec->tileRegionNext++]));
+   }
+
+   if(dec->tilePending == 0)
+      *status = DmtxScanExhausted;
+   else if(DeadlineExceeded(deadline) == DmtxTrue)
+      *status = DmtxScanTimedOut;
+   else
+      *status = DmtxScanBudgetSpent;
+
+   return NULL;
+}
+
+/**
+ * \brief  Scan every pending tile of the image, then the locations they passed back
+ * \param  dec
+ * \param  deadline
+ * \param  budget
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+ScanTiles(DmtxDecode *dec, long long deadline, long budget)
+{
+   int i, width, height, overlap, tileStep, tileCount, tilesLeft;
+   long scanned;
+   unsigned char *tileState;
+   DmtxScanGrid *tileGrid;
+   DmtxScanTileJob job;
+   DmtxPassFail err;
+
+   width = dec->xMax - dec->xMin + 1;
+   height = dec->yMax - dec->yMin + 1;
+   if(width < 1 || height < 1) {
+      dec->tilePending = 0;
+      return DmtxPass;
+   }
+
+   /* Passing back edge locations finds large symbols, so no overlap is needed */
+   overlap = (dec->tileOverlap == DmtxUndefined) ? 0 : dec->tileOverlap;
+
+   /* Tiles split the search area evenly, so none ends up a sliver */
+   tileStep = max(dec->tileSize / dec->scale, DmtxTileStepMin);
+
+   job.dec = dec;
+   job.deadline = deadline;
+   job.budget = budget;
+   job.scanned = 0;
+   job.tileCols = (width + tileStep - 1) / tileStep;
+   job.tileRows = (height + tileStep - 1) / tileStep;
+   job.tileOverlap = overlap / dec->scale;
+   job.next = 0;
+
+   tileCount = job.tileCols * job.tileRows;
+
+   /* Tile layout only changes along with settings that restart the scan */
+   if(dec->tilePending == DmtxUndefined) {
+      if(tileCount > dec->tileStateSize) {
+         tileState = (unsigned char *)realloc(dec->tileState, tileCount);
+         if(tileState == NULL)
+            return DmtxFail;
+         dec->tileState = tileState;
+
+         tileGrid = (DmtxScanGrid *)realloc(dec->tileGrid, tileCount * sizeof(DmtxScanGrid));
+         if(tileGrid == NULL)
+            return DmtxFail;
+         dec->tileGrid = tileGrid;
+
+         dec->tileStateSize = tileCount;
+      }
+      memset(dec->tileState, DmtxTileUnscanned, tileCount);
+      dec->tileHandoffCount = 0;
+      dec->tileHandoffNext = 0;
+   }
+
+   tilesLeft = 0;
+   for(i = 0; i < tileCount; i++) {
+      if(dec->tileState[i] != DmtxTileScanned)
+         tilesLeft++;
+   }
+
+   err = DmtxPass;
+   if(tilesLeft > 0)
+      err = ScanPendingTiles(dec, &job, tilesLeft);
+
+   /* Passed back locations wait for the tiles, and get the time they left */
+   if(err == DmtxPass && dec->tileHandoffNext < dec->tileHandoffCount &&
+         (tilesLeft == 0 || DeadlineExceeded(deadline) == DmtxFalse) &&
+         (budget == DmtxUndefined || job.scanned < budget)) {
+      err = RescanTileHandoffs(dec, deadline,
+            (budget == DmtxUndefined) ? DmtxUndefined : budget - job.scanned, &scanned);
+   }
+
+   dec->tilePending = dec->tileHandoffCount - dec->tileHandoffNext;
+   for(i = 0; i < tileCount; i++) {
+      if(dec->tileState[i] != DmtxTileScanned)
+         dec->tilePending++;
+   }
+
+   return err;
+}
+
+/**
+ * \brief  Run the tile workers over every pending tile and merge what they found
+ * \param  dec
+ * \param  job Tile layout and limits of the scan
+ * \param  tilesLeft Tiles not yet scanned to the end
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+ScanPendingTiles(DmtxDecode *dec, DmtxScanTileJob *job, int tilesLeft)
+{
+   int i, j, tileCount, handoffCount;
+   DmtxPixelLoc *handoff;
+   DmtxScanTileWorker *worker;
+   DmtxPassFail err;
+
+   tileCount = job->tileCols * job->tileRows;
+   job->workerCount = GetThreadCount(dec->threadCount, tilesLeft);
+
+   if(job->workerCount > dec->tileWorkerCount) {
+      worker = (DmtxScanTileWorker *)realloc(dec->tileWorker,
+            job->workerCount * sizeof(DmtxScanTileWorker));
+      if(worker == NULL)
+         return DmtxFail;
+      memset(worker + dec->tileWorkerCount, 0,
+            (job->workerCount - dec->tileWorkerCount) * sizeof(DmtxScanTileWorker));
+      dec->tileWorker = worker;
+      dec->tileWorkerCount = job->workerCount;
+   }
+   worker = dec->tileWorker;
+
+   job->result = (DmtxScanTileResult *)calloc(tileCount, sizeof(DmtxScanTileResult));
+   if(job->result == NULL)
+      return DmtxFail;
+
+   for(i = 0; i < job->workerCount; i++)
+      worker[i].job = job;
+
+   err = DmtxPass;
+
+   if(job->workerCount == 1)
+      ScanTileWorker(&worker[0]);
+#ifdef HAVE_PTHREAD_H
+   else if(pthread_mutex_init(&job->mutex, NULL) != 0)
+      err = DmtxFail;
+   else {
+      for(i = 0; i < job->workerCount; i++) {
+         if(pthread_create(&worker[i].thread, NULL, ScanTileThread, &worker[i]) != 0)
+            break;
+      }
+
+      /* Threads that did start share all tiles between them */
+      if(i == 0)
+         ScanTileWorker(&worker[0]);
+
+      while(i-- > 0)
+         pthread_join(worker[i].thread, NULL);
+
+      pthread_mutex_destroy(&job->mutex);
+   }
+#endif
+
+   /* Merge in tile order so results do not depend on thread scheduling */
+   handoffCount = dec->tileHandoffCount;
+   for(i = 0; i < tileCount; i++)
+      handoffCount += job->result[i].handoffCount;
+
+   if(err == DmtxPass && handoffCount > dec->tileHandoffSize) {
+      handoff = (DmtxPixelLoc *)realloc(dec->tileHandoff, handoffCount * sizeof(DmtxPixelLoc));
+      if(handoff == NULL) {
+         err = DmtxFail;
+      }
+      else {
+         dec->tileHandoff = handoff;
+         dec->tileHandoffSize = handoffCount;
+      }
+   }
+
+   for(i = 0; i < tileCount; i++) {
+      for(j = 0; err == DmtxPass && j < job->result[i].count; j++)
+         err = MergeTileRegion(dec, &(job->result[i].region[j]));
+
+      if(err == DmtxPass && job->result[i].handoffCount > 0) {
+         memcpy(dec->tileHandoff + dec->tileHandoffCount, job->result[i].handoff,
+               job->result[i].handoffCount * sizeof(DmtxPixelLoc));
+         dec->tileHandoffCount += job->result[i].handoffCount;
+      }
+
+      if(job->result[i].region != NULL)
+         free(job->result[i].region);
+
+      if(job->result[i].handoff != NULL)
+         free(job->result[i].handoff);
+
+      if(job->result[i].openTrail != NULL)
+         free(job->result[i].openTrail);
+   }
+   free(job->result);
+
+   return err;
+}
+
+/**
+ * \brief  Test locations passed back by tiles on the whole image
+ * \param  dec
+ * \param  deadline
+ * \param  budget Locations to test at most, or DmtxUndefined
+ * \param  scanned Receives the number of locations tested
+ * \return DmtxPass | DmtxFail
+ *
+ * At least one location is tested, so every call makes some progress.
+ */
+static DmtxPassFail
+RescanTileHandoffs(DmtxDecode *dec, long long deadline, long budget, long *scanned)
+{
+   DmtxBoolean fitted;
+   DmtxRegion *reg;
+   DmtxPassFail err;
+
+   *scanned = 0;
+
+   while(dec->tileHandoffNext < dec->tileHandoffCount) {
+      if(budget != DmtxUndefined && *scanned >= budget)
+         break;
+
+      (*scanned)++;
+      reg = RegionScanPixel(dec, dec->tileHandoff[dec->tileHandoffNext++], &fitted);
+      if(reg != NULL) {
+         err = MergeTileRegion(dec, reg);
+         dmtxRegionDestroy(&reg);
+         if(err == DmtxFail)
+            return DmtxFail;
+      }
+
+      if(fitted == DmtxTrue && DeadlineExceeded(deadline) == DmtxTrue)
+         break;
+   }
+
+   return DmtxPass;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * \brief  pthread entry point for a tile worker
+ * \param  arg DmtxScanTileWorker
+ * \return NULL
+ */
+static void *
+ScanTileThread(void *arg)
+{
+   ScanTileWorker((DmtxScanTileWorker *)arg);
+
+   return NULL;
+}
+#endif
+
+/**
+ * \brief  Scan tiles from the shared job until none are left
+ * \param  worker
+ * \return void
+ */
+static void
+ScanTileWorker(DmtxScanTileWorker *worker)
+{
+   int tileIdx, tileCount;
+   long scanned;
+   DmtxBoolean budgetSpent;
+   DmtxScanTileJob *job;
+
+   job = worker->job;
+   tileCount = job->tileCols * job->tileRows;
+
+   for(;;) {
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_lock(&job->mutex);
+#endif
+      /* Tiles at or past next are not being scanned, so their state is stable */
+      do {
+         tileIdx = job->next++;
+      } while(tileIdx < tileCount && job->dec->tileState[tileIdx] == DmtxTileScanned);
+      budgetSpent = (job->budget != DmtxUndefined && job->scanned >= job->budget) ?
+            DmtxTrue : DmtxFalse;
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_unlock(&job->mutex);
+#endif
+
+      if(tileIdx >= tileCount || budgetSpent == DmtxTrue)
+         break;
+
+      scanned = ScanTile(worker, tileIdx);
+
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_lock(&job->mutex);
+#endif
+      job->scanned += scanned;
+#ifdef HAVE_PTHREAD_H
+      if(job->workerCount > 1)
+         pthread_mutex_unlock(&job->mutex);
+#endif
+
+      /* Checked after the tile so that every call makes some progress */
+      if(DeadlineExceeded(job->deadline) == DmtxTrue)
+         break;
+   }
+}
+
+/**
+ * \brief  Find every region inside one tile
+ * \param  worker
+ * \param  tileIdx
+ * \return Number of locations tested
+ *
+ * A tile stopped by the deadline saves its scan grid to resume from later.
+ */
+static long
+ScanTile(DmtxScanTileWorker *worker, int tileIdx)
+{
+   int i, col, row, width, height;
+   int xBeg, xEnd, yBeg, yEnd, x0, y0, x1, y1, yTop;
+   long scanned, tileScanned;
+   DmtxScanStatus status;
+   DmtxImage *img;
+   DmtxDecode *dec, *tileDec;
+   DmtxRegion *reg;
+   DmtxScanTileJob *job;
+   DmtxPassFail err;
+
+   job = worker->job;
+   dec = job->dec;
+   img = dec->image;
+
+   /* Part of the search area scanned by this tile, end exclusive */
+   col = tileIdx % job->tileCols;
+   row = tileIdx / job->tileCols;
+   width = dec->xMax - dec->xMin + 1;
+   height = dec->yMax - dec->yMin + 1;
+   xBeg = dec->xMin + col * width / job->tileCols;
+   xEnd = dec->xMin + (col + 1) * width / job->tileCols;
+   yBeg = dec->yMin + row * height / job->tileRows;
+   yEnd = dec->yMin + (row + 1) * height / job->tileRows;
+
+   /* Window around it that trails may follow, limited to the image. The
+      extra pixel lets flow be measured on the tile's own border. */
+   x0 = max(xBeg - job->tileOverlap - 1, 0);
+   y0 = max(yBeg - job->tileOverlap - 1, 0);
+   x1 = min(xEnd + job->tileOverlap + 1, img->width / dec->scale);
+   y1 = min(yEnd + job->tileOverlap + 1, img->height / dec->scale);
+
+   /* Packed 1 bpp rows can only be split on a byte boundary */
+   if(img->bitsPerPixel == 1) {
+      while((x0 * dec->scale) % 8 != 0)
+         x0--;
+   }
+
+   if(xBeg >= x1 || yBeg >= y1) {
+      dec->tileState[tileIdx] = DmtxTileScanned;
+      return 0;
+   }
+
+   /* Window keeps the image row stride and starts at its top row in memory */
+   width = (x1 - x0) * dec->scale;
+   height = (y1 - y0) * dec->scale;
+   yTop = (img->imageFlip & DmtxFlipY) ? y0 * dec->scale : y0 * dec->scale + height - 1;
+
+   worker->view = *img;
+   worker->view.width = width;
+   worker->view.height = height;
+   worker->view.rowPadBytes = img->rowSizeBytes - (width * img->bitsPerPixel + 7) / 8;
+   worker->view.pxl = img->pxl + dmtxImageGetByteOffset(img, x0 * dec->scale, yTop);
+
+   if(PrepareTileWorker(worker) == DmtxFail) {
+      dec->tileState[tileIdx] = DmtxTileScanned;
+      return 0;
+   }
+
+   tileDec = worker->dec;
+   tileDec->xMin = xBeg - x0;
+   tileDec->xMax = min(xEnd, x1) - 1 - x0;
+   tileDec->yMin = yBeg - y0;
+   tileDec->yMax = min(yEnd, y1) - 1 - y0;
+   tileDec->grid = (dec->tileState[tileIdx] == DmtxTileStopped) ?
+         dec->tileGrid[tileIdx] : InitScanGrid(tileDec);
+
+   /* Window sides that cut through the image, where symbols may continue */
+   tileDec->windowEdges = 0;
+   if(x0 > 0)
+      tileDec->windowEdges |= DmtxEdgeLeft;
+   if(x1 < img->width / dec->scale)
+      tileDec->windowEdges |= DmtxEdgeRight;
+   if(y0 > 0)
+      tileDec->windowEdges |= DmtxEdgeBottom;
+   if(y1 < img->height / dec->scale)
+      tileDec->windowEdges |= DmtxEdgeTop;
+   tileDec->windowResult = &(job->result[tileIdx]);
+
+   scanned = 0;
+
+   for(;;) {
+      reg = GridRegionFindNext(tileDec, job->deadline, DmtxUndefined, &tileScanned, &status);
+      scanned += tileScanned;
+      if(reg == NULL)
+         break;
+
+      /* Mark now, since nobody decodes (and marks) the region inside the tile */
+      CacheFillRegion(tileDec, reg);
+
+      TranslateRegion(reg, x0, y0);
+      err = AppendTileRegion(&(job->result[tileIdx]), reg);
+      dmtxRegionDestroy(&reg);
+
+      if(err == DmtxFail)
+         break;
+   }
+
+   for(i = 0; i < job->result[tileIdx].handoffCount; i++) {
+      job->result[tileIdx].handoff[i].X += x0;
+      job->result[tileIdx].handoff[i].Y += y0;
+   }
+
+   if(status == DmtxScanTimedOut) {
+      dec->tileState[tileIdx] = DmtxTileStopped;
+      dec->tileGrid[tileIdx] = tileDec->grid;
+   }
+   else {
+      dec->tileState[tileIdx] = DmtxTileScanned;
+   }
+
+   return scanned;
+}
+
+/**
+ * \brief  Point worker decoder at its current tile, creating it only when needed
+ * \param  worker
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+PrepareTileWorker(DmtxScanTileWorker *worker)
+{
+   DmtxDecode *dec, *tileDec;
+
+   dec = worker->job->dec;
+
+   /* Reuse existing decoder while tiles fit its cache */
+   if(worker->dec == NULL || dmtxDecodeSetImage(worker->dec, &(worker->view)) == DmtxFail) {
+      dmtxDecodeDestroy(&(worker->dec));
+
+      worker->dec = dmtxDecodeCreate(&(worker->view), dec->scale);
+      if(worker->dec == NULL)
+         return DmtxFail;
+   }
+
+   /* Tiles are searched sequentially with the caller's current detection settings */
+   tileDec = worker->dec;
+   tileDec->edgeMin = dec->edgeMin;
+   tileDec->edgeMax = dec->edgeMax;
+   tileDec->scanGap = dec->scanGap;
+   tileDec->fnc1 = dec->fnc1;
+   tileDec->squareDevn = dec->squareDevn;
+   tileDec->sizeIdxExpected = dec->sizeIdxExpected;
+   tileDec->edgeThresh = dec->edgeThresh;
+   tileDec->houghMode = dec->houghMode;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Destroy the tile decoders kept by dec
+ * \param  dec
+ * \return void
+ */
+static void
+ReleaseTileWorkers(DmtxDecode *dec)
+{
+   int i;
+
+   for(i = 0; i < dec->tileWorkerCount; i++)
+      dmtxDecodeDestroy(&(dec->tileWorker[i].dec));
+
+   if(dec->tileWorker != NULL)
+      free(dec->tileWorker);
+
+   dec->tileWorker = NULL;
+   dec->tileWorkerCount = 0;
+}
+
+/**
+ * \brief  Add a copy of region to the regions found in a tile
+ * \param  result
+ * \param  reg
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+AppendTileRegion(DmtxScanTileResult *result, DmtxRegion *reg)
+{
+   int size;
+   DmtxRegion *region;
+
+   if(result->count == result->size) {
+      size = (result->size == 0) ? DmtxTileRegionInit : result->size * 2;
+      region = (DmtxRegion *)realloc(result->region, size * sizeof(DmtxRegion));
+      if(region == NULL)
+         return DmtxFail;
+      result->region = region;
+      result->size = size;
+   }
+
+   result->region[result->count++] = *reg;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Add a location to those a tile passes back
+ * \param  result
+ * \param  loc
+ * \return DmtxPass | DmtxFail
+ */
+static DmtxPassFail
+AppendTileHandoff(DmtxScanTileResult *result, DmtxPixelLoc loc)
+{
+   int size;
+   DmtxPixelLoc *handoff;
+
+   if(result->handoffCount == result->handoffSize) {
+      size = (result->handoffSize == 0) ? DmtxTileRegionInit : result->handoffSize * 2;
+      handoff = (DmtxPixelLoc *)realloc(result->handoff, size * sizeof(DmtxPixelLoc));
+      if(handoff == NULL)
+         return DmtxFail;
+      result->handoff = handoff;
+      result->handoffSize = size;
+   }
+
+   result->handoff[result->handoffCount++] = loc;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Add a region to those found in the image unless it was found already
+ * \param  dec
+ * \param  reg Region in image coordinates
+ * \return DmtxPass | DmtxFail
+ *
+ * The region is marked in the cache of dec, so passed back locations inside
+ * it are skipped like they would be by the sequential search.
+ */
+static DmtxPassFail
+MergeTileRegion(DmtxDecode *dec, DmtxRegion *reg)
+{
+   int i, size;
+   DmtxRegion *region;
+
+   for(i = 0; i < dec->tileRegionCount; i++) {
+      if(RegionsCoincide(&(dec->tileRegion[i]), reg) == DmtxTrue)
+         return DmtxPass;
+   }
+
+   if(dec->tileRegionCount == dec->tileRegionSize) {
+      size = (dec->tileRegionSize == 0) ? DmtxTileRegionInit : dec->tileRegionSize * 2;
+      region = (DmtxRegion *)realloc(dec->tileRegion, size * sizeof(DmtxRegion));
+      if(region == NULL)
+         return DmtxFail;
+      dec->tileRegion = region;
+      dec->tileRegionSize = size;
+   }
+
+   dec->tileRegion[dec->tileRegionCount++] = *reg;
+   CacheFillRegion(dec, reg);
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Record that a tile window side was reached while testing a location
+ * \param  dec Tile decoder
+ * \param  x Location read outside the window or on its border
+ * \param  y
+ * \return void
+ */
+static void
+NoteWindowEdge(DmtxDecode *dec, int x, int y)
+{
+   int width, height;
+
+   width = dec->image->width / dec->scale;
+   height = dec->image->height / dec->scale;
+
+   if(x <= 0)
+      dec->windowEdgesHit |= DmtxEdgeLeft;
+   if(x >= width - 1)
+      dec->windowEdgesHit |= DmtxEdgeRight;
+   if(y <= 0)
+      dec->windowEdgesHit |= DmtxEdgeBottom;
+   if(y >= height - 1)
+      dec->windowEdgesHit |= DmtxEdgeTop;
+}
+
+/**
+ * \brief  Add the bounds of a trail that left the window to those of a tile
+ * \param  result
+ * \param  reg Candidate whose trail reached an inner window edge
+ * \return DmtxPass | DmtxFail
+ *
+ * A symbol reaches as far from its finder edge as the edge is long, so a
+ * trail along one edge only is widened to a square on both sides.
+ */
+static DmtxPassFail
+AppendTileOpenTrail(DmtxScanTileResult *result, DmtxRegion *reg)
+{
+   int size, grow;
+   DmtxPixelLoc boundMin, boundMax;
+   DmtxPixelLoc *openTrail;
+
+   boundMin = reg->boundMin;
+   boundMax = reg->boundMax;
+
+   grow = (boundMax.X - boundMin.X) - (boundMax.Y - boundMin.Y);
+   if(grow > 0) {
+      boundMin.Y -= grow;
+      boundMax.Y += grow;
+   }
+   else {
+      boundMin.X += grow;
+      boundMax.X -= grow;
+   }
+
+   if(result->openTrailCount + 2 > result->openTrailSize) {
+      size = (result->openTrailSize == 0) ? DmtxTileRegionInit : result->openTrailSize * 2;
+      openTrail = (DmtxPixelLoc *)realloc(result->openTrail, size * sizeof(DmtxPixelLoc));
+      if(openTrail == NULL)
+         return DmtxFail;
+      result->openTrail = openTrail;
+      result->openTrailSize = size;
+   }
+
+   result->openTrail[result->openTrailCount++] = boundMin;
+   result->openTrail[result->openTrailCount++] = boundMax;
+
+   return DmtxPass;
+}
+
+/**
+ * \brief  Test one location of a tile, passing it back if its symbol may leave the tile
+ * \param  dec Tile decoder
+ * \param  loc Location in window coordinates
+ * \param  fitted Set to DmtxTrue if an edge was strong enough to fit a region
+ * \return Detected region (if any)
+ *
+ * A location is passed back when testing it reached a window side that cuts
+ * through the image, or found a region close to one. Untested locations
+ * inside the bounds of a trail that already left the window are passed back
+ * too, since they most likely belong to the same symbol. Locations that
+ * cannot be recorded are dropped.
+ */
+static DmtxRegion *
+TileScanPixel(DmtxDecode *dec, DmtxPixelLoc loc, DmtxBoolean *fitted)
+{
+   int i;
+   unsigned char *cache;
+   DmtxScanTileResult *result;
+   DmtxRegion *reg;
+
+   result = dec->windowResult;
+   *fitted = DmtxFalse;
+
+   cache = dmtxDecodeGetCache(dec, loc.X, loc.Y);
+   if(cache == NULL || (int)(*cache & 0x80) != 0x00)
+      return NULL;
+
+   for(i = 0; i < result->openTrailCount; i += 2) {
+      if(loc.X >= result->openTrail[i].X && loc.X <= result->openTrail[i+1].X &&
+            loc.Y >= result->openTrail[i].Y && loc.Y <= result->openTrail[i+1].Y) {
+         AppendTileHandoff(result, loc);
+         return NULL;
+      }
+   }
+
+   dec->windowEdgesHit = 0;
+   reg = RegionScanPixel(dec, loc, fitted);
+
+   if((dec->windowEdgesHit & dec->windowEdges) != 0 ||
+         (reg != NULL && TileRegionIsInside(dec, reg) == DmtxFalse)) {
+      AppendTileHandoff(result, loc);
+      dmtxRegionDestroy(&reg);
+   }
+
+   return reg;
+}
+
+/**
+ * \brief  Locate the 4 corners of a fitted region
+ * \param  reg
+ * \param  corner Receives the corners at fitted (0,0), (1,0), (1,1) and (0,1)
+ * \return void
+ */
+static void
+GetRegionCorners(DmtxRegion *reg, DmtxVector2 corner[4])
+{
+   int i;
+
+   corner[0].X = corner[3].X = corner[0].Y = corner[1].Y = 0.0;
+   corner[1].X = corner[2].X = corner[2].Y = corner[3].Y = 1.0;
+
+   for(i = 0; i < 4; i++)
+      dmtxMatrix3VMultiplyBy(&corner[i], reg->fit2raw);
+}
+
+/**
+ * \brief  Approximate width of one module, measured along the bottom edge
+ * \param  corner Corners from GetRegionCorners()
+ * \param  reg
+ * \return Module size in scaled pixels
+ */
+static double
+GetRegionModuleSize(DmtxVector2 corner[4], DmtxRegion *reg)
+{
+   DmtxVector2 bottom;
+
+   dmtxVector2Sub(&bottom, &corner[1], &corner[0]);
+
+   return dmtxVector2Mag(&bottom) / reg->symbolCols;
+}
+
+/**
+ * \brief  Test whether a region stays clear of the inner edges of its window
+ * \param  dec Tile decoder
+ * \param  reg Region in window coordinates
+ * \return DmtxTrue | DmtxFalse
+ */
+static DmtxBoolean
+TileRegionIsInside(DmtxDecode *dec, DmtxRegion *reg)
+{
+   int i, width, height;
+   double margin;
+   DmtxVector2 corner[4];
+
+   width = dec->image->width / dec->scale;
+   height = dec->image->height / dec->scale;
+
+   GetRegionCorners(reg, corner);
+   margin = max(GetRegionModuleSize(corner, reg), 2.0);
+
+   for(i = 0; i < 4; i++) {
+      if((dec->windowEdges & DmtxEdgeLeft) && corner[i].X < margin)
+         return DmtxFalse;
+      if((dec->windowEdges & DmtxEdgeRight) && corner[i].X > width - 1 - margin)
+         return DmtxFalse;
+      if((dec->windowEdges & DmtxEdgeBottom) && corner[i].Y < margin)
+         return DmtxFalse;
+      if((dec->windowEdges & DmtxEdgeTop) && corner[i].Y > height - 1 - margin)
+         return DmtxFalse;
+   }
+
+   return DmtxTrue;
+}
+
+/**
+ * \brief  Move a region found in a tile into image coordinates
+ * \param  reg
+ * \param  dx Tile origin in scaled pixels
+ * \param  dy
+ * \return void
+ */
+static void
+TranslateRegion(DmtxRegion *reg, int dx, int dy)
+{
+   int i;
+   DmtxMatrix3 m, mOut;
+   DmtxPixelLoc *loc[] = {
+         &(reg->finalPos), &(reg->finalNeg), &(reg->boundMin), &(reg->boundMax),
+         &(reg->flowBegin.loc), &(reg->locR), &(reg->locT),
+         &(reg->leftLoc), &(reg->leftLine.locBeg), &(reg->leftLine.locPos),
+         &(reg->leftLine.locNeg), &(reg->bottomLoc), &(reg->bottomLine.locBeg),
+         &(reg->bottomLine.locPos), &(reg->bottomLine.locNeg), &(reg->topLoc),
+         &(reg->rightLoc) };
+
+   for(i = 0; i < (int)(sizeof(loc)/sizeof(loc[0])); i++) {
+      loc[i]->X += dx;
+      loc[i]->Y += dy;
+   }
+
+   dmtxMatrix3Translate(m, dx, dy);
+   dmtxMatrix3MultiplyBy(reg->fit2raw, m);
+
+   dmtxMatrix3Translate(m, -dx, -dy);
+   dmtxMatrix3Multiply(mOut, m, reg->raw2fit);
+   dmtxMatrix3Copy(reg->raw2fit, mOut);
+}
+
+/**
+ * \brief  Test whether two regions describe the same symbol
+ * \param  reg0
+ * \param  reg1
+ * \return DmtxTrue | DmtxFalse
+ *
+ * Matching corners must lie within one module (at least 2 pixels) of each
+ * other.
+ */
+static DmtxBoolean
+RegionsCoincide(DmtxRegion *reg0, DmtxRegion *reg1)
+{
+   int i;
+   double tolerance;
+   DmtxVector2 corner0[4], corner1[4], diff;
+
+   GetRegionCorners(reg0, corner0);
+   GetRegionCorners(reg1, corner1);
+
+   tolerance = max(GetRegionModuleSize(corner0, reg0), 2.0);
+
+   for(i = 0; i < 4; i++) {
+      if(dmtxVector2Mag(dmtxVector2Sub(&diff, &corner0[i], &corner1[i])) > tolerance)
+         return DmtxFalse;
+   }
+
+   return DmtxTrue;
+}
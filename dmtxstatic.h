@@ -20,6 +20,29 @@
 #define DmtxAlmostZero          0.000001
 #define DmtxAlmostInfinity            -1
 
+#define DmtxFlowTileSize              32
+#define DmtxFlowSlotsMin              64  /* Flow cache tiles allocated on first use */
+#define DmtxFlowSlotsMax            4096  /* Flow cache tiles kept at most (8 MB) */
+#define DmtxFlowBlank             0xffff
+#define DmtxTrailSizeInit           1024
+#define DmtxTileSizeDefault         1024
+#define DmtxTileStepMin               32
+#define DmtxTileRegionInit            16
+#define DmtxTileUnscanned              0
+#define DmtxTileStopped                1
+#define DmtxTileScanned                2
+#define DmtxDeadlineCheckInterval    256
+#define DmtxModuleBlockMax           146
+#define DmtxSizeCandidates             3
+#define DmtxSizeEstimateMax         2048
+#define DmtxCodewordsMax            2178
+#define DmtxPlacementMapMax        17424
+#define DmtxModuleUnsureMargin      0.25
+
+#define DMTX_HOUGH_RES               180
+#define DMTX_HOUGH_COARSE_STEP        10
+#define DMTX_HOUGH_COARSE_PEAKS        2
+
 #define DmtxValueC40Latch            230
 #define DmtxValueTextLatch           239
 #define DmtxValueX12Latch            238
@@ -89,6 +112,21 @@ typedef enum {
    DmtxMaskBit1              = 0x01 << 7
 } DmtxMaskBit;
 
+/**
+ * @struct DmtxSymbolLayout
+ * @brief DmtxSymbolLayout
+ */
+typedef struct DmtxSymbolLayout_struct {
+   int             mappingRows;
+   int             mappingCols;
+   int             symbolDataWords;
+   int             symbolErrorWords;
+   int             blockStride;          /* Number of interleaved blocks */
+   int             blockErrorWords;
+   int             blockMaxCorrectable;
+   const unsigned char *genLog;          /* Generator polynomial in log form */
+} DmtxSymbolLayout;
+
 /**
  * @struct DmtxFollow
  * @brief DmtxFollow
@@ -120,31 +158,213 @@ typedef struct DmtxBresLine_struct {
    DmtxPixelLoc    loc1;
 } DmtxBresLine;
 
+/**
+ * @struct DmtxHough
+ * @brief DmtxHough
+ */
+typedef struct DmtxHough_struct {
+   int             count;                   /* Number of angles being tested */
+   int             angle[DMTX_HOUGH_RES];   /* Tested angles in ascending order */
+   short           vXY[2*DMTX_HOUGH_RES];   /* rHvX and -rHvY pair of each tested angle */
+   int             hough[3][DMTX_HOUGH_RES];
+   int             angleBest;
+   int             hOffsetBest;
+   int             mag;                     /* Vote count of leading angle */
+} DmtxHough;
+
+/**
+ * @struct DmtxOptimizeChunk
+ * @brief DmtxOptimizeChunk
+ */
+typedef struct DmtxOptimizeChunk_struct {
+   int             prev;       /* Chunk encoded just before this one, or DmtxUndefined */
+   signed char     scheme;     /* Target scheme passed to EncodeNextChunk() */
+   signed char     option;     /* DmtxEncodeOption passed to EncodeNextChunk() */
+} DmtxOptimizeChunk;
+
+/**
+ * @struct DmtxOptimizeNode
+ * @brief DmtxOptimizeNode
+ */
+typedef struct DmtxOptimizeNode_struct {
+   DmtxEncodeStream stream;
+   DmtxByteList    output;     /* Header over shared scratch storage; only length is meaningful */
+   int             chunk;      /* Last committed chunk, or DmtxUndefined for an empty stream */
+   DmtxOptimizeChunk pending;  /* Chunk encoded since the last commit */
+   DmtxBoolean     hasPending;
+} DmtxOptimizeNode;
+
+/**
+ * @struct DmtxDecodeBatchJob
+ * @brief DmtxDecodeBatchJob
+ */
+typedef struct DmtxDecodeBatchJob_struct {
+   DmtxDecodeBatch *batch;
+   DmtxImage     **images;
+   DmtxDecodeResult *results;
+   int             count;
+   int             next;       /* Index of the next image to hand out */
+   struct DmtxDecodeBatchPool_struct *pool; /* Guards next when threads share the job, else NULL */
+} DmtxDecodeBatchJob;
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * @struct DmtxDecodeBatchPool
+ * @brief DmtxDecodeBatchPool
+ */
+typedef struct DmtxDecodeBatchPool_struct {
+   pthread_mutex_t mutex;      /* Guards the fields below and DmtxDecodeBatchJob.next */
+   pthread_cond_t  posted;     /* Signalled when a job is posted or threads should stop */
+   pthread_cond_t  finished;   /* Signalled when the last busy thread finishes a job */
+   int             generation; /* Incremented for every posted job */
+   int             threadCount; /* Threads running workers 1 through threadCount */
+   int             busyCount;  /* Threads still working on the posted job */
+   DmtxBoolean     stop;
+} DmtxDecodeBatchPool;
+#endif
+
+/**
+ * @struct DmtxDecodeWorker
+ * @brief DmtxDecodeWorker
+ */
+typedef struct DmtxDecodeWorker_struct {
+   DmtxDecode     *dec;        /* Reused while images fit its cache */
+   DmtxMessage     message;
+   unsigned char  *messageStorage; /* Sized for the largest symbol */
+   size_t          messageStorageSize;
+   DmtxDecodeBatchJob *job;
+#ifdef HAVE_PTHREAD_H
+   pthread_t       thread;
+   DmtxDecodeBatchPool *pool;
+   int             generation; /* Last posted job this thread has run */
+#endif
+} DmtxDecodeWorker;
+
+/**
+ * @struct DmtxScanTileResult
+ * @brief DmtxScanTileResult
+ */
+typedef struct DmtxScanTileResult_struct {
+   DmtxRegion     *region;     /* Regions found in one tile, in image coordinates */
+   int             count;
+   int             size;       /* Entries allocated in region */
+   DmtxPixelLoc   *handoff;    /* Locations passed back to the job decoder, in image coordinates */
+   int             handoffCount;
+   int             handoffSize; /* Entries allocated in handoff */
+   DmtxPixelLoc   *openTrail;  /* Bounds (min, max) of trails that left the window */
+   int             openTrailCount;
+   int             openTrailSize; /* Entries allocated in openTrail */
+} DmtxScanTileResult;
+
+/**
+ * @struct DmtxScanTileJob
+ * @brief DmtxScanTileJob
+ */
+typedef struct DmtxScanTileJob_struct {
+   DmtxDecode     *dec;        /* Read only while workers run, except tile state */
+   long long       deadline;   /* Nanoseconds, or DmtxUndefined */
+   long            budget;     /* Locations to test before starting no more tiles */
+   long            scanned;    /* Locations tested so far */
+   int             tileCols;
+   int             tileRows;
+   int             tileOverlap; /* Scaled distance windows reach past their tile and one pixel */
+   DmtxScanTileResult *result; /* One per tile, bottom row first */
+   int             workerCount;
+   int             next;       /* Index of the next tile to hand out */
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_t mutex;      /* Guards next and scanned */
+#endif
+} DmtxScanTileJob;
+
+/**
+ * @struct DmtxScanTileWorker
+ * @brief DmtxScanTileWorker
+ */
+typedef struct DmtxScanTileWorker_struct {
+   DmtxDecode     *dec;        /* Scans one tile at a time, kept by the job decoder between scans */
+   DmtxImage       view;       /* Tile window sharing pixels with the job image */
+   DmtxScanTileJob *job;
+#ifdef HAVE_PTHREAD_H
+   pthread_t       thread;
+#endif
+} DmtxScanTileWorker;
+
+/**
+ * @struct DmtxRegionDecodeJob
+ * @brief DmtxRegionDecodeJob
+ */
+typedef struct DmtxRegionDecodeJob_struct {
+   DmtxDecode     *dec;        /* Read only while workers run */
+   DmtxDecodeResult *results;
+   int             count;
+   long long       deadline;   /* Nanoseconds, or DmtxUndefined */
+   int             workerCount;
+   int             next;       /* Index of the next region to hand out */
+#ifdef HAVE_PTHREAD_H
+   pthread_mutex_t mutex;      /* Guards next */
+#endif
+} DmtxRegionDecodeJob;
+
+/**
+ * @struct DmtxRegionDecodeWorker
+ * @brief DmtxRegionDecodeWorker
+ */
+typedef struct DmtxRegionDecodeWorker_struct {
+   DmtxMessage     message;
+   unsigned char  *messageStorage; /* Sized for the largest symbol */
+   size_t          messageStorageSize;
+   unsigned short *placeMap;   /* Private, since the decoder's own map is not shared */
+   int             placeMapSizeIdx;
+   DmtxRegionDecodeJob *job;
+#ifdef HAVE_PTHREAD_H
+   pthread_t       thread;
+#endif
+} DmtxRegionDecodeWorker;
+
 typedef struct C40TextState_struct {
    int             shift;
    DmtxBoolean     upperShift;
 } C40TextState;
 
 /* dmtxregion.c */
+static DmtxRegion *GridRegionFindNext(DmtxDecode *dec, long long deadline, long budget,
+      long *scanned, DmtxScanStatus *status);
+static DmtxRegion *RegionScanPixel(DmtxDecode *dec, DmtxPixelLoc loc, DmtxBoolean *fitted);
 static double RightAngleTrueness(DmtxVector2 c0, DmtxVector2 c1, DmtxVector2 c2, double angle);
 static DmtxPointFlow MatrixRegionSeekEdge(DmtxDecode *dec, DmtxPixelLoc loc0);
 static DmtxPassFail MatrixRegionOrientation(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin);
 static long DistanceSquared(DmtxPixelLoc a, DmtxPixelLoc b);
-static int ReadModuleColor(DmtxDecode *dec, DmtxRegion *reg, int symbolRow, int symbolCol, int sizeIdx, int colorPlane);
+static void ReadModuleColorBlock(DmtxDecode *dec, DmtxRegion *reg, int symbolRow, int symbolCol,
+      int rows, int cols, int sizeIdx, int colorPlane, int *colors);
 
 static DmtxPassFail MatrixRegionFindSize(DmtxDecode *dec, DmtxRegion *reg);
+static int CountCalibrationJumps(DmtxDecode *dec, DmtxRegion *reg, DmtxDirection dir, double depth);
+static int MatrixRegionEstimateSizes(DmtxDecode *dec, DmtxRegion *reg, int sizeIdxBeg,
+      int sizeIdxEnd, int *sizeIdxList);
+static DmtxPassFail MatrixRegionTestSizes(DmtxDecode *dec, DmtxRegion *reg, int *sizeIdxList, int sizeIdxCount);
 static int CountJumpTally(DmtxDecode *dec, DmtxRegion *reg, int xStart, int yStart, DmtxDirection dir);
+static unsigned short *GetFlowTile(DmtxDecode *dec, int colorPlane, int tileX, int tileY);
+static void FillFlowTile(DmtxDecode *dec, int colorPlane, int tileX, int tileY, unsigned short *flow);
 static DmtxPointFlow GetPointFlow(DmtxDecode *dec, int colorPlane, DmtxPixelLoc loc, int arrive);
 static DmtxPointFlow FindStrongestNeighbor(DmtxDecode *dec, DmtxPointFlow center, int sign);
 static DmtxFollow FollowSeek(DmtxDecode *dec, DmtxRegion *reg, int seek);
 static DmtxFollow FollowSeekLoc(DmtxDecode *dec, DmtxPixelLoc loc);
 static DmtxFollow FollowStep(DmtxDecode *dec, DmtxRegion *reg, DmtxFollow followBeg, int sign);
 static DmtxFollow FollowStep2(DmtxDecode *dec, DmtxFollow followBeg, int sign);
+static DmtxPassFail TrailGrow(DmtxDecode *dec, int size);
 static DmtxPassFail TrailBlazeContinuous(DmtxDecode *dec, DmtxRegion *reg, DmtxPointFlow flowBegin, int maxDiagonal);
 static int TrailBlazeGapped(DmtxDecode *dec, DmtxRegion *reg, DmtxBresLine line, int streamDir);
 static int TrailClear(DmtxDecode *dec, DmtxRegion *reg, int clearMask);
 static DmtxBestLine FindBestSolidLine(DmtxDecode *dec, DmtxRegion *reg, int step0, int step1, int streamDir, int houghAvoid);
 static DmtxBestLine FindBestSolidLine2(DmtxDecode *dec, DmtxPixelLoc loc0, int tripSteps, int sign, int houghAvoid);
+static void HoughInit(DmtxHough *hough, int houghAvoid);
+static void HoughReset(DmtxHough *hough);
+static void HoughCoarse(DmtxHough *coarse, DmtxHough *full);
+static void HoughRefine(DmtxHough *full, DmtxHough *coarse);
+static void HoughVote(DmtxHough *hough, int xDiff, int yDiff);
+#if defined(__SSE2__)
+static void HoughVoteSSE2(DmtxHough *hough, int xDiff, int yDiff);
+#endif
 static DmtxPassFail FindTravelLimits(DmtxDecode *dec, DmtxRegion *reg, DmtxBestLine *line);
 static DmtxPassFail MatrixRegionAlignCalibEdge(DmtxDecode *dec, DmtxRegion *reg, int whichEdge);
 static DmtxBresLine BresLineInit(DmtxPixelLoc loc0, DmtxPixelLoc loc1, DmtxPixelLoc locInside);
@@ -153,8 +373,70 @@ static DmtxPassFail BresLineStep(DmtxBresLine *line, int travel, int outward);
 /*static void WriteDiagnosticImage(DmtxDecode *dec, DmtxRegion *reg, char *imagePath);*/
 
 /* dmtxdecode.c */
-static void TallyModuleJumps(DmtxDecode *dec, DmtxRegion *reg, int tally[][24], int xOrigin, int yOrigin, int mapWidth, int mapHeight, DmtxDirection dir);
+static void CacheMarkDirty(DmtxDecode *dec, DmtxPixelLoc locMin, DmtxPixelLoc locMax);
+static void CacheClearDirty(DmtxDecode *dec);
+static DmtxPassFail PrepareImage(DmtxDecode *dec);
+static void ClearFlowCache(DmtxDecode *dec);
+static void ReleasePreparedImage(DmtxDecode *dec);
+static DmtxPassFail PreparedGetPixelValue(DmtxDecode *dec, int x, int y, int channel, /*@out@*/ int *value);
+static void TallyModuleJumps(DmtxRegion *reg, int *colors, int tally[][24], int xOrigin, int yOrigin, int mapWidth, int mapHeight, DmtxDirection dir);
 static DmtxPassFail PopulateArrayFromMatrix(DmtxDecode *dec, DmtxRegion *reg, DmtxMessage *msg);
+static DmtxPassFail DecodeMatrixRegion(DmtxDecode *dec, DmtxRegion *reg, int fix, DmtxMessage *msg);
+static void CacheFillRegion(DmtxDecode *dec, DmtxRegion *reg);
+static DmtxPassFail DecodeRegionArray(DmtxDecode *dec, DmtxRegion *reg, int fix, DmtxMessage *msg,
+      unsigned short **placeMap, int *placeMapSizeIdx);
+static DmtxPassFail DecodePopulatedArray(int sizeIdx, DmtxMessage *msg, int fix, const unsigned short *map);
+
+/* dmtxdecodebatch.c */
+static int GetThreadCount(int threadCount, int jobCount);
+static void ReleaseBatchWorkers(DmtxDecodeBatch *batch);
+#ifdef HAVE_PTHREAD_H
+static int StartBatchThreads(DmtxDecodeBatch *batch, int threadCount);
+static void StopBatchThreads(DmtxDecodeBatch *batch);
+static void *DecodeBatchThread(void *arg);
+#endif
+static void DecodeBatchWorker(DmtxDecodeWorker *worker);
+static void DecodeBatchImage(DmtxDecodeWorker *worker, DmtxImage *img, DmtxDecodeResult *result);
+static void SetResultOutput(DmtxDecodeResult *result, DmtxMessage *msg);
+static DmtxPassFail PrepareBatchWorker(DmtxDecodeWorker *worker, DmtxImage *img);
+
+/* dmtxregiontile.c */
+static DmtxRegion *TileRegionFindNext(DmtxDecode *dec, long long deadline, long budget,
+      DmtxScanStatus *status);
+static DmtxPassFail ScanTiles(DmtxDecode *dec, long long deadline, long budget);
+static DmtxPassFail ScanPendingTiles(DmtxDecode *dec, DmtxScanTileJob *job, int tilesLeft);
+static DmtxPassFail RescanTileHandoffs(DmtxDecode *dec, long long deadline, long budget,
+      long *scanned);
+#ifdef HAVE_PTHREAD_H
+static void *ScanTileThread(void *arg);
+#endif
+static void ScanTileWorker(DmtxScanTileWorker *worker);
+static long ScanTile(DmtxScanTileWorker *worker, int tileIdx);
+static DmtxPassFail PrepareTileWorker(DmtxScanTileWorker *worker);
+static void ReleaseTileWorkers(DmtxDecode *dec);
+static DmtxPassFail AppendTileRegion(DmtxScanTileResult *result, DmtxRegion *reg);
+static DmtxPassFail AppendTileHandoff(DmtxScanTileResult *result, DmtxPixelLoc loc);
+static DmtxPassFail MergeTileRegion(DmtxDecode *dec, DmtxRegion *reg);
+static void NoteWindowEdge(DmtxDecode *dec, int x, int y);
+static DmtxPassFail AppendTileOpenTrail(DmtxScanTileResult *result, DmtxRegion *reg);
+static DmtxRegion *TileScanPixel(DmtxDecode *dec, DmtxPixelLoc loc, DmtxBoolean *fitted);
+static void GetRegionCorners(DmtxRegion *reg, DmtxVector2 corner[4]);
+static double GetRegionModuleSize(DmtxVector2 corner[4], DmtxRegion *reg);
+static DmtxBoolean TileRegionIsInside(DmtxDecode *dec, DmtxRegion *reg);
+static void TranslateRegion(DmtxRegion *reg, int dx, int dy);
+static DmtxBoolean RegionsCoincide(DmtxRegion *reg0, DmtxRegion *reg1);
+
+/* dmtxregionall.c */
+static DmtxPassFail DecodeFoundRegions(DmtxDecode *dec, DmtxDecodeResult *results, int count,
+      long long deadline);
+#ifdef HAVE_PTHREAD_H
+static void *RegionDecodeThread(void *arg);
+#endif
+static void RegionDecodeWorker(DmtxRegionDecodeWorker *worker);
+
+/* dmtxtime.c */
+static long long TimeToNsec(DmtxTime t);
+static DmtxBoolean DeadlineExceeded(long long deadline);
 
 /* dmtxdecodescheme.c */
 static DmtxPassFail DecodeDataStream(DmtxMessage *msg, int sizeIdx, unsigned char *outputStart);
@@ -170,26 +452,36 @@ static unsigned char *DecodeSchemeEdifact(DmtxMessage *msg, unsigned char *ptr,
 static unsigned char *DecodeSchemeBase256(DmtxMessage *msg, unsigned char *ptr, unsigned char *dataEnd);
 
 /* dmtxencode.c */
+static int EncodeMatrixSize(DmtxEncode *enc, DmtxByteList *input, DmtxByteList *output);
+static DmtxPassFail EncodeMatrixModules(DmtxEncode *enc, DmtxMessage *message, DmtxByteList *output);
 static void PrintPattern(DmtxEncode *encode);
+static void PrintPatternSpan(DmtxImage *img, unsigned char *line, int pixelRow, int pixelCol,
+      int pixelCount, int moduleStatus);
 static int EncodeDataCodewords(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest, DmtxScheme scheme, int fnc1);
 
 /* dmtxplacemod.c */
-static int ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, int sizeIdx, int moduleOnColor);
-static void PatternShapeStandard(unsigned char *modules, int mappingRows, int mappingCols, int row, int col, unsigned char *codeword, int moduleOnColor);
-static void PatternShapeSpecial1(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor);
-static void PatternShapeSpecial2(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor);
-static void PatternShapeSpecial3(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor);
-static void PatternShapeSpecial4(unsigned char *modules, int mappingRows, int mappingCols, unsigned char *codeword, int moduleOnColor);
-static void PlaceModule(unsigned char *modules, int mappingRows, int mappingCols, int row, int col,
-      unsigned char *codeword, int mask, int moduleOnColor);
+static int ModulePlacementEcc200(unsigned char *modules, unsigned char *codewords, unsigned char *unsure,
+      const unsigned short *map, int sizeIdx, int moduleOnColor);
+static const unsigned short *GetPlacementMap(unsigned short **map, int *mapSizeIdx, int sizeIdx);
+static const unsigned short *GetSharedPlacementMap(int sizeIdx);
+static DmtxPassFail BuildPlacementMap(unsigned short *map, int sizeIdx);
+static void PatternShapeStandard(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols, int row, int col);
+static void PatternShapeSpecial1(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols);
+static void PatternShapeSpecial2(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols);
+static void PatternShapeSpecial3(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols);
+static void PatternShapeSpecial4(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols);
+static void MapModule(unsigned short *map, unsigned char *visited, int mappingRows, int mappingCols, int row, int col, int mask);
+static void PlaceModule(unsigned char *modules, int moduleIdx, unsigned char *codeword, unsigned char *unsure, int mask, int moduleOnColor);
 
 /* dmtxreedsol.c */
 static DmtxPassFail RsEncode(DmtxMessage *message, int sizeIdx);
-static DmtxPassFail RsDecode(unsigned char *code, int sizeIdx, int fix);
-static DmtxPassFail RsGenPoly(DmtxByteList *gen, int errorWordCount);
+static DmtxPassFail RsDecode(unsigned char *code, const unsigned char *unsure, int sizeIdx, int fix);
 static DmtxBoolean RsComputeSyndromes(DmtxByteList *syn, const DmtxByteList *rec, int blockErrorWords);
 static DmtxBoolean RsFindErrorLocatorPoly(DmtxByteList *elp, const DmtxByteList *syn, int errorWordCount, int maxCorrectable);
-static DmtxBoolean RsFindErrorLocations(DmtxByteList *loc, const DmtxByteList *elp);
+static DmtxBoolean RsFindErrataLocatorPoly(DmtxByteList *elpOut, const DmtxByteList *syn, const DmtxByteList *era, int errorWordCount, int maxCorrectable);
+static DmtxBoolean RsFindErrataLocations(DmtxByteList *loc, DmtxByteList *elp, const DmtxByteList *syn,
+      const DmtxByte *recUnsure, int blockTotalWords, int blockErrorWords, int blockMaxCorrectable);
+static DmtxBoolean RsFindErrorLocations(DmtxByteList *loc, const DmtxByteList *elp, int blockTotalWords);
 static DmtxPassFail RsRepairErrors(DmtxByteList *rec, const DmtxByteList *loc, const DmtxByteList *elp, const DmtxByteList *syn);
 
 /* dmtxscangrid.c */
@@ -200,13 +492,14 @@ static void SetDerivedFields(DmtxScanGrid *grid);
 
 /* dmtxsymbol.c */
 static int FindSymbolSize(int dataWords, int sizeIdxRequest);
+static const DmtxSymbolLayout *GetSymbolLayout(int sizeIdx);
+static int GetBlockDataWords(const DmtxSymbolLayout *layout, int blockIdx);
 
 /* dmtximage.c */
 static int GetBitsPerPixel(int pack);
 
 /* dmtxencodestream.c */
 static DmtxEncodeStream StreamInit(DmtxByteList *input, DmtxByteList *output);
-static void StreamCopy(DmtxEncodeStream *dst, DmtxEncodeStream *src);
 static void StreamMarkComplete(DmtxEncodeStream *stream, int sizeIdx);
 static void StreamMarkInvalid(DmtxEncodeStream *stream, int reasonIdx);
 static void StreamMarkFatal(DmtxEncodeStream *stream, int reasonIdx);
@@ -226,17 +519,31 @@ static int GetRemainingSymbolCapacity(int outputLength, int sizeIdx);
 
 /* dmtxencodeoptimize.c */
 static int EncodeOptimizeBest(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest, int fnc1);
-static void StreamAdvanceFromBest(DmtxEncodeStream *streamNext,
-      DmtxEncodeStream *streamList, int targeteState, int sizeIdxRequest);
-static void AdvanceAsciiCompact(DmtxEncodeStream *streamNext, DmtxEncodeStream *streamList,
+static int ReplayChunks(DmtxByteList *input, DmtxByteList *output, DmtxOptimizeChunk *chunks,
+      int lastChunk, int sizeIdxRequest, int fnc1);
+static void NodeInit(DmtxOptimizeNode *node, DmtxByteList *input, DmtxByte *scratch, int capacity, int fnc1);
+static void NodeCopy(DmtxOptimizeNode *dst, DmtxOptimizeNode *src);
+static void NodeEncodeNextChunk(DmtxOptimizeNode *node, int scheme, int option, int sizeIdxRequest);
+static void StreamAdvanceFromBest(DmtxOptimizeNode *nodesNext,
+      DmtxOptimizeNode *nodesBest, int targetState, int sizeIdxRequest);
+static void AdvanceAsciiCompact(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int state, int inputNext, int sizeIdxRequest);
-static void AdvanceCTX(DmtxEncodeStream *streamNext, DmtxEncodeStream *streamList,
+static void AdvanceCTX(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int state, int inputNext, int ctxValueCount, int sizeIdxRequest);
-static void AdvanceEdifact(DmtxEncodeStream *streamNext, DmtxEncodeStream *streamList,
+static void AdvanceEdifact(DmtxOptimizeNode *nodesNext, DmtxOptimizeNode *nodesBest,
       int state, int inputNext, int sizeIdxRequest);
 static int GetScheme(int state);
 static DmtxBoolean ValidStateSwitch(int fromState, int targetState);
 
+/* dmtxencodelookahead.c */
+static int EncodeAutoFast(DmtxByteList *input, DmtxByteList *output, int sizeIdxRequest, int fnc1);
+static DmtxScheme LookAheadNextScheme(DmtxEncodeStream *stream);
+static DmtxScheme LookAheadTest(DmtxEncodeStream *stream, DmtxScheme currentScheme);
+static int LookAheadCTXCost(DmtxEncodeStream *stream, DmtxByte value, DmtxScheme scheme);
+static DmtxBoolean LookAheadIsLeast(const int *count, DmtxScheme scheme, int margin, DmtxBoolean allowTie);
+static DmtxBoolean LookAheadChunkFits(DmtxEncodeStream *stream, DmtxScheme scheme);
+static DmtxBoolean LookAheadIsFnc1(DmtxEncodeStream *stream, DmtxByte value);
+
 /* dmtxencodeascii.c */
 static void EncodeNextChunkAscii(DmtxEncodeStream *stream, int option);
 static void AppendValueAscii(DmtxEncodeStream *stream, DmtxByte value);
@@ -267,6 +574,7 @@ static void EncodeNextChunkBase256(DmtxEncodeStream *stream);
 static void AppendValueBase256(DmtxEncodeStream *stream, DmtxByte value);
 static void CompleteIfDoneBase256(DmtxEncodeStream *stream, int sizeIdxRequest);
 static void UpdateBase256ChainHeader(DmtxEncodeStream *stream, int perfectSizeIdx);
+static void CloseBase256Chain(DmtxEncodeStream *stream, int perfectSizeIdx);
 static void Base256OutputChainInsertFirst(DmtxEncodeStream *stream);
 static void Base256OutputChainRemoveFirst(DmtxEncodeStream *stream);
 static DmtxByte Randomize255State(DmtxByte cwValue, int cwPosition);
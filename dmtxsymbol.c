@@ -16,6 +16,112 @@
  */
 
 
+/* Reed-Solomon generator polynomials for each block error word count, as
+   log301 of each coefficient with the lowest order term first */
+static const unsigned char genLog5[] =
+   {  15, 244, 210, 207, 235 };
+
+static const unsigned char genLog7[] =
+   {  28, 197,  42, 218, 214,  30, 177 };
+
+static const unsigned char genLog10[] =
+   {  55, 243,  83, 172, 131, 237, 120, 150,  50, 199 };
+
+static const unsigned char genLog11[] =
+   {  66,  12, 215, 242, 174, 109, 103, 156, 212, 173, 213 };
+
+static const unsigned char genLog12[] =
+   {  78, 233, 194,  74, 199, 107, 185,  94, 173,  35, 142, 168 };
+
+static const unsigned char genLog14[] =
+   { 105, 173, 246,  93,  84,  38,  27, 248,  12,   8,  39,  33, 171,  83 };
+
+static const unsigned char genLog18[] =
+   { 171,  61, 142, 103, 164, 253, 220, 199, 250,  94, 231, 161, 163, 177,  69, 244,
+       9, 164 };
+
+static const unsigned char genLog20[] =
+   { 210,  61, 201,  38, 149, 184, 109,   1, 164, 230, 233, 209, 122, 193,  25,  79,
+      23, 146,  33, 127 };
+
+static const unsigned char genLog24[] =
+   {  45,  85, 136, 215, 231, 103, 137, 106,  22, 202,  20, 131,  22, 106, 225, 127,
+     177, 236, 242, 183,  31, 245, 141,  65 };
+
+static const unsigned char genLog28[] =
+   { 151,  17, 125, 173, 184, 245, 190, 146, 222, 239, 166,  99, 253, 196, 130, 167,
+     195,  12,  50,  94,  48, 198, 213, 239, 149, 109,  32, 150 };
+
+static const unsigned char genLog36[] =
+   { 156, 176, 168, 232,  77, 111,  87, 183, 181, 213, 108, 252,  51,  20, 229,  75,
+      16,  39,   1,   2, 197, 219,  81,  90,  84, 248,  67, 135,  66,  31, 153, 140,
+      69, 187,  86,  57 };
+
+static const unsigned char genLog42[] =
+   { 138,  65,  90, 234, 114, 115, 134, 233,  60,  88, 200,   1, 156, 102, 168,   3,
+      66,  84, 142,  38, 203,  88, 160, 207,  13, 167, 106,   0, 122,  13,  24,  81,
+     237,  82,  11, 141, 254, 192, 148, 225,  38, 225 };
+
+static const unsigned char genLog48[] =
+   { 156, 221, 127, 131, 245,   5, 128, 134, 249, 102, 249,  17, 215, 164,  59, 145,
+     170, 100,   4, 132, 154,  28, 222,   9, 166, 215, 124, 136, 213, 142, 220,  12,
+      33, 214,  79, 135, 137, 145,  73, 132, 230,  66,  11,  94,  30, 122,  69, 114 };
+
+static const unsigned char genLog56[] =
+   {  66,  38, 131, 249, 242, 195,  51,  47, 142, 118,  66, 166,  68, 246, 123,  19,
+     254, 113,  40, 131, 115, 143, 221,  24,  15,  37, 232, 129, 128,  72, 118, 121,
+      42, 249, 134, 254, 169, 128, 235, 251,  80,  43,  90, 156, 176, 217,  60,  55,
+      22, 125,  72, 159, 149,  99, 179,  29 };
+
+static const unsigned char genLog62[] =
+   { 168,  32, 175, 141,  42,  89, 103, 154,  82, 164, 169, 144, 179,  25, 188, 222,
+      83,  57, 218,  68, 156,  91, 202,  85, 111, 100,  83, 238,  66,   6,  14, 184,
+     206, 135, 132, 241,  23, 232, 180,  91, 145, 226, 228,  77, 164, 195, 158, 234,
+     137, 166,   2, 159, 121,  53, 163, 172,  58, 236, 126, 162, 133, 182 };
+
+static const unsigned char genLog68[] =
+   {  51,  15, 247,  34,  20,  52, 113,  56,  34, 219, 132, 201, 139,  40,  36, 176,
+      94, 198, 237,  10, 129, 202, 194, 192, 197, 200,  32,  94, 210, 230,  18, 155,
+     220, 152, 233,  83,  82, 203, 252, 140,  51, 121, 245,  89,  17, 198, 131,  70,
+     183, 250, 153,  45, 127, 140, 186, 121, 151, 144,   6,  24,  25, 233, 221,  91,
+     245, 190,  79,  33 };
+
+/* Mapping and Reed-Solomon layout of each symbol size, indexed by sizeIdx */
+static const DmtxSymbolLayout symbolLayout[] = {
+   /* mapping    symbol      block
+      rows cols  data error  stride error maxCorrectable generator */
+      {   8,   8,    3,   5,  1,  5,  2, genLog5  }, /* 10x10 */
+      {  10,  10,    5,   7,  1,  7,  3, genLog7  }, /* 12x12 */
+      {  12,  12,    8,  10,  1, 10,  5, genLog10 }, /* 14x14 */
+      {  14,  14,   12,  12,  1, 12,  6, genLog12 }, /* 16x16 */
+      {  16,  16,   18,  14,  1, 14,  7, genLog14 }, /* 18x18 */
+      {  18,  18,   22,  18,  1, 18,  9, genLog18 }, /* 20x20 */
+      {  20,  20,   30,  20,  1, 20, 10, genLog20 }, /* 22x22 */
+      {  22,  22,   36,  24,  1, 24, 12, genLog24 }, /* 24x24 */
+      {  24,  24,   44,  28,  1, 28, 14, genLog28 }, /* 26x26 */
+      {  28,  28,   62,  36,  1, 36, 18, genLog36 }, /* 32x32 */
+      {  32,  32,   86,  42,  1, 42, 21, genLog42 }, /* 36x36 */
+      {  36,  36,  114,  48,  1, 48, 24, genLog48 }, /* 40x40 */
+      {  40,  40,  144,  56,  1, 56, 28, genLog56 }, /* 44x44 */
+      {  44,  44,  174,  68,  1, 68, 34, genLog68 }, /* 48x48 */
+      {  48,  48,  204,  84,  2, 42, 21, genLog42 }, /* 52x52 */
+      {  56,  56,  280, 112,  2, 56, 28, genLog56 }, /* 64x64 */
+      {  64,  64,  368, 144,  4, 36, 18, genLog36 }, /* 72x72 */
+      {  72,  72,  456, 192,  4, 48, 24, genLog48 }, /* 80x80 */
+      {  80,  80,  576, 224,  4, 56, 28, genLog56 }, /* 88x88 */
+      {  88,  88,  696, 272,  4, 68, 34, genLog68 }, /* 96x96 */
+      {  96,  96,  816, 336,  6, 56, 28, genLog56 }, /* 104x104 */
+      { 108, 108, 1050, 408,  6, 68, 34, genLog68 }, /* 120x120 */
+      { 120, 120, 1304, 496,  8, 62, 31, genLog62 }, /* 132x132 */
+      { 132, 132, 1558, 620, 10, 62, 31, genLog62 }, /* 144x144 */
+      {   6,  16,    5,   7,  1,  7,  3, genLog7  }, /* 8x18 */
+      {   6,  28,   10,  11,  1, 11,  5, genLog11 }, /* 8x32 */
+      {  10,  24,   16,  14,  1, 14,  7, genLog14 }, /* 12x26 */
+      {  10,  32,   22,  18,  1, 18,  9, genLog18 }, /* 12x36 */
+      {  14,  32,   32,  24,  1, 24, 12, genLog24 }, /* 16x36 */
+      {  14,  44,   49,  28,  1, 28, 14, genLog28 }  /* 16x48 */
+};
+
 /**
  * \brief  Retrieve symbol index from rows and columns
  * \param  rows
@@ -147,19 +253,47 @@ dmtxGetSymbolAttribute(int attribute, int sizeIdx)
 extern int
 dmtxGetBlockDataSize(int sizeIdx, int blockIdx)
 {
-   int symbolDataWords;
-   int interleavedBlocks;
-   int count;
-
-   symbolDataWords = dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx);
-   interleavedBlocks = dmtxGetSymbolAttribute(DmtxSymAttribInterleavedBlocks, sizeIdx);
+   const DmtxSymbolLayout *layout;
 
-   if(symbolDataWords < 1 || interleavedBlocks < 1)
+   layout = GetSymbolLayout(sizeIdx);
+   if(layout == NULL)
       return DmtxUndefined;
 
-   count = (int)(symbolDataWords/interleavedBlocks);
+   return GetBlockDataWords(layout, blockIdx);
+}
+
+/**
+ * \brief  Look up precomputed layout for a symbol size
+ * \param  sizeIdx
+ * \return Symbol layout, or NULL if sizeIdx is invalid
+ */
+static const DmtxSymbolLayout *
+GetSymbolLayout(int sizeIdx)
+{
+   if(sizeIdx < 0 || sizeIdx >= DmtxSymbolSquareCount + DmtxSymbolRectCount)
+      return NULL;
+
+   return &symbolLayout[sizeIdx];
+}
+
+/**
+ * \brief  Data word count of one interleaved block
+ * \param  layout
+ * \param  blockIdx
+ * \return Data words in block
+ *
+ * Only 144x144 has data words left over after an even split, and those go
+ * to its first blocks.
+ */
+static int
+GetBlockDataWords(const DmtxSymbolLayout *layout, int blockIdx)
+{
+   int count, extra;
+
+   count = layout->symbolDataWords / layout->blockStride;
+   extra = layout->symbolDataWords % layout->blockStride;
 
-   return (sizeIdx == DmtxSymbol144x144 && blockIdx < 8) ? count + 1 : count;
+   return (blockIdx < extra) ? count + 1 : count;
 }
 
 /**
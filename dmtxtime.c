@@ -15,6 +15,8 @@
  */
 
 #define DMTX_USEC_PER_SEC 1000000
+#define DMTX_NSEC_PER_USEC 1000
+#define DMTX_NSEC_PER_SEC 1000000000LL
 
 #if defined(HAVE_SYS_TIME_H) && defined(HAVE_GETTIMEOFDAY)
 
@@ -99,6 +101,62 @@ dmtxTimeNow(void)
 
 #endif
 
+/* Deadlines inside the library use a monotonic clock where one exists */
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+
+/**
+ * \brief  CLOCK_GETTIME (monotonic) version
+ * \return Nanoseconds since an arbitrary fixed point
+ */
+extern long long
+dmtxTimeNowNsec(void)
+{
+   struct timespec ts;
+
+   if(clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+      return 0; /* XXX handle error better here */
+
+   return (long long)ts.tv_sec * DMTX_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+#elif defined(_MSC_VER)
+
+/**
+ * \brief  MICROSOFT VC++ (performance counter) version
+ * \return Nanoseconds since an arbitrary fixed point
+ */
+extern long long
+dmtxTimeNowNsec(void)
+{
+   LARGE_INTEGER freq, count;
+
+   if(QueryPerformanceFrequency(&freq) == 0 || QueryPerformanceCounter(&count) == 0)
+      return 0; /* XXX handle error better here */
+
+   /* Split before scaling so the counter cannot overflow */
+   return (count.QuadPart / freq.QuadPart) * DMTX_NSEC_PER_SEC +
+         (count.QuadPart % freq.QuadPart) * DMTX_NSEC_PER_SEC / freq.QuadPart;
+}
+
+#else
+
+/**
+ * \brief  Wall clock version
+ * \return Nanoseconds since the epoch
+ */
+extern long long
+dmtxTimeNowNsec(void)
+{
+   DmtxTime tNow;
+
+   tNow = dmtxTimeNow();
+
+   return (long long)tNow.sec * DMTX_NSEC_PER_SEC + (long long)tNow.usec * DMTX_NSEC_PER_USEC;
+}
+
+#endif
+
 /**
  * \brief  Add milliseconds to time t
  * \param  t
@@ -144,5 +202,43 @@ dmtxTimeExceeded(DmtxTime timeout)
    return (now.sec > timeout.sec || (now.sec == timeout.sec && now.usec > timeout.usec));
 }
 
+/**
+ * \brief  Convert wall clock time t to nanoseconds on the dmtxTimeNowNsec() clock
+ * \param  t
+ * \return Nanoseconds
+ *
+ * DmtxTime keeps its wall clock meaning, so a timeout built from
+ * dmtxTimeNow() or gettimeofday() is turned into a deadline by measuring how
+ * far away it is now and adding that to the monotonic clock.
+ */
+static long long
+TimeToNsec(DmtxTime t)
+{
+   long long nsec;
+   DmtxTime tNow;
+
+   tNow = dmtxTimeNow();
+   nsec = dmtxTimeNowNsec();
+
+   return nsec + ((long long)t.sec - (long long)tNow.sec) * DMTX_NSEC_PER_SEC +
+         ((long long)t.usec - (long long)tNow.usec) * DMTX_NSEC_PER_USEC;
+}
+
+/**
+ * \brief  Determine whether a nanosecond deadline has passed
+ * \param  deadline Deadline from dmtxTimeNowNsec(), or DmtxUndefined if none
+ * \return DmtxTrue | DmtxFalse
+ */
+static DmtxBoolean
+DeadlineExceeded(long long deadline)
+{
+   if(deadline == DmtxUndefined)
+      return DmtxFalse;
+
+   return (dmtxTimeNowNsec() > deadline) ? DmtxTrue : DmtxFalse;
+}
+
 #undef DMTX_TIME_PREC_USEC
 #undef DMTX_USEC_PER_SEC
+#undef DMTX_NSEC_PER_USEC
+#undef DMTX_NSEC_PER_SEC
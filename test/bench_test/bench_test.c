@@ -0,0 +1,1012 @@
+/**
+ * libdmtx - Data Matrix Encoding/Decoding Library
+ *
+ * See LICENSE file in the main project directory for full
+ * terms of use and distribution.
+ *
+ * \file bench_test.c
+ * \brief Microbenchmarks for internal decoder and encoder routines
+ *
+ * Includes the library source directly so static routines can be timed in
+ * isolation. Each benchmark also checks its result against a reference
+ * implementation and exits with an error if they differ.
+ */
+
+#include "../../dmtx.c"
+#include <time.h>
+
+#define BENCH_TRAILS 2000
+#define BENCH_ROUNDS   20
+#define BENCH_BLOCKS 2000
+#define BENCH_MESSAGES 200
+#define BENCH_MESSAGE_MAX 120
+#define BENCH_PAYLOADS 200
+#define BENCH_PAYLOAD_MAX 1550
+#define BENCH_RENDERS 20
+#define BENCH_IMAGES 200
+#define BENCH_PALLET_COLS 6
+#define BENCH_PALLET_ROWS 5
+#define BENCH_PALLET_CELL 400
+#define BENCH_NOISE_SIZE 1200
+#define BENCH_DEADLINE_MSEC 20
+
+typedef struct BenchTrail_struct {
+   int             houghAvoid;
+   int             steps;
+   DmtxPixelLoc    loc[512];
+} BenchTrail;
+
+typedef struct BenchEntry_struct {
+   const char     *name;
+   void          (*run)(void);
+} BenchEntry;
+
+static unsigned int benchSeed = 1;
+
+static int
+BenchRand(int range)
+{
+   benchSeed = benchSeed * 1103515245 + 12345;
+   return (int)((benchSeed >> 16) % (unsigned int)range);
+}
+
+static void
+BenchFail(const char *name)
+{
+   fprintf(stderr, "%s: result differs from reference\n", name);
+   exit(1);
+}
+
+/**
+ * \brief  Reference Hough accumulator (original per-angle scalar loop)
+ */
+static DmtxBestLine
+HoughReference(BenchTrail *trail)
+{
+   int hough[3][DMTX_HOUGH_RES] = { { 0 } };
+   int houghMin, houghMax;
+   char houghTest[DMTX_HOUGH_RES];
+   int i, step;
+   int angleBest;
+   int hOffset, hOffsetBest;
+   int xDiff, yDiff;
+   int dH;
+   DmtxBestLine line;
+
+   memset(&line, 0x00, sizeof(DmtxBestLine));
+   angleBest = 0;
+   hOffset = hOffsetBest = 0;
+
+   for(i = 0; i < DMTX_HOUGH_RES; i++) {
+      if(trail->houghAvoid == DmtxUndefined) {
+         houghTest[i] = 1;
+      }
+      else {
+         houghMin = (trail->houghAvoid + DMTX_HOUGH_RES/6) % DMTX_HOUGH_RES;
+         houghMax = (trail->houghAvoid - DMTX_HOUGH_RES/6 + DMTX_HOUGH_RES) % DMTX_HOUGH_RES;
+         if(houghMin > houghMax)
+            houghTest[i] = (i > houghMin || i < houghMax) ? 1 : 0;
+         else
+            houghTest[i] = (i > houghMin && i < houghMax) ? 1 : 0;
+      }
+   }
+
+   for(step = 0; step < trail->steps; step++) {
+      xDiff = trail->loc[step].X - trail->loc[0].X;
+      yDiff = trail->loc[step].Y - trail->loc[0].Y;
+
+      for(i = 0; i < DMTX_HOUGH_RES; i++) {
+         if((int)houghTest[i] == 0)
+            continue;
+
+         dH = (rHvX[i] * yDiff) - (rHvY[i] * xDiff);
+         if(dH >= -384 && dH <= 384) {
+            if(dH > 128)
+               hOffset = 2;
+            else if(dH >= -128)
+               hOffset = 1;
+            else
+               hOffset = 0;
+
+            hough[hOffset][i]++;
+
+            if(hough[hOffset][i] > hough[hOffsetBest][angleBest]) {
+               angleBest = i;
+               hOffsetBest = hOffset;
+            }
+         }
+      }
+   }
+
+   line.angle = angleBest;
+   line.hOffset = hOffsetBest;
+   line.mag = hough[hOffsetBest][angleBest];
+
+   return line;
+}
+
+/**
+ * \brief  Hough accumulator as used by FindBestSolidLine()
+ */
+static DmtxBestLine
+HoughLibrary(BenchTrail *trail)
+{
+   int step;
+   DmtxHough hough;
+   DmtxBestLine line;
+
+   memset(&line, 0x00, sizeof(DmtxBestLine));
+
+   HoughInit(&hough, trail->houghAvoid);
+
+   for(step = 0; step < trail->steps; step++)
+      HoughVote(&hough, trail->loc[step].X - trail->loc[0].X,
+            trail->loc[step].Y - trail->loc[0].Y);
+
+   line.angle = hough.angleBest;
+   line.hOffset = hough.hOffsetBest;
+   line.mag = hough.mag;
+
+   return line;
+}
+
+/**
+ * \brief  Build wobbly straight trails similar to those left by TrailBlazeContinuous()
+ */
+static void
+BuildTrails(BenchTrail *trails, int count)
+{
+   int i, step;
+   double angle, x, y;
+
+   for(i = 0; i < count; i++) {
+      trails[i].houghAvoid = (BenchRand(3) == 0) ? DmtxUndefined : BenchRand(DMTX_HOUGH_RES);
+      trails[i].steps = 20 + BenchRand(492);
+      angle = BenchRand(3600) * M_PI / 1800.0;
+      x = 1000.0;
+      y = 1000.0;
+      for(step = 0; step < trails[i].steps; step++) {
+         trails[i].loc[step].X = (int)(x + 0.5) + BenchRand(3) - 1;
+         trails[i].loc[step].Y = (int)(y + 0.5) + BenchRand(3) - 1;
+         x += cos(angle);
+         y += sin(angle);
+      }
+   }
+}
+
+static void
+BenchHough(void)
+{
+   int i, round;
+   long checksum;
+   clock_t t0, t1, t2;
+   BenchTrail *trails;
+   DmtxBestLine a, b;
+
+   trails = (BenchTrail *)malloc(BENCH_TRAILS * sizeof(BenchTrail));
+   if(trails == NULL)
+      exit(2);
+
+   BuildTrails(trails, BENCH_TRAILS);
+
+   for(i = 0; i < BENCH_TRAILS; i++) {
+      a = HoughReference(trails + i);
+      b = HoughLibrary(trails + i);
+      if(a.angle != b.angle || a.hOffset != b.hOffset || a.mag != b.mag)
+         BenchFail("hough");
+   }
+
+   checksum = 0;
+   t0 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_TRAILS; i++)
+         checksum += HoughReference(trails + i).mag;
+   t1 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_TRAILS; i++)
+         checksum -= HoughLibrary(trails + i).mag;
+   t2 = clock();
+
+   if(checksum != 0)
+      BenchFail("hough");
+
+   fprintf(stdout, "hough: reference %.3f s, library %.3f s (%d trails x %d rounds)\n",
+         (double)(t1 - t0) / CLOCKS_PER_SEC, (double)(t2 - t1) / CLOCKS_PER_SEC,
+         BENCH_TRAILS, BENCH_ROUNDS);
+
+   free(trails);
+}
+
+/**
+ * \brief  Reference syndromes (original modulo-per-term evaluation)
+ */
+static DmtxBoolean
+SyndromesReference(DmtxByteList *syn, const DmtxByteList *rec, int blockErrorWords)
+{
+   int i, j;
+   DmtxBoolean error = DmtxFalse;
+
+   syn->length = blockErrorWords + 1;
+   memset(syn->b, 0x00, syn->length);
+
+   for(i = 1; i < syn->length; i++) {
+      for(j = 0; j < rec->length; j++)
+         if(rec->b[j] != 0)
+            syn->b[i] ^= antilog301[(log301[rec->b[j]] + i*j) % NN];
+
+      if(syn->b[i] != 0)
+         error = DmtxTrue;
+   }
+
+   return error;
+}
+
+static void
+BenchSyndromes(void)
+{
+   int i, j, round, sizeIdx;
+   int blockErrorWords, blockTotalWords;
+   long checksum;
+   clock_t t0, t1, t2;
+   DmtxByte *recStorage;
+   DmtxByte synStorage[MAX_ERROR_WORD_COUNT + 1], refStorage[MAX_ERROR_WORD_COUNT + 1];
+   DmtxByteList *rec, syn, ref;
+
+   rec = (DmtxByteList *)malloc(BENCH_BLOCKS * sizeof(DmtxByteList));
+   recStorage = (DmtxByte *)malloc(BENCH_BLOCKS * NN);
+   if(rec == NULL || recStorage == NULL)
+      exit(2);
+
+   /* Blocks of real symbol sizes, some clean and some with a few bad words */
+   for(i = 0; i < BENCH_BLOCKS; i++) {
+      sizeIdx = BenchRand(DmtxSymbolSquareCount + DmtxSymbolRectCount);
+      blockErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribBlockErrorWords, sizeIdx);
+      blockTotalWords = blockErrorWords +
+            dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx) /
+            dmtxGetSymbolAttribute(DmtxSymAttribInterleavedBlocks, sizeIdx);
+      rec[i] = dmtxByteListBuild(recStorage + i * NN, NN);
+      rec[i].length = blockTotalWords;
+      for(j = 0; j < blockTotalWords; j++)
+         rec[i].b[j] = (DmtxByte)BenchRand(256);
+      if(BenchRand(4) == 0)
+         rec[i].b[BenchRand(blockTotalWords)] = 0;
+   }
+
+   syn = dmtxByteListBuild(synStorage, sizeof(synStorage));
+   ref = dmtxByteListBuild(refStorage, sizeof(refStorage));
+
+   for(i = 0; i < BENCH_BLOCKS; i++) {
+      for(j = 0; j <= MAX_ERROR_WORD_COUNT && j + 1 < rec[i].length; j += 7) {
+         if(SyndromesReference(&ref, rec + i, j) != RsComputeSyndromes(&syn, rec + i, j) ||
+               memcmp(ref.b, syn.b, ref.length) != 0)
+            BenchFail("syndromes");
+      }
+   }
+
+   checksum = 0;
+   t0 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_BLOCKS; i++) {
+         blockErrorWords = min(rec[i].length / 2, MAX_ERROR_WORD_COUNT);
+         SyndromesReference(&ref, rec + i, blockErrorWords);
+         checksum += ref.b[blockErrorWords];
+      }
+   t1 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_BLOCKS; i++) {
+         blockErrorWords = min(rec[i].length / 2, MAX_ERROR_WORD_COUNT);
+         RsComputeSyndromes(&syn, rec + i, blockErrorWords);
+         checksum -= syn.b[blockErrorWords];
+      }
+   t2 = clock();
+
+   if(checksum != 0)
+      BenchFail("syndromes");
+
+   fprintf(stdout, "syndromes: reference %.3f s, library %.3f s (%d blocks x %d rounds)\n",
+         (double)(t1 - t0) / CLOCKS_PER_SEC, (double)(t2 - t1) / CLOCKS_PER_SEC,
+         BENCH_BLOCKS, BENCH_ROUNDS);
+
+   free(recStorage);
+   free(rec);
+}
+
+/**
+ * \brief  Reference Chien search (original search over all NN positions)
+ */
+static DmtxBoolean
+ChienReference(DmtxByteList *loc, const DmtxByteList *elp, int blockTotalWords)
+{
+   int i, j;
+   int lambda = elp->length - 1;
+   DmtxByte q, reg[MAX_ERROR_WORD_COUNT];
+
+   memcpy(reg, elp->b, elp->length);
+   loc->length = 0;
+
+   for(i = 1; i <= NN; i++) {
+      for(q = 1, j = 1; j <= lambda; j++) {
+         if(reg[j] != 0)
+            reg[j] = antilog301[(log301[reg[j]] + j) % NN];
+         q ^= reg[j];
+      }
+      if(q == 0)
+         loc->b[loc->length++] = NN - i;
+   }
+
+   /* Roots outside the block are not repairable either */
+   for(i = 0; i < loc->length; i++)
+      if(loc->b[i] >= blockTotalWords)
+         return DmtxFalse;
+
+   return (loc->length == lambda) ? DmtxTrue : DmtxFalse;
+}
+
+/**
+ * \brief  Build error locator polynomials for random error positions
+ */
+static void
+BuildLocators(DmtxByteList *elp, int *blockTotalWords, int count)
+{
+   int i, j, k, sizeIdx, errors, pos, used;
+   int blockErrorWords, chosen[MAX_ERROR_WORD_COUNT];
+   DmtxByte xk;
+
+   for(i = 0; i < count; i++) {
+      sizeIdx = BenchRand(DmtxSymbolSquareCount + DmtxSymbolRectCount);
+      blockErrorWords = dmtxGetSymbolAttribute(DmtxSymAttribBlockErrorWords, sizeIdx);
+      blockTotalWords[i] = blockErrorWords +
+            dmtxGetSymbolAttribute(DmtxSymAttribSymbolDataWords, sizeIdx) /
+            dmtxGetSymbolAttribute(DmtxSymAttribInterleavedBlocks, sizeIdx);
+      errors = 1 + BenchRand(dmtxGetSymbolAttribute(DmtxSymAttribBlockMaxCorrectable, sizeIdx));
+
+      /* Product of (1 + X_k*x), with the occasional bogus position */
+      elp[i].length = 1;
+      elp[i].b[0] = 1;
+      for(k = 0; k < errors; k++) {
+         do {
+            pos = (BenchRand(8) == 0) ? BenchRand(NN) : BenchRand(blockTotalWords[i]);
+            for(used = 0; used < k && chosen[used] != pos; used++)
+               ;
+         } while(used < k);
+         chosen[k] = pos;
+         xk = antilog301[pos];
+         elp[i].b[elp[i].length++] = 0;
+         for(j = elp[i].length - 1; j > 0; j--)
+            elp[i].b[j] ^= GfMult(elp[i].b[j-1], xk);
+      }
+   }
+}
+
+static void
+BenchChien(void)
+{
+   int i, round;
+   int *blockTotalWords;
+   long checksum;
+   clock_t t0, t1, t2;
+   DmtxByte *elpStorage;
+   DmtxByte locStorage[NN], refStorage[NN];
+   DmtxByteList *elp, loc, ref;
+
+   elp = (DmtxByteList *)malloc(BENCH_BLOCKS * sizeof(DmtxByteList));
+   elpStorage = (DmtxByte *)malloc(BENCH_BLOCKS * MAX_ERROR_WORD_COUNT);
+   blockTotalWords = (int *)malloc(BENCH_BLOCKS * sizeof(int));
+   if(elp == NULL || elpStorage == NULL || blockTotalWords == NULL)
+      exit(2);
+
+   for(i = 0; i < BENCH_BLOCKS; i++)
+      elp[i] = dmtxByteListBuild(elpStorage + i * MAX_ERROR_WORD_COUNT, MAX_ERROR_WORD_COUNT);
+   BuildLocators(elp, blockTotalWords, BENCH_BLOCKS);
+
+   loc = dmtxByteListBuild(locStorage, sizeof(locStorage));
+   ref = dmtxByteListBuild(refStorage, sizeof(refStorage));
+
+   for(i = 0; i < BENCH_BLOCKS; i++) {
+      if(ChienReference(&ref, elp + i, blockTotalWords[i]) == DmtxTrue) {
+         if(RsFindErrorLocations(&loc, elp + i, blockTotalWords[i]) != DmtxTrue ||
+               loc.length != ref.length || memcmp(loc.b, ref.b, ref.length) != 0)
+            BenchFail("chien");
+      }
+      else if(RsFindErrorLocations(&loc, elp + i, blockTotalWords[i]) != DmtxFalse) {
+         BenchFail("chien");
+      }
+   }
+
+   checksum = 0;
+   t0 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_BLOCKS; i++)
+         checksum += ChienReference(&ref, elp + i, blockTotalWords[i]);
+   t1 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_BLOCKS; i++)
+         checksum -= RsFindErrorLocations(&loc, elp + i, blockTotalWords[i]);
+   t2 = clock();
+
+   if(checksum != 0)
+      BenchFail("chien");
+
+   fprintf(stdout, "chien: reference %.3f s, library %.3f s (%d blocks x %d rounds)\n",
+         (double)(t1 - t0) / CLOCKS_PER_SEC, (double)(t2 - t1) / CLOCKS_PER_SEC,
+         BENCH_BLOCKS, BENCH_ROUNDS);
+
+   free(blockTotalWords);
+   free(elpStorage);
+   free(elp);
+}
+
+/**
+ * \brief  Look-ahead encoding against the optimizer (AutoBest as reference)
+ */
+static void
+BenchLookAhead(void)
+{
+   int i, j, round, sizeIdx;
+   int inputLength[BENCH_MESSAGES];
+   long fastWords, bestWords;
+   clock_t t0, t1, t2;
+   DmtxByte *inputStorage;
+   DmtxByte outputStorage[4096];
+   DmtxByteList input, output;
+   DmtxMessage *msg;
+   const char *alphabet[] = { "0123456789", "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ",
+         "abcdefghijklmnopqrstuvwxyz ", "ABCXYZ0123456789*>\r", "ABC0123456789!#$%&()*+,-./:;<=>?@",
+         "Hello, World! 42" };
+
+   inputStorage = (DmtxByte *)malloc(BENCH_MESSAGES * BENCH_MESSAGE_MAX);
+   if(inputStorage == NULL)
+      exit(2);
+
+   /* Label-like messages drawn from alphabets that favor each scheme */
+   for(i = 0; i < BENCH_MESSAGES; i++) {
+      inputLength[i] = 1 + BenchRand(BENCH_MESSAGE_MAX);
+      for(j = 0; j < inputLength[i]; j++) {
+         if(i % 7 == 6)
+            inputStorage[i * BENCH_MESSAGE_MAX + j] = (DmtxByte)BenchRand(256);
+         else
+            inputStorage[i * BENCH_MESSAGE_MAX + j] = alphabet[i % 6][BenchRand(strlen(alphabet[i % 6]))];
+      }
+   }
+
+   output = dmtxByteListBuild(outputStorage, sizeof(outputStorage));
+
+   /* Every look-ahead encoding must decode back to its input */
+   for(i = 0; i < BENCH_MESSAGES; i++) {
+      input = dmtxByteListBuild(inputStorage + i * BENCH_MESSAGE_MAX, inputLength[i]);
+      input.length = inputLength[i];
+      dmtxByteListClear(&output);
+      sizeIdx = EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeAutoFast, DmtxUndefined);
+      if(sizeIdx == DmtxUndefined)
+         BenchFail("lookahead");
+
+      msg = dmtxMessageCreate(sizeIdx, DmtxFormatMatrix);
+      if(msg == NULL)
+         exit(2);
+      memcpy(msg->code, output.b, output.length);
+      DecodeDataStream(msg, sizeIdx, NULL);
+      if((int)msg->outputIdx != inputLength[i] || memcmp(msg->output, input.b, inputLength[i]) != 0)
+         BenchFail("lookahead");
+      dmtxMessageDestroy(&msg);
+   }
+
+   fastWords = bestWords = 0;
+   t0 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_MESSAGES; i++) {
+         input = dmtxByteListBuild(inputStorage + i * BENCH_MESSAGE_MAX, inputLength[i]);
+         input.length = inputLength[i];
+         dmtxByteListClear(&output);
+         EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeAutoBest, DmtxUndefined);
+         bestWords += output.length;
+      }
+   t1 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_MESSAGES; i++) {
+         input = dmtxByteListBuild(inputStorage + i * BENCH_MESSAGE_MAX, inputLength[i]);
+         input.length = inputLength[i];
+         dmtxByteListClear(&output);
+         EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeAutoFast, DmtxUndefined);
+         fastWords += output.length;
+      }
+   t2 = clock();
+
+   fprintf(stdout, "lookahead: optimizer %.3f s (%ld words), library %.3f s (%ld words) (%d messages x %d rounds)\n",
+         (double)(t1 - t0) / CLOCKS_PER_SEC, bestWords / BENCH_ROUNDS,
+         (double)(t2 - t1) / CLOCKS_PER_SEC, fastWords / BENCH_ROUNDS,
+         BENCH_MESSAGES, BENCH_ROUNDS);
+
+   free(inputStorage);
+}
+
+/**
+ * \brief  Reference Base 256 chain (original randomize-on-append with header
+ *         rewritten after every value and chain re-randomized on header growth)
+ */
+static int
+Base256Reference(DmtxByte *out, const DmtxByte *in, int length)
+{
+   int i, j, outLength, headerIndex, headerByteCount, chainLength;
+
+   outLength = 0;
+   out[outLength++] = DmtxValueBase256Latch;
+   headerIndex = outLength;
+   out[outLength++] = 0;
+   headerByteCount = 1;
+
+   for(i = 0; i < length; i++) {
+      out[outLength] = Randomize255State(in[i], outLength + 1);
+      outLength++;
+      chainLength = i + 1;
+
+      if(headerByteCount == 1 && chainLength > 249) {
+         for(j = outLength; j > headerIndex + 1; j--)
+            out[j] = Randomize255State(UnRandomize255State(out[j-1], j), j + 1);
+         outLength++;
+         headerByteCount++;
+      }
+
+      if(headerByteCount == 1) {
+         out[headerIndex] = Randomize255State(chainLength, headerIndex + 1);
+      }
+      else {
+         out[headerIndex] = Randomize255State(chainLength/250 + 249, headerIndex + 1);
+         out[headerIndex + 1] = Randomize255State(chainLength%250, headerIndex + 2);
+      }
+   }
+
+   return outLength;
+}
+
+static void
+BenchBase256(void)
+{
+   int i, j, round, refLength;
+   int inputLength[BENCH_PAYLOADS];
+   long wordCount;
+   clock_t t0, t1, t2;
+   DmtxByte *inputStorage;
+   DmtxByte outputStorage[4096], refStorage[4096];
+   DmtxByteList input, output;
+
+   inputStorage = (DmtxByte *)malloc(BENCH_PAYLOADS * BENCH_PAYLOAD_MAX);
+   if(inputStorage == NULL)
+      exit(2);
+
+   /* 1.5 KB class binary payloads that still fit the largest square symbol */
+   for(i = 0; i < BENCH_PAYLOADS; i++) {
+      inputLength[i] = BENCH_PAYLOAD_MAX - BenchRand(200);
+      for(j = 0; j < inputLength[i]; j++)
+         inputStorage[i * BENCH_PAYLOAD_MAX + j] = (DmtxByte)BenchRand(256);
+   }
+
+   output = dmtxByteListBuild(outputStorage, sizeof(outputStorage));
+
+   for(i = 0; i < BENCH_PAYLOADS; i++) {
+      input = dmtxByteListBuild(inputStorage + i * BENCH_PAYLOAD_MAX, inputLength[i]);
+      input.length = inputLength[i];
+      dmtxByteListClear(&output);
+      refLength = Base256Reference(refStorage, input.b, inputLength[i]);
+      if(EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeBase256,
+            DmtxUndefined) == DmtxUndefined || output.length < refLength ||
+            memcmp(output.b, refStorage, refLength) != 0)
+         BenchFail("base256");
+   }
+
+   wordCount = 0;
+   t0 = clock();
+   for(round = 0; round < BENCH_ROUNDS; round++)
+      for(i = 0; i < BENCH_PAYLOADS; i++) {
+         input = dmtxByteListBuild(inputStorage + i * BENCH_PAYLOAD_MAX, inputLength[i]);
+         input.length = inputLength[i];
+         dmtxByteListClear(&output);
+         EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeBase256, DmtxUndefined);
+         wordCount += output.length;
+      }
+   t1 = clock();
+   for(i = 0; i < BENCH_PAYLOADS; i++) {
+      input = dmtxByteListBuild(inputStorage + i * BENCH_PAYLOAD_MAX, inputLength[i]);
+      input.length = inputLength[i];
+      dmtxByteListClear(&output);
+      EncodeDataCodewords(&input, &output, DmtxSymbolSquareAuto, DmtxSchemeAutoBest, DmtxUndefined);
+      wordCount -= output.length * BENCH_ROUNDS;
+   }
+   t2 = clock();
+
+   /* Random bytes leave the optimizer nothing better than one Base 256 chain */
+   if(wordCount != 0)
+      BenchFail("base256");
+
+   fprintf(stdout, "base256: single scheme %.3f s (%d payloads x %d rounds), optimizer %.3f s (%d payloads)\n",
+         (double)(t1 - t0) / CLOCKS_PER_SEC, BENCH_PAYLOADS, BENCH_ROUNDS,
+         (double)(t2 - t1) / CLOCKS_PER_SEC, BENCH_PAYLOADS);
+
+   free(inputStorage);
+}
+
+/**
+ * \brief  Reference PrintPattern (original per-pixel, per-channel writes)
+ */
+static void
+PrintPatternReference(DmtxEncode *enc)
+{
+   int i, j;
+   int symbolRow, symbolCol;
+   int pixelRow, pixelCol;
+   int moduleStatus;
+   size_t rowSize, height;
+
+   rowSize = dmtxImageGetProp(enc->image, DmtxPropRowSizeBytes);
+   height = dmtxImageGetProp(enc->image, DmtxPropHeight);
+
+   memset(enc->image->pxl, 0xff, rowSize * height);
+
+   for(symbolRow = 0; symbolRow < enc->region.symbolRows; symbolRow++) {
+      for(symbolCol = 0; symbolCol < enc->region.symbolCols; symbolCol++) {
+         pixelCol = enc->marginSize + symbolCol * enc->moduleSize;
+         pixelRow = enc->marginSize + symbolRow * enc->moduleSize;
+         moduleStatus = dmtxSymbolModuleStatus(enc->message,
+               enc->region.sizeIdx, symbolRow, symbolCol);
+
+         for(i = pixelRow; i < pixelRow + enc->moduleSize; i++) {
+            for(j = pixelCol; j < pixelCol + enc->moduleSize; j++) {
+               dmtxImageSetPixelValue(enc->image, j, i, 0,
+                     (moduleStatus & DmtxModuleOnRed) ? 0 : 255);
+               if(enc->image->bytesPerPixel > 1) {
+                  dmtxImageSetPixelValue(enc->image, j, i, 1,
+                        (moduleStatus & DmtxModuleOnGreen) ? 0 : 255);
+                  dmtxImageSetPixelValue(enc->image, j, i, 2,
+                        (moduleStatus & DmtxModuleOnBlue) ? 0 : 255);
+               }
+            }
+         }
+      }
+   }
+}
+
+static void
+BenchPrintPattern(void)
+{
+   int i, p, round;
+   int pack[] = { DmtxPack1bppK, DmtxPack8bppK, DmtxPack24bppRGB, DmtxPack32bppRGBX };
+   size_t imageSize;
+   clock_t t0, t1, t2;
+   unsigned char *refPxl;
+   unsigned char input[1000];
+   DmtxEncode *enc;
+
+   for(i = 0; i < (int)sizeof(input); i++)
+      input[i] = '0' + BenchRand(10);
+
+   /* Largest square symbol at a typical print module size */
+   for(p = 0; p < (int)(sizeof(pack)/sizeof(pack[0])); p++) {
+      enc = dmtxEncodeCreate();
+      if(enc == NULL)
+         exit(2);
+      dmtxEncodeSetProp(enc, DmtxPropModuleSize, 8);
+      dmtxEncodeSetProp(enc, DmtxPropPixelPacking, pack[p]);
+      if(dmtxEncodeDataMatrix(enc, sizeof(input), input) == DmtxFail)
+         BenchFail("printpattern");
+
+      imageSize = enc->image->rowSizeBytes * enc->image->height;
+      refPxl = (unsigned char *)malloc(imageSize);
+      if(refPxl == NULL)
+         exit(2);
+      memcpy(refPxl, enc->image->pxl, imageSize);
+
+      t0 = clock();
+      for(round = 0; round < BENCH_RENDERS; round++)
+         PrintPatternReference(enc);
+      t1 = clock();
+      if(memcmp(refPxl, enc->image->pxl, imageSize) != 0)
+         BenchFail("printpattern");
+      for(round = 0; round < BENCH_RENDERS; round++)
+         PrintPattern(enc);
+      t2 = clock();
+      if(memcmp(refPxl, enc->image->pxl, imageSize) != 0)
+         BenchFail("printpattern");
+
+      fprintf(stdout, "printpattern %dbpp: reference %.3f s, library %.3f s (%dx%d pixels x %d rounds)\n",
+            enc->image->bitsPerPixel, (double)(t1 - t0) / CLOCKS_PER_SEC,
+            (double)(t2 - t1) / CLOCKS_PER_SEC, enc->image->width, enc->image->height,
+            BENCH_RENDERS);
+
+      free(refPxl);
+      dmtxEncodeDestroy(&enc);
+   }
+}
+
+/**
+ * \brief  Wall clock seconds; clock() would add up time across threads
+ */
+static double
+BenchWallTime(void)
+{
+#if defined(HAVE_PTHREAD_H) && defined(CLOCK_MONOTONIC)
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+   return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void
+BenchDecodeBatch(void)
+{
+   int i, length, threadCount;
+   char label[64];
+   double t0, t1, t2;
+   DmtxEncode *enc[BENCH_IMAGES];
+   DmtxImage *images[BENCH_IMAGES];
+   DmtxDecodeResult *serial, *parallel;
+   DmtxDecodeBatch *batch;
+
+   serial = (DmtxDecodeResult *)malloc(BENCH_IMAGES * sizeof(DmtxDecodeResult));
+   parallel = (DmtxDecodeResult *)malloc(BENCH_IMAGES * sizeof(DmtxDecodeResult));
+   batch = dmtxDecodeBatchCreate();
+   if(serial == NULL || parallel == NULL || batch == NULL)
+      exit(2);
+
+   for(i = 0; i < BENCH_IMAGES; i++) {
+      length = snprintf(label, sizeof(label), "LOT %06d SN %08d", BenchRand(1000000),
+            BenchRand(100000000));
+      enc[i] = dmtxEncodeCreate();
+      if(enc[i] == NULL)
+         exit(2);
+      dmtxEncodeSetProp(enc[i], DmtxPropModuleSize, 4 + BenchRand(4));
+      dmtxEncodeSetProp(enc[i], DmtxPropPixelPacking, DmtxPack8bppK);
+      if(dmtxEncodeDataMatrix(enc[i], length, (unsigned char *)label) == DmtxFail)
+         BenchFail("batch");
+      images[i] = enc[i]->image;
+   }
+
+   t0 = BenchWallTime();
+   dmtxDecodeBatchSetProp(batch, DmtxPropThreadCount, 1);
+   dmtxDecodeBatchRun(batch, images, BENCH_IMAGES, serial);
+   t1 = BenchWallTime();
+   dmtxDecodeBatchSetProp(batch, DmtxPropThreadCount, DmtxUndefined);
+   dmtxDecodeBatchRun(batch, images, BENCH_IMAGES, parallel);
+   t2 = BenchWallTime();
+   threadCount = batch->workerCount;
+
+   for(i = 0; i < BENCH_IMAGES; i++) {
+      if(serial[i].status != DmtxBatchDecoded || parallel[i].status != serial[i].status ||
+            parallel[i].outputLength != serial[i].outputLength ||
+            memcmp(parallel[i].output, serial[i].output, serial[i].outputLength) != 0)
+         BenchFail("batch");
+   }
+
+   fprintf(stdout, "batch: 1 thread %.3f s, %d threads %.3f s (%d images)\n",
+         t1 - t0, threadCount, t2 - t1, BENCH_IMAGES);
+
+   dmtxDecodeBatchClearResults(serial, BENCH_IMAGES);
+   dmtxDecodeBatchClearResults(parallel, BENCH_IMAGES);
+   dmtxDecodeBatchDestroy(&batch);
+   for(i = 0; i < BENCH_IMAGES; i++)
+      dmtxEncodeDestroy(&enc[i]);
+   free(parallel);
+   free(serial);
+}
+
+/**
+ * \brief  Decode every symbol in an image; returns total output length
+ */
+static int
+DecodeAllSymbols(DmtxImage *img, int threadCount, int *found)
+{
+   int total;
+   DmtxDecode *dec;
+   DmtxRegion *reg;
+   DmtxMessage *msg;
+
+   dec = dmtxDecodeCreate(img, 1);
+   if(dec == NULL)
+      exit(2);
+
+   if(threadCount != 1) {
+      dmtxDecodeSetProp(dec, DmtxPropThreadCount, threadCount);
+      dmtxDecodeSetProp(dec, DmtxPropTileSize, 512);
+   }
+
+   total = *found = 0;
+   while((reg = dmtxRegionFindNext(dec, NULL)) != NULL) {
+      msg = dmtxDecodeMatrixRegion(dec, reg, DmtxUndefined);
+      if(msg != NULL) {
+         total += msg->outputIdx;
+         (*found)++;
+         dmtxMessageDestroy(&msg);
+      }
+      dmtxRegionDestroy(&reg);
+   }
+
+   dmtxDecodeDestroy(&dec);
+
+   return total;
+}
+
+/**
+ * \brief  Sequential and tiled search of one image holding many symbols
+ */
+static void
+BenchTiledScan(void)
+{
+   int i, row, x, y, width, height, length;
+   int serialFound, tiledFound, serialTotal, tiledTotal, allCount, allTotal;
+   char label[64];
+   double t0, t1, t2, t3;
+   unsigned char *pxl;
+   DmtxEncode *enc;
+   DmtxImage *img;
+   DmtxDecode *dec;
+   DmtxDecodeResult *all;
+
+   width = BENCH_PALLET_COLS * BENCH_PALLET_CELL;
+   height = BENCH_PALLET_ROWS * BENCH_PALLET_CELL;
+   pxl = (unsigned char *)malloc(width * height);
+   if(pxl == NULL)
+      exit(2);
+   memset(pxl, 0xff, width * height);
+
+   /* One symbol per cell, placed anywhere that keeps it inside the cell */
+   for(i = 0; i < BENCH_PALLET_COLS * BENCH_PALLET_ROWS; i++) {
+      length = snprintf(label, sizeof(label), "PALLET %02d SSCC %09d", i,
+            BenchRand(1000000000));
+      enc = dmtxEncodeCreate();
+      if(enc == NULL)
+         exit(2);
+      dmtxEncodeSetProp(enc, DmtxPropModuleSize, 3 + BenchRand(6));
+      dmtxEncodeSetProp(enc, DmtxPropPixelPacking, DmtxPack8bppK);
+      if(dmtxEncodeDataMatrix(enc, length, (unsigned char *)label) == DmtxFail)
+         BenchFail("tiled");
+
+      x = (i % BENCH_PALLET_COLS) * BENCH_PALLET_CELL +
+            BenchRand(BENCH_PALLET_CELL - enc->image->width);
+      y = (i / BENCH_PALLET_COLS) * BENCH_PALLET_CELL +
+            BenchRand(BENCH_PALLET_CELL - enc->image->height);
+      for(row = 0; row < enc->image->height; row++)
+         memcpy(pxl + (y + row) * width + x, enc->image->pxl + row * enc->image->rowSizeBytes,
+               enc->image->width);
+
+      dmtxEncodeDestroy(&enc);
+   }
+
+   img = dmtxImageCreate(pxl, width, height, DmtxPack8bppK);
+   if(img == NULL)
+      exit(2);
+
+   t0 = BenchWallTime();
+   serialTotal = DecodeAllSymbols(img, 1, &serialFound);
+   t1 = BenchWallTime();
+   tiledTotal = DecodeAllSymbols(img, DmtxUndefined, &tiledFound);
+   t2 = BenchWallTime();
+
+   dec = dmtxDecodeCreate(img, 1);
+   if(dec == NULL)
+      exit(2);
+   dmtxDecodeSetProp(dec, DmtxPropThreadCount, DmtxUndefined);
+   dmtxDecodeSetProp(dec, DmtxPropTileSize, 512);
+   all = dmtxRegionFindAll(dec, NULL, DmtxTrue, &allCount);
+   t3 = BenchWallTime();
+
+   if(serialFound != BENCH_PALLET_COLS * BENCH_PALLET_ROWS || tiledFound != serialFound ||
+         tiledTotal != serialTotal || all == NULL || allCount != serialFound)
+      BenchFail("tiled");
+
+   for(i = allTotal = 0; i < allCount; i++) {
+      if(all[i].status != DmtxBatchDecoded)
+         BenchFail("tiled");
+      allTotal += all[i].outputLength;
+   }
+   if(allTotal != serialTotal)
+      BenchFail("tiled");
+
+   fprintf(stdout, "tiled: sequential %.3f s, tiled %.3f s, find all %.3f s (%d symbols)\n",
+         t1 - t0, t2 - t1, t3 - t2, serialFound);
+
+   dmtxRegionFindAllDestroy(&all, allCount);
+   dmtxDecodeDestroy(&dec);
+
+   dmtxImageDestroy(&img);
+   free(pxl);
+}
+
+/**
+ * \brief  Search time with no deadline, a distant one, and a short one
+ */
+static void
+BenchDeadline(void)
+{
+   int i;
+   long long deadline;
+   double t0, t1, t2, t3;
+   unsigned char *pxl;
+   DmtxImage *img;
+   DmtxDecode *dec;
+   DmtxRegion *reg;
+
+   /* Faint noise rejects nearly every location, so checking the clock dominates */
+   pxl = (unsigned char *)malloc(BENCH_NOISE_SIZE * BENCH_NOISE_SIZE);
+   if(pxl == NULL)
+      exit(2);
+   for(i = 0; i < BENCH_NOISE_SIZE * BENCH_NOISE_SIZE; i++)
+      pxl[i] = 100 + BenchRand(8);
+
+   img = dmtxImageCreate(pxl, BENCH_NOISE_SIZE, BENCH_NOISE_SIZE, DmtxPack8bppK);
+   dec = dmtxDecodeCreate(img, 1);
+   if(img == NULL || dec == NULL)
+      exit(2);
+
+   t0 = BenchWallTime();
+   reg = dmtxRegionFindNextNsec(dec, DmtxUndefined);
+   if(reg != NULL)
+      BenchFail("deadline");
+   t1 = BenchWallTime();
+
+   dmtxDecodeReset(dec);
+   reg = dmtxRegionFindNextNsec(dec, dmtxTimeNowNsec() + 3600 * 1000000000LL);
+   if(reg != NULL)
+      BenchFail("deadline");
+   t2 = BenchWallTime();
+
+   dmtxDecodeReset(dec);
+   deadline = dmtxTimeNowNsec() + BENCH_DEADLINE_MSEC * 1000000LL;
+   reg = dmtxRegionFindNextNsec(dec, deadline);
+   if(reg != NULL)
+      BenchFail("deadline");
+   t3 = BenchWallTime();
+
+   fprintf(stdout, "deadline: none %.3f s, distant %.3f s, %d ms deadline stopped after %.3f s\n",
+         t1 - t0, t2 - t1, BENCH_DEADLINE_MSEC, t3 - t2);
+
+   dmtxDecodeDestroy(&dec);
+   dmtxImageDestroy(&img);
+   free(pxl);
+}
+
+static const BenchEntry benchEntries[] = {
+   { "hough", BenchHough },
+   { "syndromes", BenchSyndromes },
+   { "chien", BenchChien },
+   { "lookahead", BenchLookAhead },
+   { "base256", BenchBase256 },
+   { "printpattern", BenchPrintPattern },
+   { "batch", BenchDecodeBatch },
+   { "tiled", BenchTiledScan },
+   { "deadline", BenchDeadline }
+};
+
+/**
+ * \brief  Run the benchmarks named on the command line, or all of them
+ */
+int
+main(int argc, char *argv[])
+{
+   int i, j, count;
+
+   count = (int)(sizeof(benchEntries) / sizeof(benchEntries[0]));
+
+   if(argc < 2) {
+      for(i = 0; i < count; i++)
+         benchEntries[i].run();
+      exit(0);
+   }
+
+   for(j = 1; j < argc; j++) {
+      for(i = 0; i < count; i++) {
+         if(strcmp(argv[j], benchEntries[i].name) == 0)
+            break;
+      }
+
+      if(i == count) {
+         fprintf(stderr, "unknown benchmark \"%s\"\n", argv[j]);
+         exit(1);
+      }
+
+      benchEntries[i].run();
+   }
+
+   exit(0);
+}
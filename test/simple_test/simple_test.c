@@ -21,17 +21,38 @@
 #include <math.h>
 #include "../../dmtx.h"
 
+/* Checks that must also run when assert() is compiled out */
+static void
+Check(int passed, const char *what)
+{
+   if(!passed){
+      fprintf(stderr, "check failed: %s\n", what);
+      exit(1);
+   }
+}
+
 int
 main(int argc, char *argv[])
 {
    size_t          width, height, bytesPerPixel;
    unsigned char   str[] = "30Q324343430794<OQQ";
+   unsigned char   fnc1Str[] = "^0112345678901231^10ABC";
    unsigned char  *pxl;
+   unsigned char   bits[DmtxBitMatrixMaxBytes];
+   int             row, col, rowSizeBytes, margin, moduleSize, dark;
    DmtxEncode     *enc;
    DmtxImage      *img;
    DmtxDecode     *dec;
    DmtxRegion     *reg;
    DmtxMessage    *msg;
+   DmtxImage      *images[4];
+   DmtxImage      *fnc1Img;
+   DmtxDecodeBatch *batch;
+   DmtxDecodeResult results[4];
+   DmtxDecodeResult *found;
+   int             foundCount;
+   DmtxScanStatus  scanStatus;
+   DmtxPassFail    bitsResult;
 
    fprintf(stdout, "input:  \"%s\"\n", str);
 
@@ -57,6 +78,28 @@ main(int argc, char *argv[])
    assert(pxl != NULL);
    memcpy(pxl, enc->image->pxl, width * height * bytesPerPixel);
 
+   /* 2a) CHECK the bit matrix entry point against the rendered image */
+
+   bitsResult = dmtxEncodeDataMatrixBits(enc, strlen((const char *)str), str, bits, sizeof(bits));
+   if(bitsResult == DmtxFail){
+      fprintf(stderr, "dmtxEncodeDataMatrixBits failed\n");
+      exit(1);
+   }
+
+   rowSizeBytes = (enc->region.symbolCols + 7) / 8;
+   margin = dmtxEncodeGetProp(enc, DmtxPropMarginSize);
+   moduleSize = dmtxEncodeGetProp(enc, DmtxPropModuleSize);
+
+   for (row=0; row<enc->region.symbolRows; row++){
+      for (col=0; col<enc->region.symbolCols; col++){
+         dark = (bits[row*rowSizeBytes + col/8] & (0x80 >> (col%8))) != 0;
+         if(dark != (pxl[((margin + row*moduleSize)*width + margin + col*moduleSize)*bytesPerPixel] == 0)){
+            fprintf(stderr, "bit matrix differs from image at row %d col %d\n", row, col);
+            exit(1);
+         }
+      }
+   }
+
    dmtxEncodeDestroy(&enc);
 
    fprintf(stdout, "width:  \"%zd\"\n", width);
@@ -112,6 +155,143 @@ main(int argc, char *argv[])
    }
 
    dmtxDecodeDestroy(&dec);
+
+   /* 4) DECODE the same image several times through the batch interface */
+
+   for (int i=0; i<4; i++){
+      images[i] = img;
+   }
+
+   batch = dmtxDecodeBatchCreate();
+   Check(batch != NULL, "batch create");
+   dmtxDecodeBatchSetProp(batch, DmtxPropThreadCount, 2);
+   Check(dmtxDecodeBatchRun(batch, images, 4, results) == DmtxPass, "batch run");
+
+   for (int i=0; i<4; i++){
+      Check(results[i].status == DmtxBatchDecoded, "batch status");
+      Check(results[i].outputLength == (int)strlen((const char *)str), "batch output length");
+      Check(memcmp(results[i].output, str, results[i].outputLength) == 0, "batch output");
+   }
+
+   dmtxDecodeBatchClearResults(results, 4);
+
+   /* 4a) DECODE a symbol carrying FNC1, which batch workers must report */
+
+   enc = dmtxEncodeCreate();
+   Check(enc != NULL, "FNC1 encode create");
+   dmtxEncodeSetProp(enc, DmtxPropFnc1, '^');
+   Check(dmtxEncodeDataMatrix(enc, strlen((const char *)fnc1Str), fnc1Str) == DmtxPass, "FNC1 encode");
+   fnc1Img = dmtxImageCreate(enc->image->pxl, enc->image->width, enc->image->height, DmtxPack24bppRGB);
+   Check(fnc1Img != NULL, "FNC1 image create");
+
+   for (int i=0; i<4; i++){
+      images[i] = fnc1Img;
+   }
+
+   /* Set on workers that already hold decoders, then on a new batch whose
+      workers start with it */
+   for (int pass=0; pass<2; pass++){
+      if(pass == 1){
+         dmtxDecodeBatchDestroy(&batch);
+         batch = dmtxDecodeBatchCreate();
+         Check(batch != NULL, "FNC1 batch create");
+         dmtxDecodeBatchSetProp(batch, DmtxPropThreadCount, 2);
+      }
+      Check(dmtxDecodeBatchSetProp(batch, DmtxPropFnc1, '^') == DmtxPass, "batch FNC1 set");
+      Check(dmtxDecodeBatchGetProp(batch, DmtxPropFnc1) == '^', "batch FNC1 get");
+      Check(dmtxDecodeBatchRun(batch, images, 4, results) == DmtxPass, "FNC1 batch run");
+
+      for (int i=0; i<4; i++){
+         Check(results[i].status == DmtxBatchDecoded, "FNC1 batch status");
+         Check(results[i].outputLength == (int)strlen((const char *)fnc1Str), "FNC1 batch output length");
+         Check(memcmp(results[i].output, fnc1Str, results[i].outputLength) == 0, "FNC1 batch output");
+      }
+
+      dmtxDecodeBatchClearResults(results, 4);
+   }
+
+   dmtxDecodeBatchDestroy(&batch);
+   dmtxImageDestroy(&fnc1Img);
+   dmtxEncodeDestroy(&enc);
+
+   /* 5) DECODE again with tiles small enough to split the symbol */
+
+   dec = dmtxDecodeCreate(img, 1);
+   Check(dec != NULL, "tiled decode create");
+   dmtxDecodeSetProp(dec, DmtxPropThreadCount, 2);
+
+   /* Tiles pass the symbol back to be found once on the whole image. The
+      second size rescans with the tile decoders kept from the first. */
+   for (int tileSize=32; tileSize<=48; tileSize+=16){
+      Check(dmtxDecodeReset(dec) == DmtxPass, "tiled reset");
+      Check(dmtxDecodeSetProp(dec, DmtxPropTileSize, tileSize) == DmtxPass, "tile size set");
+
+      reg = dmtxRegionFindNext(dec, NULL);
+      Check(reg != NULL, "tiled region");
+      msg = dmtxDecodeMatrixRegion(dec, reg, DmtxUndefined);
+      Check(msg != NULL, "tiled decode");
+      Check(msg->outputIdx == (int)strlen((const char *)str), "tiled output length");
+      Check(memcmp(msg->output, str, msg->outputIdx) == 0, "tiled output");
+      dmtxMessageDestroy(&msg);
+      dmtxRegionDestroy(&reg);
+
+      reg = dmtxRegionFindNext(dec, NULL);
+      Check(reg == NULL, "tiled symbol reported once");
+   }
+
+   dmtxDecodeDestroy(&dec);
+
+   /* 6) FIND and decode every region in one call */
+
+   dec = dmtxDecodeCreate(img, 1);
+   Check(dec != NULL, "find all decode create");
+
+   found = dmtxRegionFindAll(dec, NULL, DmtxTrue, &foundCount);
+   Check(found != NULL && foundCount == 1, "find all count");
+   Check(found[0].status == DmtxBatchDecoded, "find all status");
+   Check(found[0].outputLength == (int)strlen((const char *)str), "find all output length");
+   Check(memcmp(found[0].output, str, found[0].outputLength) == 0, "find all output");
+   Check(found[0].corner[1].X > found[0].corner[0].X, "find all corners");
+
+   dmtxRegionFindAllDestroy(&found, foundCount);
+   dmtxDecodeDestroy(&dec);
+
+   /* 7) FIND the region again before a distant nanosecond deadline */
+
+   dec = dmtxDecodeCreate(img, 1);
+   Check(dec != NULL, "deadline decode create");
+
+   reg = dmtxRegionFindNextNsec(dec, dmtxTimeNowNsec() + 60 * 1000000000LL);
+   Check(reg != NULL, "region before deadline");
+   dmtxRegionDestroy(&reg);
+
+   dmtxDecodeDestroy(&dec);
+
+   /* 8) FIND the region a few locations at a time, resuming each time */
+
+   dec = dmtxDecodeCreate(img, 1);
+   Check(dec != NULL, "budget decode create");
+
+   do {
+      reg = dmtxRegionFindNextStatus(dec, DmtxUndefined, 16, &scanStatus);
+      Check((reg != NULL) == (scanStatus == DmtxScanFound), "region matches status");
+   } while(scanStatus == DmtxScanBudgetSpent);
+
+   Check(scanStatus == DmtxScanFound, "region within budgets");
+   msg = dmtxDecodeMatrixRegion(dec, reg, DmtxUndefined);
+   Check(msg != NULL, "budget decode");
+   Check(memcmp(msg->output, str, msg->outputIdx) == 0, "budget output");
+   dmtxMessageDestroy(&msg);
+   dmtxRegionDestroy(&reg);
+
+   do {
+      reg = dmtxRegionFindNextStatus(dec, DmtxUndefined, 16, &scanStatus);
+   } while(scanStatus == DmtxScanBudgetSpent);
+
+   Check(reg == NULL && scanStatus == DmtxScanExhausted, "budget scan exhausted");
+
+   dmtxDecodeDestroy(&dec);
+
    dmtxImageDestroy(&img);
    free(pxl);
 